@@ -0,0 +1,404 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Capture
+
+  See KMI_capture.h for the file format and threading.
+
+*/
+
+#include "KMI_capture.h"
+#include "KMI_rxClock.h"
+#include <QDateTime>
+#include <QDebug>
+#include <cstring>
+#include <limits>
+
+#define CAPTURE_WRITE_CHUNK     65536   // encoded bytes collected before each file write
+#define CAPTURE_RECORD_OVERHEAD 21      // direction + two varints
+
+// ****************************
+// Writer
+// ****************************
+
+KMI_CaptureWriter::KMI_CaptureWriter(QObject *parent) : QThread(parent)
+{
+    recording.store(false, std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+    writtenRecords.store(0, std::memory_order_relaxed);
+    writtenBytes.store(0, std::memory_order_relaxed);
+    droppedRecords.store(0, std::memory_order_relaxed);
+    lastTimestampNs = 0;
+    writeFailed = false;
+}
+
+KMI_CaptureWriter::~KMI_CaptureWriter()
+{
+    stop();
+}
+
+bool KMI_CaptureWriter::start(QString filePath)
+{
+    stop();
+
+    // reserved once, the producers only copy into it
+    for (KMI_CaptureLane &lane : lanes)
+    {
+        lane.allocate();
+        lane.discard(); // appends that raced the last stop
+    }
+
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "KMI_CaptureWriter: couldn't open" << filePath << "-" << file.errorString();
+        return false;
+    }
+
+    qint64 startNs = kmiHostTimeNs();
+    unsigned char header[CAPTURE_HEADER_SIZE];
+    memcpy(header, CAPTURE_MAGIC, 8);
+    qToLittleEndian<quint32>(CAPTURE_VERSION, header + 8);
+    qToLittleEndian<quint32>(CAPTURE_HEADER_SIZE, header + 12);
+    qToLittleEndian<qint64>(startNs, header + 16);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 24);
+
+    if (file.write(reinterpret_cast<const char *>(header), CAPTURE_HEADER_SIZE) != CAPTURE_HEADER_SIZE)
+    {
+        qDebug() << "KMI_CaptureWriter: couldn't write the header -" << file.errorString();
+        file.close();
+        return false;
+    }
+
+    lastTimestampNs = startNs;
+    writeFailed = false;
+    writtenRecords.store(0, std::memory_order_relaxed);
+    writtenBytes.store(CAPTURE_HEADER_SIZE, std::memory_order_relaxed);
+    droppedRecords.store(0, std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+
+    QThread::start();
+    recording.store(true, std::memory_order_release);
+    return true;
+}
+
+void KMI_CaptureWriter::stop()
+{
+    recording.store(false, std::memory_order_release);
+
+    if (isRunning())
+    {
+        stopping.store(true, std::memory_order_release); // everything appended before it is still written
+        wait();
+    }
+
+    if (file.isOpen()) file.close();
+}
+
+void KMI_CaptureWriter::append(int direction, qint64 timestampNs, const unsigned char *bytes, size_t length)
+{
+    if (!recording.load(std::memory_order_acquire) || length == 0) return;
+
+    if (!lanes[direction == CAPTURE_TX ? CAPTURE_TX : CAPTURE_RX].push(timestampNs, bytes, length))
+    {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed); // the disk can't keep up, or it is larger than the lane
+    }
+}
+
+// ****************************
+// Writer - Private Functions
+// ****************************
+
+void KMI_CaptureWriter::run()
+{
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+
+    while (true)
+    {
+        bool finishing = stopping.load(std::memory_order_acquire); // read first, so nothing appended before stop() is missed
+
+        // oldest first across both lanes, a record only waits for the other lane's older ones
+        bool wrote = false;
+        while (true)
+        {
+            qint64 timestampNs[2];
+            const unsigned char *bytes[2];
+            size_t length[2];
+            bool ready[2];
+            for (int direction = CAPTURE_RX; direction <= CAPTURE_TX; direction++)
+            {
+                ready[direction] = lanes[direction].front(&timestampNs[direction], &bytes[direction], &length[direction]);
+            }
+            if (!ready[CAPTURE_RX] && !ready[CAPTURE_TX]) break;
+
+            int direction = (!ready[CAPTURE_RX] || (ready[CAPTURE_TX] && timestampNs[CAPTURE_TX] < timestampNs[CAPTURE_RX]))
+                            ? CAPTURE_TX : CAPTURE_RX;
+            writeRecord(direction, timestampNs[direction], bytes[direction], length[direction]);
+            lanes[direction].pop();
+            wrote = true;
+
+            if (writeBuffer.size() >= CAPTURE_WRITE_CHUNK) writeBuffered();
+        }
+        writeBuffered();
+
+        if (finishing)
+        {
+            if (!writeFailed) file.flush();
+            return;
+        }
+
+        if (sinceFlush.elapsed() >= CAPTURE_FLUSH_MS)
+        {
+            if (!writeFailed) file.flush(); // get what we have onto disk
+            sinceFlush.restart();
+        }
+        if (!wrote) QThread::msleep(CAPTURE_POLL_MS); // nothing to do, the producers never wake us
+    }
+}
+
+void KMI_CaptureWriter::writeRecord(int direction, qint64 timestampNs, const unsigned char *bytes, size_t length)
+{
+    if (writeFailed) return;
+
+    size_t start = writeBuffer.size();
+    writeBuffer.resize(start + CAPTURE_RECORD_OVERHEAD + length);
+    unsigned char *out = writeBuffer.data() + start;
+
+    size_t n = 0;
+    out[n++] = (unsigned char)direction;
+    n += kmiCapturePutVarint(out + n, kmiCaptureZigZag(timestampNs - lastTimestampNs));
+    n += kmiCapturePutVarint(out + n, length);
+    memcpy(out + n, bytes, length);
+    n += length;
+
+    writeBuffer.resize(start + n);
+    lastTimestampNs = timestampNs;
+    writtenRecords.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KMI_CaptureWriter::writeBuffered()
+{
+    if (!writeBuffer.empty() && !writeFailed)
+    {
+        if (file.write(reinterpret_cast<const char *>(writeBuffer.data()), qint64(writeBuffer.size())) != qint64(writeBuffer.size()))
+        {
+            writeFailed = true;
+            recording.store(false, std::memory_order_release);
+            emit signalCaptureError(QString("Capture stopped, couldn't write %1: %2").arg(file.fileName(), file.errorString()));
+        }
+        else
+        {
+            writtenBytes.fetch_add(writeBuffer.size(), std::memory_order_relaxed);
+        }
+    }
+    writeBuffer.clear(); // keeps its capacity
+}
+
+// ****************************
+// Reader
+// ****************************
+
+KMI_CaptureReader::KMI_CaptureReader()
+{
+    base = nullptr;
+    close();
+}
+
+KMI_CaptureReader::~KMI_CaptureReader()
+{
+    close();
+}
+
+bool KMI_CaptureReader::open(QString filePath)
+{
+    close();
+
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "KMI_CaptureReader: couldn't open" << filePath << "-" << file.errorString();
+        return false;
+    }
+
+    qint64 fileSize = file.size();
+    const unsigned char *mapped = (fileSize >= CAPTURE_HEADER_SIZE) ? file.map(0, fileSize) : nullptr;
+    base = mapped; // close() unmaps it
+    if (mapped == nullptr || memcmp(mapped, CAPTURE_MAGIC, 8) != 0
+            || qFromLittleEndian<quint32>(mapped + 8) != CAPTURE_VERSION)
+    {
+        qDebug() << "KMI_CaptureReader: not a capture log:" << filePath;
+        close();
+        return false;
+    }
+
+    quint32 headerSize = qFromLittleEndian<quint32>(mapped + 12);
+    if (headerSize < CAPTURE_HEADER_SIZE || headerSize > fileSize)
+    {
+        qDebug() << "KMI_CaptureReader: bad header size:" << headerSize;
+        close();
+        return false;
+    }
+
+    size = fileSize;
+    headerStartNs = qFromLittleEndian<qint64>(mapped + 16);
+    headerStartUtcMs = qFromLittleEndian<qint64>(mapped + 24);
+
+    // one pass, a seek point every CAPTURE_INDEX_STRIDE records
+    index.reserve(size_t(size / (CAPTURE_INDEX_STRIDE * 4)) + 1);
+    qint64 offset = headerSize;
+    qint64 previousNs = headerStartNs;
+    qint64 maxNs = std::numeric_limits<qint64>::min();
+    KMI_CaptureEvent event;
+    qint64 nextOffset;
+
+    while (offset < size)
+    {
+        if (recordCount % CAPTURE_INDEX_STRIDE == 0) index.push_back({ offset, previousNs, maxNs });
+
+        if (!decode(offset, previousNs, event, &nextOffset))
+        {
+            if (recordCount % CAPTURE_INDEX_STRIDE == 0) index.pop_back();
+            tailTruncated = true;
+            qDebug() << "KMI_CaptureReader: partial record at" << offset << "of" << size << "- reading up to it";
+            break;
+        }
+
+        if (recordCount == 0) firstRecordNs = event.timestampNs;
+        if (event.timestampNs > maxNs) maxNs = event.timestampNs;
+        previousNs = event.timestampNs;
+        offset = nextOffset;
+        recordCount++;
+    }
+    lastRecordNs = recordCount ? maxNs : 0;
+
+    seekRecord(0);
+    return true;
+}
+
+void KMI_CaptureReader::close()
+{
+    if (base) file.unmap(const_cast<unsigned char *>(base));
+    if (file.isOpen()) file.close();
+
+    base = nullptr;
+    size = 0;
+    headerStartNs = headerStartUtcMs = 0;
+    recordCount = 0;
+    firstRecordNs = lastRecordNs = 0;
+    tailTruncated = false;
+    index.clear();
+
+    cursorRecord = 0;
+    cursorOffset = CAPTURE_HEADER_SIZE;
+    cursorPreviousNs = 0;
+}
+
+bool KMI_CaptureReader::seekRecord(quint64 record)
+{
+    if (!isOpen() || record > recordCount) return false;
+
+    if (index.empty())
+    {
+        cursorRecord = 0; // nothing recorded, next() returns false
+        return true;
+    }
+
+    // record == recordCount on a multiple of the stride has no seek point of its own
+    size_t point = size_t(record / CAPTURE_INDEX_STRIDE);
+    if (point >= index.size()) point = index.size() - 1;
+    seekPoint(point);
+
+    KMI_CaptureEvent event;
+    while (cursorRecord < record) next(event);
+    return true;
+}
+
+bool KMI_CaptureReader::seekTime(qint64 timestampNs)
+{
+    if (!isOpen()) return false;
+    if (index.empty()) return seekRecord(0);
+
+    // last seek point with every earlier record before timestampNs, index[0] always qualifies
+    size_t low = 0, high = index.size();
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (index[middle].maxBeforeNs < timestampNs) low = middle;
+        else high = middle;
+    }
+    seekPoint(low);
+
+    // step to the first record that isn't before timestampNs, a record that stepped back in time
+    // behind a later one already counts as passed
+    qint64 maxNs = index[low].maxBeforeNs;
+    KMI_CaptureEvent event;
+    while (cursorRecord < recordCount)
+    {
+        quint64 savedRecord = cursorRecord;
+        qint64 savedOffset = cursorOffset;
+        qint64 savedPreviousNs = cursorPreviousNs;
+
+        next(event);
+        if (event.timestampNs > maxNs) maxNs = event.timestampNs;
+        if (maxNs >= timestampNs)
+        {
+            cursorRecord = savedRecord;
+            cursorOffset = savedOffset;
+            cursorPreviousNs = savedPreviousNs;
+            break;
+        }
+    }
+    return true;
+}
+
+bool KMI_CaptureReader::next(KMI_CaptureEvent &event)
+{
+    if (cursorRecord >= recordCount) return false;
+
+    qint64 nextOffset;
+    if (!decode(cursorOffset, cursorPreviousNs, event, &nextOffset)) return false; // indexed, can't happen
+
+    event.record = cursorRecord++;
+    cursorOffset = nextOffset;
+    cursorPreviousNs = event.timestampNs;
+    return true;
+}
+
+// ****************************
+// Reader - Private Functions
+// ****************************
+
+bool KMI_CaptureReader::decode(qint64 offset, qint64 previousNs, KMI_CaptureEvent &event, qint64 *nextOffset) const
+{
+    const unsigned char *p = base + offset;
+    const unsigned char *end = base + size;
+    if (p >= end) return false;
+
+    int direction = *p++;
+    if (direction != CAPTURE_RX && direction != CAPTURE_TX) return false;
+
+    quint64 delta, length;
+    size_t n = kmiCaptureGetVarint(p, end, &delta);
+    if (n == 0) return false;
+    p += n;
+
+    n = kmiCaptureGetVarint(p, end, &length);
+    if (n == 0) return false;
+    p += n;
+    if (length > quint64(end - p)) return false;
+
+    event.direction = direction;
+    event.timestampNs = previousNs + kmiCaptureUnZigZag(delta);
+    event.data = p;
+    event.length = size_t(length);
+    *nextOffset = (p - base) + qint64(length);
+    return true;
+}
+
+void KMI_CaptureReader::seekPoint(size_t point)
+{
+    cursorRecord = quint64(point) * CAPTURE_INDEX_STRIDE;
+    cursorOffset = index[point].offset;
+    cursorPreviousNs = index[point].previousNs;
+}
@@ -0,0 +1,303 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_CAPTURE_H
+#define KMI_CAPTURE_H
+
+/* KMI Capture
+
+  Append-only binary log of everything a MidiDeviceManager received and sent, with timing
+  (see MidiDeviceManager::slotStartCapture and KMI_CaptureReplay).
+
+  File layout, little endian:
+
+    header  "KMICAPT1", uint32 version, uint32 header size, int64 start host ns, int64 start UTC ms
+    record  uint8 direction (CAPTURE_RX/CAPTURE_TX)
+            varint zigzag(timestamp - previous record's timestamp), host ns (kmiHostTimeNs)
+            varint length
+            length bytes
+
+  - rx records are whole messages as RtMidi delivered them, stamped by KMI_RxClock
+  - tx records are the raw writes: a batch of short messages, one sysex, or one sysex chunk
+  - records are in append order, rx and tx come from different threads so the timestamps can step
+    back a little, hence the signed delta
+  - there is no footer, a log cut short by a crash reads up to its last whole record
+
+  KMI_CaptureWriter: append() copies the bytes into a preallocated lane (KMI_CaptureLane) and
+  returns, it never allocates, locks or waits, so it is safe in the RtMidi callback. There is one
+  single producer lane per direction: rx is appended by the RtMidi callback, tx by the thread that
+  owns the manager. The writer thread polls the lanes every CAPTURE_POLL_MS while they are empty,
+  merges them by timestamp and does all file I/O. A record that doesn't fit in its lane is dropped
+  and counted.
+
+  KMI_CaptureReader: maps the file and indexes it in one pass, then seeks by record or time in
+  O(log n) plus at most CAPTURE_INDEX_STRIDE steps.
+
+*/
+
+#include <QThread>
+#include <QFile>
+#include <QString>
+#include <QtEndian>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+
+#define CAPTURE_MAGIC           "KMICAPT1"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_SIZE     32
+#define CAPTURE_LANE_SIZE       2097152 // bytes reserved per direction while recording, must be a power of two
+#define CAPTURE_POLL_MS         2       // the writer looks at the lanes this often while they are empty
+#define CAPTURE_FLUSH_MS        250     // the file is flushed at least this often while recording
+#define CAPTURE_INDEX_STRIDE    256     // records between seek points
+
+enum
+{
+    CAPTURE_RX,
+    CAPTURE_TX
+};
+
+// one record, data points into the reader's mapping and stays valid while the reader is open
+typedef struct
+{
+    quint64 record;             // 0 based position in the log
+    int direction;              // CAPTURE_RX/CAPTURE_TX
+    qint64 timestampNs;         // host ns at capture time, compare with KMI_CaptureReader::startNs
+    const unsigned char *data;
+    size_t length;
+} KMI_CaptureEvent;
+
+// ****************************
+// Varints
+// ****************************
+
+inline size_t kmiCapturePutVarint(unsigned char *out, quint64 value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// returns the bytes used, 0 if the varint runs past end
+inline size_t kmiCaptureGetVarint(const unsigned char *in, const unsigned char *end, quint64 *value)
+{
+    quint64 result = 0;
+    for (size_t n = 0; n < 10 && in + n < end; n++)
+    {
+        result |= quint64(in[n] & 0x7F) << (7 * n);
+        if ((in[n] & 0x80) == 0)
+        {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+inline quint64 kmiCaptureZigZag(qint64 value) { return (quint64(value) << 1) ^ quint64(value >> 63); }
+inline qint64 kmiCaptureUnZigZag(quint64 value) { return qint64(value >> 1) ^ -qint64(value & 1); }
+
+// ****************************
+// Lane
+// ****************************
+
+/* Single-producer/single-consumer byte ring of capture records, same shape as KMI_RxRing but
+   with the record header in the slab so any length up to the slab fits. Each record is kept
+   contiguous, one that won't fit before the end of the slab starts over at the beginning. */
+
+#define CAPTURE_LANE_WRAP       0xFFFFFFFFu // header length: the rest of the slab is unused
+
+typedef struct
+{
+    qint64 timestampNs;
+    quint32 length;             // bytes after the header, CAPTURE_LANE_WRAP to skip to the start
+    quint32 reserved;
+} CAPTURE_LANE_HEADER;
+
+class KMI_CaptureLane
+{
+public:
+    KMI_CaptureLane()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cursor = 0;
+    }
+
+    // owner thread, before the first push
+    void allocate() { if (slab.empty()) slab.resize(CAPTURE_LANE_SIZE); }
+
+    // producer only, false if there isn't room
+    bool push(qint64 timestampNs, const unsigned char *bytes, size_t length)
+    {
+        size_t need = recordSize(length);
+        if (slab.empty() || need > CAPTURE_LANE_SIZE) return false;
+
+        quint64 start = head.load(std::memory_order_relaxed);
+        size_t remaining = CAPTURE_LANE_SIZE - size_t(start & (CAPTURE_LANE_SIZE - 1));
+        quint64 at = (need > remaining) ? start + remaining : start;
+
+        if (at + need - tail.load(std::memory_order_acquire) > CAPTURE_LANE_SIZE) return false; // full
+
+        if (at != start && remaining >= sizeof(CAPTURE_LANE_HEADER))
+        {
+            CAPTURE_LANE_HEADER wrap = { 0, CAPTURE_LANE_WRAP, 0 };
+            memcpy(&slab[start & (CAPTURE_LANE_SIZE - 1)], &wrap, sizeof(wrap));
+        }
+
+        unsigned char *out = &slab[at & (CAPTURE_LANE_SIZE - 1)];
+        CAPTURE_LANE_HEADER header = { timestampNs, quint32(length), 0 };
+        memcpy(out, &header, sizeof(header));
+        memcpy(out + sizeof(header), bytes, length);
+
+        head.store(at + need, std::memory_order_release); // publish
+        return true;
+    }
+
+    // consumer only, the oldest record without removing it, valid until pop()
+    bool front(qint64 *timestampNs, const unsigned char **bytes, size_t *length)
+    {
+        quint64 position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire)) return false;
+
+        CAPTURE_LANE_HEADER header;
+        size_t remaining = CAPTURE_LANE_SIZE - size_t(position & (CAPTURE_LANE_SIZE - 1));
+        if (remaining >= sizeof(header)) memcpy(&header, &slab[position & (CAPTURE_LANE_SIZE - 1)], sizeof(header));
+        if (remaining < sizeof(header) || header.length == CAPTURE_LANE_WRAP)
+        {
+            position += remaining; // the producer started over, a record always follows
+            memcpy(&header, &slab[0], sizeof(header));
+        }
+
+        *timestampNs = header.timestampNs;
+        *bytes = &slab[(position & (CAPTURE_LANE_SIZE - 1)) + sizeof(header)];
+        *length = header.length;
+        cursor = position + recordSize(header.length);
+        return true;
+    }
+
+    // consumer only, hands the record front() returned back to the producer
+    void pop() { tail.store(cursor, std::memory_order_release); }
+
+    // consumer only, drop everything published so far
+    void discard() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+    static size_t recordSize(size_t length) { return (sizeof(CAPTURE_LANE_HEADER) + length + 7) & ~size_t(7); }
+
+    std::vector<unsigned char> slab;
+    std::atomic<quint64> head;          // written by the producer
+    std::atomic<quint64> tail;          // written by the consumer
+    quint64 cursor;                     // consumer, end of the record front() returned
+};
+
+// ****************************
+// Writer
+// ****************************
+
+class KMI_CaptureWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit KMI_CaptureWriter(QObject *parent = nullptr);
+    ~KMI_CaptureWriter();
+
+    bool start(QString filePath);   // truncates filePath, false if it can't be opened
+    void stop();                    // writes everything queued, then closes the file
+
+    // rx from the RtMidi callback, tx from the owner thread, no-op unless recording
+    void append(int direction, qint64 timestampNs, const unsigned char *bytes, size_t length);
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    quint64 records() const { return writtenRecords.load(std::memory_order_relaxed); }
+    quint64 bytesWritten() const { return writtenBytes.load(std::memory_order_relaxed); }
+    quint64 dropped() const { return droppedRecords.load(std::memory_order_relaxed); }
+    QString fileName() const { return file.fileName(); }
+
+signals:
+    void signalCaptureError(QString errorMessage); // emitted from the writer thread, recording stops
+
+protected:
+    void run() override;
+
+private:
+    void writeRecord(int direction, qint64 timestampNs, const unsigned char *bytes, size_t length);
+    void writeBuffered();
+
+    KMI_CaptureLane lanes[2];           // indexed by CAPTURE_RX/CAPTURE_TX
+    std::atomic<bool> recording;
+    std::atomic<bool> stopping;         // set by stop(), the writer drains the lanes and exits
+    std::atomic<quint64> writtenRecords;
+    std::atomic<quint64> writtenBytes;
+    std::atomic<quint64> droppedRecords;
+    QFile file;                         // writer thread only while running
+    qint64 lastTimestampNs;             // writer thread, delta base
+    bool writeFailed;
+    std::vector<unsigned char> writeBuffer;
+};
+
+// ****************************
+// Reader
+// ****************************
+
+class KMI_CaptureReader
+{
+public:
+    KMI_CaptureReader();
+    ~KMI_CaptureReader();
+
+    bool open(QString filePath);    // maps and indexes the log, false if it isn't a capture
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    quint64 count() const { return recordCount; }
+    qint64 startNs() const { return headerStartNs; }        // host ns when the capture started
+    qint64 startUtcMs() const { return headerStartUtcMs; }
+    qint64 firstNs() const { return firstRecordNs; }
+    qint64 lastNs() const { return lastRecordNs; }          // latest timestamp in the log
+    bool truncated() const { return tailTruncated; }        // the file ends in a partial record
+
+    bool seekRecord(quint64 record);
+    bool seekTime(qint64 timestampNs);   // first record at or after timestampNs
+    bool next(KMI_CaptureEvent &event);  // false at the end
+    quint64 position() const { return cursorRecord; }
+
+private:
+    KMI_CaptureReader(const KMI_CaptureReader &) = delete;
+    KMI_CaptureReader &operator=(const KMI_CaptureReader &) = delete;
+
+    typedef struct
+    {
+        qint64 offset;          // file offset of the record
+        qint64 previousNs;      // timestamp of the record before it, the delta base
+        qint64 maxBeforeNs;     // latest timestamp of all records before it, for seekTime
+    } SEEK_POINT;
+
+    bool decode(qint64 offset, qint64 previousNs, KMI_CaptureEvent &event, qint64 *nextOffset) const;
+    void seekPoint(size_t point);
+
+    QFile file;
+    const unsigned char *base;
+    qint64 size;
+    qint64 headerStartNs;
+    qint64 headerStartUtcMs;
+    quint64 recordCount;
+    qint64 firstRecordNs;
+    qint64 lastRecordNs;
+    bool tailTruncated;
+    std::vector<SEEK_POINT> index;      // one per CAPTURE_INDEX_STRIDE records
+
+    // cursor
+    quint64 cursorRecord;
+    qint64 cursorOffset;
+    qint64 cursorPreviousNs;
+};
+
+#endif // KMI_CAPTURE_H
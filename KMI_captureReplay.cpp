@@ -0,0 +1,168 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Capture Replay
+
+  See KMI_captureReplay.h for details.
+
+*/
+
+#include "KMI_captureReplay.h"
+#include "KMI_mdm.h"
+
+KMI_CaptureReplay::KMI_CaptureReplay(MidiDeviceManager *target, QObject *parent) : QObject(parent)
+{
+    mdm = target;
+    replaySpeed = 1.0;
+    running = false;
+    hasPending = false;
+    anchorHostNs = anchorCaptureNs = 0;
+
+    replayTimer.setSingleShot(true);
+    replayTimer.setTimerType(Qt::PreciseTimer);
+    connect(&replayTimer, &QTimer::timeout, this, &KMI_CaptureReplay::slotServiceReplay);
+}
+
+// ****************************
+// Public Functions
+// ****************************
+
+bool KMI_CaptureReplay::open(QString filePath)
+{
+    slotStop();
+    hasPending = false;
+    sysExPool.configure(mdm->rxSysExMaxSize);
+    return reader.open(filePath);
+}
+
+quint64 KMI_CaptureReplay::replayAll()
+{
+    quint64 fed = 0;
+    while (peek())
+    {
+        if (pending.direction == CAPTURE_RX) fed++;
+        feed(pending, kmiHostTimeNs());
+        hasPending = false;
+    }
+    return fed;
+}
+
+// ****************************
+// Public Slots
+// ****************************
+
+void KMI_CaptureReplay::slotStart()
+{
+    if (!reader.isOpen() || running) return;
+
+    running = true;
+    anchor();
+    slotServiceReplay();
+}
+
+void KMI_CaptureReplay::slotStop()
+{
+    running = false;
+    replayTimer.stop();
+}
+
+void KMI_CaptureReplay::slotSeekRecord(quint64 record)
+{
+    hasPending = false;
+    reader.seekRecord(record);
+    if (running) anchor();
+}
+
+void KMI_CaptureReplay::slotSeekTime(qint64 offsetNs)
+{
+    hasPending = false;
+    reader.seekTime(reader.firstNs() + offsetNs);
+    if (running) anchor();
+}
+
+// ****************************
+// Private Slots
+// ****************************
+
+// feed everything that's due, then sleep until the next record or yield after a batch
+void KMI_CaptureReplay::slotServiceReplay()
+{
+    if (!running) return;
+
+    int fed = 0;
+    while (peek())
+    {
+        qint64 dueNs = replayTimeNs(pending.timestampNs);
+        qint64 now = kmiHostTimeNs();
+
+        if (replaySpeed > 0 && dueNs > now)
+        {
+            replayTimer.start(int((dueNs - now + 999999) / 1000000));
+            return;
+        }
+
+        feed(pending, replaySpeed > 0 ? dueNs : now);
+        hasPending = false;
+
+        if (++fed >= CAPTURE_REPLAY_BATCH)
+        {
+            replayTimer.start(0); // let the event loop (and the rx signals' receivers) run
+            return;
+        }
+    }
+
+    running = false;
+    emit signalReplayFinished();
+}
+
+// ****************************
+// Private Functions
+// ****************************
+
+bool KMI_CaptureReplay::peek()
+{
+    if (!hasPending) hasPending = reader.next(pending);
+    return hasPending;
+}
+
+void KMI_CaptureReplay::feed(const KMI_CaptureEvent &event, qint64 timestampNs)
+{
+    if (event.direction == CAPTURE_TX)
+    {
+        emit signalReplayTx(QByteArray(reinterpret_cast<const char *>(event.data), int(event.length)), timestampNs);
+        return;
+    }
+
+    // same routing as MidiDeviceManager::midiInCallback, rx records are callbacks so sysex may be in pieces
+    int sysExState = sysExPool.feed(event.data, event.length);
+    if (sysExState == RX_SYSEX_PENDING || sysExState == RX_SYSEX_DROPPED) return;
+
+    if (sysExState == RX_SYSEX_NOT_SYSEX)
+    {
+        mdm->parseMessage(event.data, event.length, timestampNs);
+        if (mdm->rxBatchMode) mdm->slotFlushRxBatch();
+    }
+    else
+    {
+        std::vector<unsigned char> *message = &sysExMessage;
+        if (sysExState == RX_SYSEX_COMPLETE) message = sysExPool.vector(sysExPool.completed());
+        else sysExMessage.assign(event.data, event.data + event.length);
+
+        mdm->rxEventTimestampNs = timestampNs;
+        mdm->slotProcessSysEx(QByteArray::fromRawData(reinterpret_cast<const char *>(message->data()), int(message->size())), message);
+        if (sysExState == RX_SYSEX_COMPLETE) sysExPool.release(sysExPool.completed());
+    }
+}
+
+// the next record plays now, later ones keep their spacing
+void KMI_CaptureReplay::anchor()
+{
+    anchorHostNs = kmiHostTimeNs();
+    anchorCaptureNs = peek() ? pending.timestampNs : 0;
+}
+
+qint64 KMI_CaptureReplay::replayTimeNs(qint64 captureNs) const
+{
+    if (replaySpeed <= 0) return anchorHostNs;
+    return anchorHostNs + qint64(double(captureNs - anchorCaptureNs) / replaySpeed);
+}
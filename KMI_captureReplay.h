@@ -0,0 +1,89 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_CAPTUREREPLAY_H
+#define KMI_CAPTUREREPLAY_H
+
+/* KMI Capture Replay
+
+  Feeds a capture log (KMI_capture.h) back into a MidiDeviceManager, as if the device sent it again.
+
+  - rx records go through the same entry points as the RtMidi callback: parseMessage for
+    channel/system messages and slotProcessSysEx for sysex (pieces joined first), so a firmware update or an editor
+    session can be reproduced offline without the hardware
+  - tx records are not sent, they are reported with signalReplayTx so a test can compare what
+    the manager sends now with what it sent then
+  - setSpeed(1.0) keeps the original timing, 2.0 twice as fast, 0 replays as fast as possible
+  - events are stamped with the host time they are replayed at, on the original timeline scaled
+    by the speed, so rx latency metrics stay meaningful
+  - seek by record or by time (ns from the first record), KMI_CaptureReader does the indexing
+
+  Runs on the target's thread, connect to it from elsewhere with queued connections.
+
+*/
+
+#include <QObject>
+#include <QTimer>
+#include <QByteArray>
+#include <vector>
+
+#include "KMI_capture.h"
+#include "KMI_rxSysEx.h"
+
+class MidiDeviceManager;
+
+#define CAPTURE_REPLAY_BATCH 1024 // records fed per event loop pass at full speed
+
+class KMI_CaptureReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KMI_CaptureReplay(MidiDeviceManager *target, QObject *parent = nullptr);
+
+    bool open(QString filePath);
+    const KMI_CaptureReader &log() const { return reader; }
+
+    void setSpeed(double speed) { replaySpeed = speed > 0 ? speed : 0; } // 0 = as fast as possible
+    bool isRunning() const { return running; }
+    quint64 position() const { return hasPending ? pending.record : reader.position(); }
+
+    // replay everything from the current position on this thread without yielding, for benchmarks.
+    // Returns the number of rx records fed.
+    quint64 replayAll();
+
+signals:
+    void signalReplayTx(QByteArray bytes, qint64 timestampNs);
+    void signalReplayFinished();
+
+public slots:
+    void slotStart();
+    void slotStop();
+    void slotSeekRecord(quint64 record);
+    void slotSeekTime(qint64 offsetNs); // from the first record
+
+private slots:
+    void slotServiceReplay();
+
+private:
+    bool peek();
+    void feed(const KMI_CaptureEvent &event, qint64 timestampNs);
+    void anchor();
+    qint64 replayTimeNs(qint64 captureNs) const;
+
+    MidiDeviceManager *mdm;
+    KMI_CaptureReader reader;
+    QTimer replayTimer;
+    double replaySpeed;
+    bool running;
+
+    KMI_CaptureEvent pending;           // next record, read ahead to get its due time
+    bool hasPending;
+    qint64 anchorHostNs;                // host time the replay (re)started at
+    qint64 anchorCaptureNs;             // capture time of the first record replayed from there
+
+    std::vector<unsigned char> sysExMessage; // reused for slotProcessSysEx
+    KMI_RxSysExPool sysExPool;          // joins sysex captured in pieces, sized like the target's
+};
+
+#endif // KMI_CAPTUREREPLAY_H
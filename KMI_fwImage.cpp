@@ -0,0 +1,136 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Firmware Image
+
+  See KMI_fwImage.h for details.
+
+*/
+
+#include "KMI_fwImage.h"
+#include "midi.h"
+#include <QDebug>
+
+KMI_FwImage::KMI_FwImage()
+{
+    imageData = nullptr;
+    imageSize = 0;
+    sysExCount = 0;
+    mapped = false;
+}
+
+KMI_FwImage::~KMI_FwImage()
+{
+    if (mapped)
+    {
+        file.unmap(const_cast<uchar *>(imageData));
+    }
+    file.close();
+}
+
+// ****************************
+// Factories
+// ****************************
+
+KMI_FwImagePtr KMI_FwImage::open(QString filePath, QString *errorString)
+{
+    std::shared_ptr<KMI_FwImage> image(new KMI_FwImage());
+
+    image->path = filePath;
+    image->file.setFileName(filePath);
+
+    if (!image->file.open(QIODevice::ReadOnly))
+    {
+        if (errorString) *errorString = QString("couldn't open %1: %2").arg(filePath, image->file.errorString());
+        return nullptr;
+    }
+
+    qint64 fileSize = image->file.size();
+    if (fileSize <= 0 || fileSize > 0x7FFFFFFF)
+    {
+        if (errorString) *errorString = QString("%1 has an invalid size: %2").arg(filePath).arg(fileSize);
+        return nullptr;
+    }
+
+    uchar *mapping = image->file.map(0, fileSize);
+    if (mapping != nullptr)
+    {
+        image->imageData = mapping;
+        image->imageSize = (int)fileSize;
+        image->mapped = true;
+    }
+    else
+    {
+        // compressed resources and some file systems can't be mapped, keep one copy in memory
+        image->owned = image->file.readAll();
+        image->file.close();
+        image->imageData = reinterpret_cast<const unsigned char *>(image->owned.constData());
+        image->imageSize = image->owned.size();
+    }
+
+    if (!image->validate(errorString)) return nullptr;
+
+    qDebug() << "KMI_FwImage loaded: " << filePath << " bytes: " << image->imageSize
+             << " messages: " << image->sysExCount << " mapped: " << image->mapped;
+    return image;
+}
+
+KMI_FwImagePtr KMI_FwImage::fromByteArray(QByteArray imageArray, QString *errorString)
+{
+    std::shared_ptr<KMI_FwImage> image(new KMI_FwImage());
+
+    image->owned = imageArray; // implicitly shared with the caller
+    image->imageData = reinterpret_cast<const unsigned char *>(image->owned.constData());
+    image->imageSize = image->owned.size();
+
+    if (!image->validate(errorString)) return nullptr;
+    return image;
+}
+
+// ****************************
+// Private Functions
+// ****************************
+
+// one or more complete sysex messages, nothing but 7 bit data between F0 and F7
+bool KMI_FwImage::validate(QString *errorString)
+{
+    bool inSysEx = false;
+    sysExCount = 0;
+
+    for (int i = 0; i < imageSize; i++)
+    {
+        unsigned char byte = imageData[i];
+
+        if (byte == MIDI_SX_START)
+        {
+            if (inSysEx)
+            {
+                if (errorString) *errorString = QString("unterminated sysex before offset %1").arg(i);
+                return false;
+            }
+            inSysEx = true;
+        }
+        else if (byte == MIDI_SX_STOP)
+        {
+            if (!inSysEx)
+            {
+                if (errorString) *errorString = QString("sysex end without start at offset %1").arg(i);
+                return false;
+            }
+            inSysEx = false;
+            sysExCount++;
+        }
+        else if (!inSysEx || byte & 0x80)
+        {
+            if (errorString) *errorString = QString("unexpected byte 0x%1 at offset %2").arg(byte, 2, 16, QChar('0')).arg(i);
+            return false;
+        }
+    }
+
+    if (inSysEx || sysExCount == 0)
+    {
+        if (errorString) *errorString = QString("image doesn't end with a complete sysex message");
+        return false;
+    }
+    return true;
+}
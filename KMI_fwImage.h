@@ -0,0 +1,62 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_FWIMAGE_H
+#define KMI_FWIMAGE_H
+
+/* KMI Firmware Image
+
+  Read-only firmware/bootloader sysex image, memory mapped and shared by reference count.
+
+  - KMI_FwImage::open maps the file (QFile::map), if the file can't be mapped (ie a compressed
+    Qt resource) it is read into memory once instead
+  - the sysex framing is checked once at load: the image must be one or more complete
+    F0 ... F7 messages with only 7 bit data in between. A bad image never reaches the TX path.
+  - hold a KMI_FwImagePtr for as long as the data is in use, the TX queue keeps one per queued
+    segment so the mapping outlives a transfer even if the editor loads another file mid send
+
+*/
+
+#include <QString>
+#include <QFile>
+#include <QByteArray>
+#include <memory>
+
+class KMI_FwImage;
+typedef std::shared_ptr<const KMI_FwImage> KMI_FwImagePtr;
+
+class KMI_FwImage
+{
+public:
+    ~KMI_FwImage();
+
+    // nullptr on failure, errorString (optional) says why
+    static KMI_FwImagePtr open(QString filePath, QString *errorString = nullptr);
+    static KMI_FwImagePtr fromByteArray(QByteArray image, QString *errorString = nullptr);
+
+    const unsigned char *data() const { return imageData; }
+    int size() const { return imageSize; }
+    int messageCount() const { return sysExCount; } // number of F0 ... F7 messages
+    bool isMapped() const { return mapped; }
+    QString filePath() const { return path; }
+
+    // QByteArray view of the image without copying, only valid while this image is alive
+    QByteArray bytes() const { return QByteArray::fromRawData((const char *)imageData, imageSize); }
+
+private:
+    KMI_FwImage();
+    KMI_FwImage(const KMI_FwImage &) = delete;
+    KMI_FwImage &operator=(const KMI_FwImage &) = delete;
+
+    bool validate(QString *errorString);
+
+    QFile file;                 // kept open while mapped
+    QByteArray owned;           // fallback storage when mapping isn't possible
+    QString path;
+    const unsigned char *imageData;
+    int imageSize;
+    int sysExCount;
+    bool mapped;
+};
+
+#endif // KMI_FWIMAGE_H
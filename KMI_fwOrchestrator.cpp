@@ -0,0 +1,209 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Firmware Orchestrator
+
+  See KMI_fwOrchestrator.h for details.
+
+*/
+
+#include "KMI_fwOrchestrator.h"
+#include "KMI_mdm.h"
+#include <QDebug>
+
+KMI_FwOrchestrator::KMI_FwOrchestrator(QObject *parent) : QObject(parent)
+{
+    maxParallel = 0;
+    running = false;
+}
+
+// ****************************
+// Public Functions
+// ****************************
+
+bool KMI_FwOrchestrator::loadFirmware(QString filePath)
+{
+    QString error;
+    firmwareImage = KMI_FwImage::open(filePath, &error);
+    if (!firmwareImage)
+    {
+        qDebug() << "KMI_FwOrchestrator: firmware file rejected: " << error;
+        return false;
+    }
+    return true;
+}
+
+bool KMI_FwOrchestrator::loadBootloader(QString filePath)
+{
+    QString error;
+    bootloaderImage = KMI_FwImage::open(filePath, &error);
+    if (!bootloaderImage)
+    {
+        qDebug() << "KMI_FwOrchestrator: bootloader file rejected: " << error;
+        return false;
+    }
+    return true;
+}
+
+void KMI_FwOrchestrator::addDevice(MidiDeviceManager *mdm)
+{
+    if (mdm == nullptr || findDevice(mdm) != -1) return;
+
+    KMI_FwDevice device;
+    device.mdm = mdm;
+    device.state = FWO_DEVICE_QUEUED;
+    device.percent = 0;
+    devices.append(device);
+
+    connect(mdm, SIGNAL(signalFwProgress(int)), this, SLOT(slotDeviceProgress(int)));
+    connect(mdm, SIGNAL(signalFwConsoleMessage(QString)), this, SLOT(slotDeviceConsoleMessage(QString)));
+    connect(mdm, SIGNAL(signalFirmwareUpdateComplete(bool)), this, SLOT(slotDeviceComplete(bool)));
+    connect(mdm, SIGNAL(destroyed(QObject*)), this, SLOT(slotDeviceDestroyed(QObject*)));
+
+    if (running) startQueued(); // joined a run in progress
+}
+
+void KMI_FwOrchestrator::removeDevice(MidiDeviceManager *mdm)
+{
+    int index = findDevice(mdm);
+    if (index == -1) return;
+
+    disconnect(mdm, nullptr, this, nullptr);
+    devices.removeAt(index);
+
+    if (running) startQueued(); // frees a slot, or finishes the run
+}
+
+// ****************************
+// Public Slots
+// ****************************
+
+void KMI_FwOrchestrator::slotStart()
+{
+    if (running) return;
+
+    if (!firmwareImage)
+    {
+        qDebug() << "KMI_FwOrchestrator: no firmware image loaded";
+        emit signalComplete(0, devices.size());
+        return;
+    }
+
+    for (int i = 0; i < devices.size(); i++)
+    {
+        devices[i].state = FWO_DEVICE_QUEUED;
+        devices[i].percent = 0;
+    }
+
+    running = true;
+    reportProgress();
+    startQueued();
+}
+
+// ****************************
+// Private Slots
+// ****************************
+
+void KMI_FwOrchestrator::slotDeviceProgress(int thisPercent)
+{
+    int index = findDevice(sender());
+    if (index == -1 || devices[index].state != FWO_DEVICE_RUNNING) return;
+
+    devices[index].percent = thisPercent;
+    emit signalDeviceProgress(devices[index].mdm, thisPercent);
+    reportProgress();
+}
+
+void KMI_FwOrchestrator::slotDeviceConsoleMessage(QString message)
+{
+    int index = findDevice(sender());
+    if (index == -1 || devices[index].state != FWO_DEVICE_RUNNING) return;
+
+    emit signalDeviceConsoleMessage(devices[index].mdm, message);
+}
+
+void KMI_FwOrchestrator::slotDeviceComplete(bool success)
+{
+    int index = findDevice(sender());
+    if (index == -1 || devices[index].state != FWO_DEVICE_RUNNING) return;
+
+    devices[index].state = success ? FWO_DEVICE_SUCCESS : FWO_DEVICE_FAIL;
+    devices[index].percent = 100;
+    emit signalDeviceComplete(devices[index].mdm, success);
+
+    reportProgress();
+    startQueued();
+}
+
+void KMI_FwOrchestrator::slotDeviceDestroyed(QObject *obj)
+{
+    int index = findDevice(obj);
+    if (index == -1) return;
+
+    devices.removeAt(index);
+    if (running) startQueued();
+}
+
+// ****************************
+// Private Functions
+// ****************************
+
+int KMI_FwOrchestrator::findDevice(QObject *obj)
+{
+    for (int i = 0; i < devices.size(); i++)
+    {
+        if (devices[i].mdm == obj) return i;
+    }
+    return -1;
+}
+
+void KMI_FwOrchestrator::startQueued()
+{
+    int runningCount = 0;
+    int succeeded = 0, failed = 0;
+
+    for (int i = 0; i < devices.size(); i++)
+    {
+        if (devices[i].state == FWO_DEVICE_RUNNING) runningCount++;
+    }
+
+    for (int i = 0; i < devices.size(); i++)
+    {
+        if (maxParallel > 0 && runningCount >= maxParallel) break;
+        if (devices[i].state != FWO_DEVICE_QUEUED) continue;
+
+        MidiDeviceManager *mdm = devices[i].mdm;
+        devices[i].state = FWO_DEVICE_RUNNING;
+        runningCount++;
+
+        qDebug() << "KMI_FwOrchestrator: starting update for " << mdm->objectName;
+
+        // reference counted, every manager points at the same mapping
+        mdm->slotSetFirmwareImage(firmwareImage);
+        if (bootloaderImage) mdm->slotSetBootloaderImage(bootloaderImage);
+        mdm->slotRequestFirmwareUpdate();
+    }
+
+    if (runningCount) return;
+
+    for (int i = 0; i < devices.size(); i++)
+    {
+        if (devices[i].state == FWO_DEVICE_SUCCESS) succeeded++;
+        else if (devices[i].state == FWO_DEVICE_FAIL) failed++;
+    }
+
+    running = false;
+    emit signalComplete(succeeded, failed);
+}
+
+void KMI_FwOrchestrator::reportProgress()
+{
+    if (devices.isEmpty()) return;
+
+    int total = 0;
+    for (int i = 0; i < devices.size(); i++)
+    {
+        total += devices[i].percent;
+    }
+    emit signalProgress(total / devices.size());
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_FWORCHESTRATOR_H
+#define KMI_FWORCHESTRATOR_H
+
+/* KMI Firmware Orchestrator
+
+  Runs the firmware update pipelines of several MidiDeviceManager instances at once, ie a rack of
+  SoftSteps or 12 Steps.
+
+  - one read-only, memory mapped copy of the firmware (and bootloader) image, shared into every manager
+  - each manager keeps its own state machine, they advance on events (replies, send complete)
+    so one slow unit doesn't hold up the others
+  - maxParallel limits how many transfers run at the same time, 0 = all of them
+  - progress from every device is folded into one percentage
+
+  Each manager must be attached to its own ports before it is added.
+
+*/
+
+#include <QObject>
+#include <QList>
+#include "KMI_fwImage.h"
+
+class MidiDeviceManager;
+
+enum
+{
+    FWO_DEVICE_QUEUED,
+    FWO_DEVICE_RUNNING,
+    FWO_DEVICE_SUCCESS,
+    FWO_DEVICE_FAIL
+};
+
+typedef struct
+{
+    MidiDeviceManager *mdm;
+    int state;          // FWO_DEVICE_*
+    int percent;        // last signalFwProgress value
+} KMI_FwDevice;
+
+class KMI_FwOrchestrator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KMI_FwOrchestrator(QObject *parent = nullptr);
+
+    KMI_FwImagePtr firmwareImage;   // shared with every manager, read-only
+    KMI_FwImagePtr bootloaderImage;
+    int maxParallel;                // 0 = update every device at once
+
+    bool loadFirmware(QString filePath);
+    bool loadBootloader(QString filePath);
+
+    void addDevice(MidiDeviceManager *mdm);
+    void removeDevice(MidiDeviceManager *mdm);
+    int deviceCount() { return devices.size(); }
+    bool isRunning() { return running; }
+
+signals:
+    void signalProgress(int percent);                           // all devices combined
+    void signalDeviceProgress(MidiDeviceManager *mdm, int percent);
+    void signalDeviceConsoleMessage(MidiDeviceManager *mdm, QString message);
+    void signalDeviceComplete(MidiDeviceManager *mdm, bool success);
+    void signalComplete(int succeeded, int failed);
+
+public slots:
+    void slotStart();               // update every device that was added
+
+private slots:
+    void slotDeviceProgress(int thisPercent);
+    void slotDeviceConsoleMessage(QString message);
+    void slotDeviceComplete(bool success);
+    void slotDeviceDestroyed(QObject *obj);
+
+private:
+    QList<KMI_FwDevice> devices;
+    bool running;
+
+    int findDevice(QObject *obj);
+    void startQueued();             // start devices until maxParallel are running
+    void reportProgress();
+};
+
+#endif // KMI_FWORCHESTRATOR_H
@@ -28,17 +28,43 @@
 #include "KMI_mdm.h"
 #include "KMI_DevData.h"
 #include "KMI_SysexMessages.h"
-#include <QMessageBox>
+#include "kmiSysEx/kmiSysExCodec.h"
+#include "KMI_fwImage.h"
 #include <QThread>
 
+// define KMI_MDM_HEADLESS (ie for a QCoreApplication service) to build without QtWidgets,
+// error popups are then only reported through signalErrorMessage
+#ifndef KMI_MDM_HEADLESS
+#include <QApplication>
+#include <QMessageBox>
+#endif
+
 //#define MDM_DEBUG_ENABLED 1
 
 // debugging macro
 #define DM_OUT qDebug() << deviceName << ": "
 #define DM_OUT_P qDebug() << thisMidiDeviceManager->objectName << ": "
 
-MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objectNameInit, KMI_Ports *kmiP) :
-    QWidget(parent)
+// per message logging, compiled out unless MDM_DEBUG_ENABLED, use getMetrics to watch traffic
+#ifdef MDM_DEBUG_ENABLED
+#define DM_VERBOSE DM_OUT
+#else
+#define DM_VERBOSE if (true) {} else DM_OUT
+#endif
+
+// per-state deadlines, measured from entering the state. A transfer in progress keeps restarting it.
+#define FW_GLOBALS_RESEND_MS        10000   // ask for the globals backup once more
+#define FW_GLOBALS_TIMEOUT_MS       20000   // then carry on without it
+#define FW_REBOOT_TIMEOUT_MS        35000   // BL_SENT_WAIT/FW_SENT_WAIT, the device must be back by then
+#define FW_TIMEOUT_COUNTDOWN_MS     10000   // console countdown before a reboot timeout
+#define FW_VER_REQUEST_INTERVAL_MS  5000    // fw version/identity request repeat while polling
+#define HANDSHAKE_IDLE_MS           1000    // nothing due, only picks up flags editors write directly
+
+static const int fwIdResendMs[] = { 13000, 23000, 30000 }; // ID request resends while waiting for a reboot
+#define FW_ID_RESENDS               (int)(sizeof(fwIdResendMs) / sizeof(fwIdResendMs[0]))
+
+MidiDeviceManager::MidiDeviceManager(QObject *parent, int initPID, QString objectNameInit, KMI_Ports *kmiP) :
+    QObject(parent)
 {
     sessionSettings = new QSettings(this);
 
@@ -106,7 +132,6 @@ MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objec
     // flags
     connected = false;
     restart = false;
-    ioGate = true; // open gate
     port_in_open = false;
     port_out_open = false;
     callbackIsSet = false;
@@ -117,8 +142,64 @@ MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objec
     bootloaderMode = false;
     pollingStatus = false;
 
+    // no running status until the first channel message arrives
+    rxRunningStatus = 0;
+    rxRunningChan = 0;
+
+    // batch delivery is opt in, default to per event signals only
+    qRegisterMetaType<MidiEventSpan>("MidiEventSpan");
+    rxBatchMode = false;
+    rxBatchCoalesce = false;
+    rxPerEventSignals = true;
+    memset(rxCoalesceCC, 0xFF, sizeof(rxCoalesceCC)); // -1, not in a batch
+    memset(rxCoalescePolyAT, 0xFF, sizeof(rxCoalescePolyAT));
+    memset(rxCoalesceBend, 0xFF, sizeof(rxCoalesceBend));
+    memset(rxCoalescePressure, 0xFF, sizeof(rxCoalescePressure));
+
+    // rx ring is disabled by default, messages are parsed inside the RtMidi callback
+    rxRingMode = false;
+    rxRingDrainPending = false;
+    rxEventTimestampNs = 0;
+
+    // realtime messages go through the parser like everything else until slotSetRxRealtimeFastPath
+    rxRealtimeFastPath = false;
+    rxRealtimeEmitPending = false;
+    rxIgnoreTiming = rxIgnoreSense = false;
+    rxTempoReported = 0;
+    rxBeatReported = 0;
+    rxTransportReported = false;
+
+    // the sysex pool reserves its buffers when the in port opens
+    rxSysExMaxSize = RX_SYSEX_MAX_SIZE;
+
+    // metrics are always collected, the periodic signal is opt in
+    qRegisterMetaType<KMI_MetricsSnapshot>("KMI_MetricsSnapshot");
+    metricsTimer = nullptr;
+    portOutOpens = 0;
+
+    // capture is off until slotStartCapture
+    capture = new KMI_CaptureWriter(this);
+    connect(capture, &KMI_CaptureWriter::signalCaptureError, this, [this](QString errorMessage)
+    {
+        DM_OUT << errorMessage;
+        emit signalErrorMessage(errorMessage);
+    });
+
+    // RPN/NRPN state, reset again whenever the output port opens
+    slotInitNRPN();
+
+    // short messages wait in their lane until the next tx pass
+    txLaneBytes = 0;
+    txSysExOpen = false;
+
     // break up sysex, default is disabled
-    syxExTxChunkTimer.start(); // timer for chunk speedlimit
+    syxExTxChunkTimer.start(); // clock for chunk pacing deadlines
+    sysExTxSendLastChunk = false;
+    sysExTxByteRate = 0; // derive the rate from chunk size/delay
+    sysExTxNextChunkNs = 0;
+    sysExTxBurstStartNs = -1;
+    sysExTxBurstBytes = 0;
+    sysExTxAchievedRate = 0;
 
 #ifdef Q_OS_LINUX
     sysExTxChunkSize = 512; //
@@ -128,8 +209,23 @@ MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objec
     sysExTxChunkDelay = 1; // should slow down a 100k payload to ten seconds
 #endif
 
+    // adaptive chunking is opt in, starts from the product defaults above
+    sysExTxAdaptive = false;
+    sysExTxAckCredits = false;
+    sysExTxAckFallback = false;
+    sysExTxBaseChunkSize = sysExTxChunkSize;
+    sysExTxBaseRate = 0;
+    sysExTxAdaptiveRate = 0;
+    sysExTxAdaptSuccesses = 0;
+    sysExTxAdaptRetries = 0;
+    sysExTxCredits = TX_ACK_WINDOW;
+    sysExTxCreditWaitNs = -1;
+
     // init machine states
     firmwareUpdateState = FWUD_STATE_IDLE;
+    fwStepQueued = false;
+    fwResendCount = 0;
+    fwCountdownLast = -1;
     installingBootloader = BL_INSTALL_FALSE;
 
     firmwareUpdateStateTimer.start(); // a timer to track elapsed ms since last state change
@@ -142,15 +238,18 @@ MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objec
     // setup RtMidi connections
     midi_in = new RtMidiIn();
     midi_out = new RtMidiOut();
+    txThread = nullptr; // sends run on the calling thread until slotSetTxThread
     //midi_in = nullptr;
     //midi_out = nullptr;
+    portTableVersionChecked = 0; // verify ports on the first poll
 
     // firmware and bootloader timeout timer
     //timeoutFwBl = new QTimer(this);
 
     // this will become the heartbeat of our polling/firmware update process
     versionPoller = new QTimer(this);
-    versionPoller->start(1000); // start the timer
+    versionPoller->setSingleShot(true); // re-armed by scheduleHandshake for whatever is due next
+    versionPoller->start(HANDSHAKE_IDLE_MS); // start the timer
 
 //    versionReplyTimer.start();
 //    refreshTimer.start();
@@ -163,9 +262,10 @@ MidiDeviceManager::MidiDeviceManager(QWidget *parent, int initPID, QString objec
 //    connect(this, SIGNAL(signalBeginFwTimer()), this, SLOT(slotBeginFwTimer()));
 //    connect(this, SIGNAL(signalStopGlobalTimer()), this, SLOT(slotStopGlobalTimer()));
 
-    // Configure the timer
-    midiSendTimer.setInterval(1); // Set interval to 1 ms
-    connect(&midiSendTimer, &QTimer::timeout, this, &MidiDeviceManager::slotEmptyMIDIBuffer);
+    // Configure the tx timer, armed on demand for the next chunk deadline instead of polling
+    midiSendTimer.setSingleShot(true);
+    midiSendTimer.setTimerType(Qt::PreciseTimer);
+    connect(&midiSendTimer, &QTimer::timeout, this, &MidiDeviceManager::slotServiceTx);
 
     if (PID != PID_AUX)
     {
@@ -216,49 +316,17 @@ bool MidiDeviceManager::slotUpdatePortOut(int port)
 QByteArray MidiDeviceManager::decode8BitArray(QByteArray this8BitArray)
 {
     DM_OUT << "decode8BitArray called";
-    int         numPackets = ceil(double(this8BitArray.size() / 8));
-    int         counter = 0;
-    uchar       buffer[8];
-    QByteArray  decodedArray;
 
-    for(int thisPacket = 0; thisPacket < numPackets; thisPacket++)
+    if (this8BitArray.size() % 8)
     {
-        // fill buffer with 8 bytes from array
-        for(uchar thisByte = 0; thisByte < 8; thisByte++)
-        {
-            int thisIndex = (thisByte + (thisPacket * 8));
-            if (thisIndex < this8BitArray.size())
-            {
-                buffer[thisByte] = this8BitArray.at(thisIndex);
-            }
-            else
-            {
-                buffer[thisByte] = 0; //
-                DM_OUT << "7bit to 8bit array conversion - last packet is truncated - Packet: " << thisPacket << "Byte: " << thisByte << " index: " << thisIndex;
-            }
-        }
-
-        //Decode packet
-        for(uchar thisByte = 0; thisByte < 7; thisByte++)
-        {
-            //If decode byte bit 0 is high
-            if(buffer[7] & 0x01)
-            {
-                buffer[thisByte] |= 0x80; // set bit 7 high
-            }
+        DM_OUT << "7bit to 8bit array conversion - last packet is truncated - size: " << this8BitArray.size();
+    }
 
-            buffer[7] >>=1; // shift decode buffer right by 1
+    // sized once, the whole array is converted in 8 byte groups
+    QByteArray decodedArray(int(kmi_sx_decoded_size(this8BitArray.size())), 0);
+    kmi_sx_decode(reinterpret_cast<const uint8_t*>(this8BitArray.constData()), this8BitArray.size(),
+                  reinterpret_cast<uint8_t*>(decodedArray.data()));
 
-            // stay in bounds
-            if (counter < this8BitArray.size())
-            {
-                // byte is decoded, stuff it into the array
-                decodedArray.append(buffer[thisByte]);
-                //DM_OUT << "8bit - packet: " << thisPacket << "Byte: " << thisByte << " data: " << buffer[thisByte];
-            }
-            counter++;
-        }
-    }
     //DM_OUT << "Returning...";
     return decodedArray;
 }
@@ -289,6 +357,9 @@ bool MidiDeviceManager::slotOpenMidiIn()
         // setup RtMidi connections
 
         //open ports
+        rxClock.reset(); // new timeline, RtMidi restarts its deltas
+        rxRealtime.reset();
+        rxSysExPool.configure(rxSysExMaxSize); // callback isn't installed yet
         midi_in->openPort(port_in);
 
         // setup callback
@@ -296,8 +367,8 @@ bool MidiDeviceManager::slotOpenMidiIn()
         midi_in->setCallback( &MidiDeviceManager::midiInCallback, this);
         callbackIsSet = true;
 
-        // Don't ignore sysex, timing, or active sensing messages.
-        midi_in->ignoreTypes( false, false, false );
+        // Don't ignore sysex, timing and active sensing unless slotSetRxRealtimeIgnore asked for it
+        midi_in->ignoreTypes( false, rxIgnoreTiming, rxIgnoreSense );
     }
     catch (RtMidiError &error)
     {
@@ -313,6 +384,8 @@ bool MidiDeviceManager::slotOpenMidiIn()
     }
 
     portName_in = kmiPorts->getInPortName(port_in);
+    portTableVersionChecked = 0; // verify the new port against the table on the next poll
+    handshakeKick(); // port appeared, request the version now rather than on a tick
     port_in_open = true;
 
     if (PID == PID_AUX && !connected) // aux ports don't need firmware to match for connect
@@ -349,7 +422,11 @@ bool MidiDeviceManager::slotOpenMidiOut()
     try
     {
         //open ports
-        midi_out->openPort(port_out);
+        midiOutCall([this](RtMidiOut *&out)
+        {
+            out->openPort(port_out);
+            txBatch.setDestination(port_out); // short message batches go straight to the same port
+        });
     }
     catch (RtMidiError &error)
     {
@@ -365,9 +442,12 @@ bool MidiDeviceManager::slotOpenMidiOut()
         return 0;
     }
     portName_out = kmiPorts->getOutPortName(port_out);
+    if (portOutOpens++ > 0) KMI_Metrics::add(metrics.reconnects);
+    portTableVersionChecked = 0; // verify the new port against the table on the next poll
+    handshakeKick(); // port appeared, request the version now rather than on a tick
     port_out_open = true;
     slotInitNRPN(); // zero out previous paramaters sent/received
-    midiSendTimer.start();
+    scheduleTx(); // resume anything still queued
 
     if (PID == PID_AUX && !connected) // aux ports don't need firmware to match for connect
     {
@@ -460,11 +540,13 @@ bool MidiDeviceManager::slotCloseMidiOut(bool signal)
 
     port_out_open = false;
     midiSendTimer.stop();
+    sysExTxBurstStartNs = -1; // transfer interrupted, don't report a rate for it
     portName_out = "";
 
     if (firmwareUpdateState == FWUD_STATE_BL_MODE && installingBootloader == BL_INSTALL_PENDING)
     {
         installingBootloader = BL_INSTALL_DEVICE_DISCONNECTED;
+        handshakeKick(); // BL_MODE is waiting for this
     }
 
     // alert host application that we are disconnected
@@ -474,7 +556,7 @@ bool MidiDeviceManager::slotCloseMidiOut(bool signal)
         if (signal == SIGNAL_SEND) emit signalConnected(false);
     }
 
-    if (midi_out == nullptr)
+    if (midi_out == nullptr && txThread == nullptr)
     {
         DM_OUT << "WARNING: midi_out was not instantiated, assuming port is closed";
         return 1; // handler doesn't exist
@@ -482,21 +564,26 @@ bool MidiDeviceManager::slotCloseMidiOut(bool signal)
 
     try
     {
-        //close ports
-        midi_out->closePort();
+        // runs on the tx thread if there is one, this thread waits so the members are safe to use
+        midiOutCall([this](RtMidiOut *&out)
+        {
+            //close ports
+            txBatch.clearDestination();
+            out->closePort();
 
 #ifdef Q_OS_WINDOWS
-        delete midi_in;
-        midi_in = new RtMidiIn();
+            delete out;
+            out = new RtMidiOut();
 #else
-        if (bootloaderMode)
-        {
-            DM_OUT << "left bootloader, deleting/renewing midi_out";
-            delete midi_out;
-            midi_out = new RtMidiOut();
-            bootloaderMode = false;
-        }
+            if (bootloaderMode)
+            {
+                DM_OUT << "left bootloader, deleting/renewing midi_out";
+                delete out;
+                out = new RtMidiOut();
+                bootloaderMode = false;
+            }
 #endif
+        });
     }
     catch (RtMidiError &error)
     {
@@ -524,14 +611,17 @@ bool MidiDeviceManager::slotCreateVirtualIn(QString portName)
         //midi_in = new RtMidiIn(); // refresh RtMidi
 
         // create/open port
+        rxClock.reset();
+        rxRealtime.reset();
+        rxSysExPool.configure(rxSysExMaxSize); // callback isn't installed yet
         midi_in->openVirtualPort(portName.toStdString());
 
         // setup callback
         midi_in->setCallback( &MidiDeviceManager::midiInCallback, this);
         callbackIsSet = true;
 
-        // Don't ignore sysex, timing, or active sensing messages.
-        midi_in->ignoreTypes( false, false, false );
+        // Don't ignore sysex, timing and active sensing unless slotSetRxRealtimeIgnore asked for it
+        midi_in->ignoreTypes( false, rxIgnoreTiming, rxIgnoreSense );
     }
     catch (RtMidiError &error)
     {
@@ -564,7 +654,12 @@ bool MidiDeviceManager::slotCreateVirtualOut(QString portName)
         //midi_out = new RtMidiOut(); // refresh instance
 
         // create/open ports
-        midi_out->openVirtualPort(portName.toStdString());
+        std::string name = portName.toStdString();
+        midiOutCall([this, &name](RtMidiOut *&out)
+        {
+            txBatch.clearDestination(); // no CoreMIDI destination to batch to, use RtMidi
+            out->openVirtualPort(name);
+        });
     }
     catch (RtMidiError &error)
     {
@@ -580,7 +675,7 @@ bool MidiDeviceManager::slotCreateVirtualOut(QString portName)
     }
     portName_out = portName;
     port_out_open = true;
-    midiSendTimer.start();
+    scheduleTx(); // resume anything still queued
     connected = true;
     emit signalConnected(true);
     return 1;
@@ -610,12 +705,10 @@ void MidiDeviceManager::slotStartPolling(QString caller)
 
     //slotStopPolling("slotStartPolling clearing before enable");
 
-    int pollTime = 1000;
-
     //versionPoller = new QTimer(this);
-    connect(versionPoller, SIGNAL(timeout()), this, SLOT(slotPollVersion()));
+    connect(versionPoller, SIGNAL(timeout()), this, SLOT(slotPollVersion()), Qt::UniqueConnection);
 
-    versionPoller->setInterval(pollTime);
+    handshakeKick(); // don't wait for a tick, the ports may already be up
 
     //pollingStatus = true; // allow polling to proceed
 }
@@ -634,33 +727,280 @@ void MidiDeviceManager::slotStopPolling(QString caller) // this has to be called
 // 2. Editor sets pollingStatus to true, fwVer/SysExID request is sent
 // 3. Reply received
 
-// Call this every X seconds
+// Called whenever something happens (ports opened, reply received, state change, transfer done)
+// and at the next deadline otherwise, there is no fixed heartbeat:
 // 1. Test if midi system and ports are set up
 // 1. test if we need to send a fw version/identity request
 // 2. run through the firmware update state machine switch case
-
-#define FW_UPDATE_TIMEOUT_INTERVAL 35000
+// 3. re-arm versionPoller for whatever is due next, see scheduleHandshake
 
 void MidiDeviceManager::slotPollVersion()
 {
-    QString thisVersion;
     bool portsAreSetUp = (port_in == -1 || port_out == -1 || !port_in_open || !port_out_open) ? false : true;
 
     //DM_OUT << "slotPollVersion called - pollingStatus: " << pollingStatus << " firmwareUpdateState: " << firmwareUpdateState << " portsAreSetUp: " << portsAreSetUp << " bootloaderMode:" << bootloaderMode << " fwVerPollSkipConnectCycles: " << fwVerPollSkipConnectCycles;
     //if (!portsAreSetUp) DM_OUT << "port_in: " << port_in << " port_out: " << port_out << " port_in_open: " << port_in_open << " port_out_open: " << port_out_open;
 
-    int remainingSeconds = round((FW_UPDATE_TIMEOUT_INTERVAL - firmwareUpdateStateTimer.elapsed()) / 1000);
+    if (!fwUpdateStep()) // no firmware file, skip the version request this time
+    {
+        scheduleHandshake();
+        return;
+    }
+
+    // Send fwVer/identity request?
+    if (pollingStatus && portsAreSetUp)
+    {
+        // test if our ports still match, only needed when the shared port table changed (0 = no table yet, always check)
+        quint64 tableVersion = kmiPorts->getPortTableVersion();
+
+        if (tableVersion == 0 || tableVersion != portTableVersionChecked)
+        {
+            int newPortIn = kmiPorts->getInPortNumber(portName_in);
+            int newPortOut = kmiPorts->getOutPortNumber(portName_out);
+            portTableVersionChecked = tableVersion;
+
+            if (port_in != newPortIn)
+            {
+                DM_OUT << "ERROR: input port: " << port_in << " does not match RtMidi port: " << newPortIn << " - updating...";
+                if (!slotUpdatePortIn(newPortIn))
+                {
+                    DM_OUT << "ERROR: couldn't update input port";
+                }
+            }
+
+            if (port_out != newPortOut)
+            {
+                DM_OUT << "ERROR: output port: " << port_out << " does not match RtMidi port: " << newPortOut << " - updating...";
+                if (!slotUpdatePortOut(newPortOut))
+                {
+                    DM_OUT << "ERROR: couldn't update output port";
+                }
+            }
+        }
+
+        if (firstFwVerRequestHasBeenSent == false || fwVerRequestTimer.elapsed() >= FW_VER_REQUEST_INTERVAL_MS) // only send a request once every 5 seconds
+        {
+            bool requestSent = false;
+
+            if (fwVerPollSkipConnectCycles > 0) // don't send request while bootloader installs
+            {
+                DM_OUT << "Blocking firmware version request - fwVerPollSkipConnectCycles: " << fwVerPollSkipConnectCycles;
+                fwVerPollSkipConnectCycles--;
+            }
+            else if (deviceName == "SSCOM") // old softStep firmware doesn't use the universal syx dev id request
+            {
+                DM_OUT << "Sending SSCOM firmware version request";
+                slotSendSysEx(_fw_req_softstep, sizeof(_fw_req_softstep));
+                requestSent = true;
+            }
+            else if (portName_out == TWELVESTEP1_IN_P1) // 12 step legacy also doesn't use the universal syx dev id request
+                                                        // but new firmware will respond to the old message with the standard sysex universal ID reply
+            {
+                DM_OUT << "Sending 12 Step legacy firmware version request";
+                slotSendSysEx(_fw_req_12step, sizeof(_fw_req_12step));
+                requestSent = true;
+            }
+            else // every other product
+            {
+                DM_OUT << "Sending SysEx ID version request";
+                slotSendSysEx(_sx_id_req_standard, sizeof(_sx_id_req_standard));
+                requestSent = true;
+            }
+            firstFwVerRequestHasBeenSent = true;
+            fwVerRequestTimer.restart();
+            if (requestSent == true)
+            {
+
+                emit signalFwConsoleMessage("\nRequesting firmware version from device...");
+            }
+        }
+    }
+
+    scheduleHandshake();
+}
+
+// run slotPollVersion on the next event loop pass
+void MidiDeviceManager::handshakeKick()
+{
+    versionPoller->start(0);
+}
+
+// arm versionPoller for the earliest of: the next version request, the current firmware state's
+// next resend/countdown/timeout, or the idle re-check
+void MidiDeviceManager::scheduleHandshake()
+{
+    bool portsAreSetUp = (port_in == -1 || port_out == -1 || !port_in_open || !port_out_open) ? false : true;
+    qint64 delay = HANDSHAKE_IDLE_MS;
+
+    if (pollingStatus && portsAreSetUp)
+    {
+        qint64 untilRequest = firstFwVerRequestHasBeenSent ? FW_VER_REQUEST_INTERVAL_MS - fwVerRequestTimer.elapsed() : 0;
+        delay = qMin(delay, untilRequest);
+    }
+
+    qint64 untilFw = fwNextDeadlineMs();
+    if (untilFw >= 0) delay = qMin(delay, untilFw);
+
+    versionPoller->start((int)qMax((qint64)0, delay));
+}
+
+// deadline of a firmware wait state, 0 = not a wait state (the state acts immediately)
+int MidiDeviceManager::fwStateTimeoutMs(int state)
+{
+    switch (state)
+    {
+    case FWUD_STATE_GLOBALS_REQ_SENT_WAIT:
+        return FW_GLOBALS_TIMEOUT_MS;
+    case FWUD_STATE_BL_SENT_WAIT:
+    case FWUD_STATE_FW_SENT_WAIT:
+        return FW_REBOOT_TIMEOUT_MS;
+    default:
+        return 0;
+    }
+}
+
+qint64 MidiDeviceManager::fwNextDeadlineMs()
+{
+    int timeout = fwStateTimeoutMs(firmwareUpdateState);
+    if (timeout == 0) return -1;
+
+    if (packet.size() > 0) return 1000; // transfer running, report bytes remaining once a second
+
+    qint64 elapsed = firmwareUpdateStateTimer.elapsed();
+    qint64 next = timeout - elapsed + 1; // just past the timeout
+
+    if (firmwareUpdateState == FWUD_STATE_GLOBALS_REQ_SENT_WAIT)
+    {
+        if (fwResendCount == 0) next = qMin(next, FW_GLOBALS_RESEND_MS - elapsed);
+    }
+    else
+    {
+        if (fwResendCount < FW_ID_RESENDS) next = qMin(next, fwIdResendMs[fwResendCount] - elapsed);
+
+        // countdown messages, entering the window and then on each whole second
+        if (elapsed <= timeout - FW_TIMEOUT_COUNTDOWN_MS) next = qMin(next, timeout - FW_TIMEOUT_COUNTDOWN_MS - elapsed + 1);
+        else next = qMin(next, (timeout - elapsed) % 1000 + 1);
+    }
+    return qMax((qint64)0, next);
+}
+
+// Firmware update state changes go through here. States that act straight away (everything but
+// IDLE and the *_WAIT states) are stepped on the next event loop pass instead of waiting for the
+// versionPoller tick, so a pipeline runs as fast as the device answers.
+// sxProcessFirmwareVersion can get here from the RtMidi callback, the change is then posted to
+// the owner thread so only it touches the timers and fwStepQueued.
+void MidiDeviceManager::fwSetState(int state)
+{
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, "slotFwSetState", Qt::QueuedConnection, Q_ARG(int, state));
+        return;
+    }
+
+    firmwareUpdateState = state;
+    firmwareUpdateStateTimer.restart(); // every state's deadlines count from here
+    fwResendCount = 0;
+    fwCountdownLast = -1;
+
+    bool waitState = (state == FWUD_STATE_IDLE || fwStateTimeoutMs(state) != 0);
+
+    if (!waitState && !fwStepQueued)
+    {
+        fwStepQueued = true;
+        QMetaObject::invokeMethod(this, "slotFwUpdateStep", Qt::QueuedConnection);
+    }
+}
+
+void MidiDeviceManager::slotFwSetState(int state)
+{
+    fwSetState(state);
+}
+
+void MidiDeviceManager::slotFwUpdateStep()
+{
+    fwStepQueued = false;
+    fwUpdateStep();
+    scheduleHandshake(); // a wait state may have started, arm its first deadline
+}
+
+// editors call this when the globals backup arrived, rather than writing firmwareUpdateState
+void MidiDeviceManager::slotGlobalsReceived()
+{
+    if (firmwareUpdateState == FWUD_STATE_GLOBALS_REQ_SENT_WAIT) fwSetState(FWUD_STATE_GLOBALS_RCVD);
+}
+
+// share one image between managers, only the reference count changes
+void MidiDeviceManager::slotSetFirmwareImage(KMI_FwImagePtr image)
+{
+    firmwareImage = image;
+    firmwareByteArray = image ? image->bytes() : QByteArray();
+}
+
+void MidiDeviceManager::slotSetBootloaderImage(KMI_FwImagePtr image)
+{
+    bootloaderImage = image;
+    bootloaderByteArray = image ? image->bytes() : QByteArray();
+}
+
+// the image to send, wrapped from imageArray when an editor assigned the byte array itself
+// rather than going through slotSetFirmwareImage/slotSetBootloaderImage. nullptr if it's invalid
+KMI_FwImagePtr MidiDeviceManager::fwImageFromArray(KMI_FwImagePtr image, const QByteArray &imageArray, QString *errorString)
+{
+    if (imageArray.isEmpty()) return image;
+    if (image && imageArray.constData() == (const char *)image->data() && imageArray.size() == image->size()) return image; // our own view
+
+    return KMI_FwImage::fromByteArray(imageArray, errorString);
+}
+
+void MidiDeviceManager::slotSendBootloaderImage()
+{
+    if (firmwareUpdateState != FWUD_STATE_BL_SENT_WAIT) return; // update was reset while we waited
+
+    if (!bootloaderByteArray.isEmpty())
+    {
+        QString error;
+        KMI_FwImagePtr image = fwImageFromArray(bootloaderImage, bootloaderByteArray, &error);
+        if (!image)
+        {
+            DM_OUT << "ERROR: bootloader image rejected: " << error;
+            emit signalFwConsoleMessage("\nERROR! Bootloader image is not valid sysex!\n");
+            fwSetState(FWUD_STATE_FAIL);
+            return;
+        }
+        if (image != bootloaderImage) slotSetBootloaderImage(image);
+    }
+
+    // this will:
+    // - install the trojan horse firmware image
+    // - reboot the device
+    // - trojan horse installs the bootloader
+    // - device reboots into bootloader mode
+    sendSysExImage(bootloaderImage);
+}
+
+// one pass of the firmware update state machine, returns false if the version request should be skipped
+bool MidiDeviceManager::fwUpdateStep()
+{
+    QString thisVersion;
 
     if (packet.size() > 0)
         firmwareUpdateStateTimer.restart();
 
+    qint64 elapsed = firmwareUpdateStateTimer.elapsed();
+    int stateTimeout = fwStateTimeoutMs(firmwareUpdateState);
 
-    if (    firmwareUpdateState > FWUD_STATE_BEGIN &&
-            firmwareUpdateStateTimer.elapsed() > (FW_UPDATE_TIMEOUT_INTERVAL - 10000) &&
+    // count down the last seconds before a reboot wait fails the update, once per second
+    if (    stateTimeout == FW_REBOOT_TIMEOUT_MS &&
+            elapsed > (stateTimeout - FW_TIMEOUT_COUNTDOWN_MS) &&
             installingBootloader != BL_INSTALL_COMPLETE
        )
     {
-        if (remainingSeconds > 0) emit signalFwConsoleMessage(QString("\nTimeout in %1...").arg(remainingSeconds));
+        int remainingSeconds = (int)((stateTimeout - elapsed) / 1000);
+        if (remainingSeconds > 0 && remainingSeconds != fwCountdownLast)
+        {
+            emit signalFwConsoleMessage(QString("\nTimeout in %1...").arg(remainingSeconds));
+            fwCountdownLast = remainingSeconds;
+        }
     }
 
     switch (firmwareUpdateState)
@@ -672,15 +1012,15 @@ void MidiDeviceManager::slotPollVersion()
         DM_OUT << "Begin Firmware Update Process - fwSaveRestoreGlobals: " << fwSaveRestoreGlobals;
         if (bootloaderMode)
         {
-            firmwareUpdateState = FWUD_STATE_BL_MODE;
+            fwSetState(FWUD_STATE_BL_MODE);
         }
         else if (fwSaveRestoreGlobals)
         {
-            firmwareUpdateState = FWUD_STATE_GLOBALS_REQ_SEND;
+            fwSetState(FWUD_STATE_GLOBALS_REQ_SEND);
         }
         else
         {
-            firmwareUpdateState = FWUD_STATE_BL_SEND;
+            fwSetState(FWUD_STATE_BL_SEND);
         }
         //DM_OUT << "fwVerPollSkipConnectCycles = 0";
         fwVerPollSkipConnectCycles = 0;
@@ -692,21 +1032,21 @@ void MidiDeviceManager::slotPollVersion()
         emit signalRequestGlobals();
         emit signalFwProgress(10); // increment progress bar
         emit signalFwConsoleMessage(QString("\n\nBacking up %1 global settings...").arg(deviceName));
-        firmwareUpdateState = FWUD_STATE_GLOBALS_REQ_SENT_WAIT;
-        firmwareUpdateStateTimer.restart();
+        fwSetState(FWUD_STATE_GLOBALS_REQ_SENT_WAIT);
         break;
     case FWUD_STATE_GLOBALS_REQ_SENT_WAIT:
         DM_OUT << "Globals request sent, waiting for a response..." << firmwareUpdateStateTimer.elapsed();
-        if (remainingSeconds == 25)
+        if (fwResendCount == 0 && elapsed >= FW_GLOBALS_RESEND_MS)
         {
             DM_OUT << "Sending Globals request (again)";
             emit signalRequestGlobals();
+            fwResendCount++;
         }
-        else if (remainingSeconds < 15)
+        else if (elapsed >= FW_GLOBALS_TIMEOUT_MS)
         {
             DM_OUT << "No response to globals request, skipping";
             emit signalFwConsoleMessage("\n\nNo response to globals backup request, resetting to default settings and proceeding with firmware update.\n");
-            firmwareUpdateState = FWUD_STATE_BL_SEND;
+            fwSetState(FWUD_STATE_BL_SEND);
         }
         break;
     case FWUD_STATE_GLOBALS_RCVD:
@@ -714,8 +1054,7 @@ void MidiDeviceManager::slotPollVersion()
         pollingStatus = false;
         emit signalFwConsoleMessage("\n\nGlobals Saved.\n");
         emit signalFwProgress(20); // increment progress bar
-        firmwareUpdateState = FWUD_STATE_BL_SEND;
-        firmwareUpdateStateTimer.restart();
+        fwSetState(FWUD_STATE_BL_SEND);
         break;
     case FWUD_STATE_BL_SEND:
         DM_OUT << "Sending bootloader image/command...";
@@ -742,13 +1081,9 @@ void MidiDeviceManager::slotPollVersion()
                     //DM_OUT << "fwVerPollSkipConnectCycles = 2";
                     fwVerPollSkipConnectCycles = 1; // don't send fw version request during bootloader install
 
-                    QThread::msleep(1000); // wait for console to update
-                    // this will:
-                    // - install the trojan horse firmware image
-                    // - reboot the device
-                    // - trojan horse installs the bootloader
-                    // - device reboots into bootloader mode
-                    slotSendSysExBA(bootloaderByteArray);
+                    // give the console a second to update before the image goes out, without blocking
+                    // the event loop (other devices' pipelines keep running)
+                    QTimer::singleShot(1000, this, SLOT(slotSendBootloaderImage()));
                 }
             }
             else // this is the standard method to enter bootloader mode, once a bootloader is installed
@@ -784,25 +1119,21 @@ void MidiDeviceManager::slotPollVersion()
 
         emit signalFwProgress(30); // increment progress bar
 
-        firmwareUpdateState = FWUD_STATE_BL_SENT_WAIT;
-        firmwareUpdateStateTimer.restart();
+        fwSetState(FWUD_STATE_BL_SENT_WAIT);
         break;
     case FWUD_STATE_BL_SENT_WAIT:
         DM_OUT << "Bootloader image/command sent, waiting..." << firmwareUpdateStateTimer.elapsed();
 
-        if (remainingSeconds == 20 ||remainingSeconds == 10)
-        {
-            //kmiPorts->slotRefreshPortMaps(); // kick it
-        }
-        if (remainingSeconds == 22 || remainingSeconds == 12 || remainingSeconds == 5)
+        if (fwResendCount < FW_ID_RESENDS && elapsed >= fwIdResendMs[fwResendCount])
         {
             DM_OUT << "Sending SysEx ID version request (again)";
             slotSendSysEx(_sx_id_req_standard, sizeof(_sx_id_req_standard));
+            fwResendCount++;
         }
 
-        if (firmwareUpdateStateTimer.elapsed() > FW_UPDATE_TIMEOUT_INTERVAL)
+        if (elapsed > FW_REBOOT_TIMEOUT_MS)
         {
-            firmwareUpdateState = FWUD_STATE_FAIL;
+            fwSetState(FWUD_STATE_FAIL);
         }
         break;
     case FWUD_STATE_BL_MODE:
@@ -821,7 +1152,7 @@ void MidiDeviceManager::slotPollVersion()
             installingBootloader = BL_INSTALL_COMPLETE;
             emit signalFwConsoleMessage("\nThe application will now re-launch. Wait to reconnect your device until after the application has loaded.");
             emit signalFirmwareUpdateComplete(true);
-            firmwareUpdateState = FWUD_STATE_IDLE;
+            fwSetState(FWUD_STATE_IDLE);
             //DM_OUT << "fwVerPollSkipConnectCycles = 0";
             fwVerPollSkipConnectCycles = 0;
             connected = false;
@@ -832,7 +1163,7 @@ void MidiDeviceManager::slotPollVersion()
 
         emit signalFwConsoleMessage("\nDevice bootloader detected.\n"); // confirm enter bootloader and next line
         emit signalFwProgress(40); // increment progress bar
-        firmwareUpdateState = FWUD_STATE_FW_SEND;
+        fwSetState(FWUD_STATE_FW_SEND);
         //DM_OUT << "fwVerPollSkipConnectCycles = 0";
         fwVerPollSkipConnectCycles = 0;
         break;
@@ -849,25 +1180,37 @@ void MidiDeviceManager::slotPollVersion()
                                    "closing all programs, re-starting the %1 editor,\n"
                                    "and then reconnecting your %1.\n").arg(deviceName));
 #endif
-            firmwareUpdateState = FWUD_STATE_FAIL;
+            fwSetState(FWUD_STATE_FAIL);
         }
         emit signalFwConsoleMessage("\nUpdating Firmware...\n");
         emit signalFwProgress(50); // increment progress bar
 
-        if (firmwareByteArray.length() < 1)
+        if (!firmwareByteArray.isEmpty())
+        {
+            QString error;
+            KMI_FwImagePtr image = fwImageFromArray(firmwareImage, firmwareByteArray, &error);
+            if (!image)
+            {
+                DM_OUT << "ERROR: firmware image rejected: " << error;
+                emit signalFwConsoleMessage("\nERROR! Firmware image is not valid sysex!\n");
+                fwSetState(FWUD_STATE_FAIL);
+                return false;
+            }
+            if (image != firmwareImage) slotSetFirmwareImage(image);
+        }
+
+        if (!firmwareImage)
         {
             DM_OUT << "Firmware file not defined!";
             emit signalFwConsoleMessage("\nERROR! Firmware file not found!\n");
-            firmwareUpdateState = FWUD_STATE_FAIL;
-            firmwareUpdateStateTimer.restart();
-            return; // no file, should trip an error
+            fwSetState(FWUD_STATE_FAIL);
+            return false; // no file, should trip an error
         }
 
         DM_OUT << "sending firmware sysex";
 
-        slotSendSysExBA(firmwareByteArray); // send firmware
-        firmwareUpdateState = FWUD_STATE_FW_SENT_WAIT;
-        firmwareUpdateStateTimer.restart();
+        sendSysExImage(firmwareImage); // send firmware
+        fwSetState(FWUD_STATE_FW_SENT_WAIT);
         break;
     case FWUD_STATE_FW_SENT_WAIT:
         if (packet.size() > 500)
@@ -878,30 +1221,25 @@ void MidiDeviceManager::slotPollVersion()
         }
         DM_OUT << "Firmware Image sent, waiting for device to reboot..." << firmwareUpdateStateTimer.elapsed();
 
-        if (remainingSeconds == 20 ||remainingSeconds == 10)
-        {
-            // EB TODO - are these lines necessary? Didn't need for 12 Step, does it break other devices? Windows?
-//            slotCloseMidiIn(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
-//            slotCloseMidiOut(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
-//            kmiPorts->slotRefreshPortMaps(); // kick it
-        }
-        if (remainingSeconds == 22 || remainingSeconds == 12 || remainingSeconds == 5)
+        // EB TODO - closing/refreshing the ports here at 15/25 s didn't turn out to be necessary for 12 Step,
+        // does it break other devices? Windows?
+        if (fwResendCount < FW_ID_RESENDS && elapsed >= fwIdResendMs[fwResendCount])
         {
             //DM_OUT << "Sending SysEx ID version request (again)";
             slotSendSysEx(_sx_id_req_standard, sizeof(_sx_id_req_standard));
+            fwResendCount++;
         }
 
-        if (firmwareUpdateStateTimer.elapsed() > FW_UPDATE_TIMEOUT_INTERVAL)
+        if (elapsed > FW_REBOOT_TIMEOUT_MS)
         {
-            firmwareUpdateState = FWUD_STATE_FAIL;
+            fwSetState(FWUD_STATE_FAIL);
         }
         break;
     case FWUD_STATE_GLOBALS_SEND:
         emit signalRestoreGlobals(); // editor will handle this message
         emit signalFwProgress(90); // increment progress bar
         emit signalFwConsoleMessage("\nRestoring Globals...\n");
-        firmwareUpdateState = FWUD_STATE_SUCCESS;
-        firmwareUpdateStateTimer.restart();
+        fwSetState(FWUD_STATE_SUCCESS);
         break;
     case FWUD_STATE_SUCCESS:
         DM_OUT << "Firmware Update Successful!" << firmwareUpdateStateTimer.elapsed();
@@ -917,7 +1255,7 @@ void MidiDeviceManager::slotPollVersion()
         emit signalFwConsoleMessage("\nFirmware successfully updated to " + thisVersion + "\n");
 #endif
 
-        firmwareUpdateState = FWUD_STATE_IDLE;
+        fwSetState(FWUD_STATE_IDLE);
         //DM_OUT << "fwVerPollSkipConnectCycles = 0";
         fwVerPollSkipConnectCycles = 0;
         connected = true;
@@ -927,74 +1265,13 @@ void MidiDeviceManager::slotPollVersion()
         slotFirmwareUpdateReset();
         connected = false;
         emit signalFirmwareUpdateComplete(false);
-        firmwareUpdateState = FWUD_STATE_IDLE;
+        fwSetState(FWUD_STATE_IDLE);
         fwVerPollSkipConnectCycles = 0;
         //DM_OUT << "fwVerPollSkipConnectCycles = 0";
         break;
     }
 
-    // Send fwVer/identity request?
-    if (pollingStatus && portsAreSetUp)
-    {
-        // test if our ports still match
-        int newPortIn = kmiPorts->getInPortNumber(portName_in);
-        int newPortOut = kmiPorts->getOutPortNumber(portName_out);
-
-        if (port_in != kmiPorts->getInPortNumber(portName_in))
-        {
-            DM_OUT << "ERROR: input port: " << port_in << " does not match RtMidi port: " << newPortIn << " - updating...";
-            if (!slotUpdatePortIn(newPortIn))
-            {
-                DM_OUT << "ERROR: couldn't update input port";
-            }
-        }
-
-        if (port_out != kmiPorts->getOutPortNumber(portName_out))
-        {
-            DM_OUT << "ERROR: output port: " << port_out << " does not match RtMidi port: " << newPortOut << " - updating...";
-            if (!slotUpdatePortOut(newPortOut))
-            {
-                DM_OUT << "ERROR: couldn't update output port";
-            }
-        }
-
-        if (firstFwVerRequestHasBeenSent == false || fwVerRequestTimer.elapsed() > 5000) // only send a request once every 5 seconds
-        {
-            bool requestSent = false;
-
-            if (fwVerPollSkipConnectCycles > 0) // don't send request while bootloader installs
-            {
-                DM_OUT << "Blocking firmware version request - fwVerPollSkipConnectCycles: " << fwVerPollSkipConnectCycles;
-                fwVerPollSkipConnectCycles--;
-            }
-            else if (deviceName == "SSCOM") // old softStep firmware doesn't use the universal syx dev id request
-            {
-                DM_OUT << "Sending SSCOM firmware version request";
-                slotSendSysEx(_fw_req_softstep, sizeof(_fw_req_softstep));
-                requestSent = true;
-            }
-            else if (portName_out == TWELVESTEP1_IN_P1) // 12 step legacy also doesn't use the universal syx dev id request
-                                                        // but new firmware will respond to the old message with the standard sysex universal ID reply
-            {
-                DM_OUT << "Sending 12 Step legacy firmware version request";
-                slotSendSysEx(_fw_req_12step, sizeof(_fw_req_12step));
-                requestSent = true;
-            }
-            else // every other product
-            {
-                DM_OUT << "Sending SysEx ID version request";
-                slotSendSysEx(_sx_id_req_standard, sizeof(_sx_id_req_standard));
-                requestSent = true;
-            }
-            firstFwVerRequestHasBeenSent = true;
-            fwVerRequestTimer.restart();
-            if (requestSent == true)
-            {
-
-                emit signalFwConsoleMessage("\nRequesting firmware version from device...");
-            }
-        }
-    }
+    return true;
 }
 
 //void MidiDeviceManager::slotStartGlobalsTimer()
@@ -1037,23 +1314,20 @@ void MidiDeviceManager::slotCheckGlobalsReceived()
 
 void MidiDeviceManager::slotSendSysExBA(QByteArray thisSysexArray)
 {
-    unsigned char *ucharArrayPtr;
-
-    // create a uchar pointer to the QByteArray
-    ucharArrayPtr = reinterpret_cast<unsigned char*>(thisSysexArray.data());
-
-    slotSendSysEx(ucharArrayPtr, thisSysexArray.size());
+    // the array is implicitly shared, so chunked sends can queue it without a copy
+    sendSysEx(reinterpret_cast<const unsigned char*>(thisSysexArray.constData()), thisSysexArray.size(), &thisSysexArray);
 }
 
 // takes a pointer and the size of the array
 void MidiDeviceManager::slotSendSysEx(unsigned char *sysEx, int len)
 {
-    //DM_OUT << "Send sysex, length: " << len << " syx: " << sysEx << " PID: " << PID;
-    std::vector<unsigned char> message(sysEx, sysEx+len);
-
-
+    sendSysEx(sysEx, len, nullptr);
+}
 
-    ioGate = false; // pause any midi output while sending SysEx
+// sharedData is optional, if set it holds the same bytes as sysEx and can be queued as is
+void MidiDeviceManager::sendSysEx(const unsigned char *sysEx, int len, const QByteArray *sharedData)
+{
+    //DM_OUT << "Send sysex, length: " << len << " syx: " << sysEx << " PID: " << PID;
 
     if (port_out_open == false)
     {
@@ -1061,24 +1335,31 @@ void MidiDeviceManager::slotSendSysEx(unsigned char *sysEx, int len)
         return; // handler doesn't exist
     }
 
+    if (len < 1) return;
+    KMI_Metrics::add(metrics.txMessages);
+
     // test if sysex start/stop are missing, and if so then add them
-    if (message[0] != MIDI_SX_START)
-    {
-        message.insert(message.begin(), MIDI_SX_START);
-        len++;
-    }
-    if (message[len - 1] != MIDI_SX_STOP) // len is not zero indexed
-    {
-        message.push_back(MIDI_SX_STOP);
-        len++;
-    }
+    bool addStart = (sysEx[0] != MIDI_SX_START);
+    bool addStop = (sysEx[len - 1] != MIDI_SX_STOP);
 
     if (sysExTxChunkSize == 0)
     {
         // standard method, send the payload all at once
         try
         {
-            midi_out->sendMessage( &message );
+            if (!addStart && !addStop)
+            {
+                txSend(sysEx, len);
+            }
+            else
+            {
+                // framing is missing, build it in a reused buffer
+                sysExTxFramed.clear();
+                if (addStart) sysExTxFramed.push_back(MIDI_SX_START);
+                sysExTxFramed.insert(sysExTxFramed.end(), sysEx, sysEx + len);
+                if (addStop) sysExTxFramed.push_back(MIDI_SX_STOP);
+                txSend(sysExTxFramed.data(), sysExTxFramed.size());
+            }
         }
         catch (RtMidiError &error)
         {
@@ -1092,198 +1373,302 @@ void MidiDeviceManager::slotSendSysEx(unsigned char *sysEx, int len)
     {
         //QString currentTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz");
         //DM_OUT << "Sending SysEx - current time: " << currentTime << " Packet Size: " << sysExTxChunkSize;
-        packet.insert(packet.end(), message.begin(), message.end()); // append the sysex message to the end of our packet
 
+        // append the sysex message to the end of our packet
+        if (sharedData != nullptr && !addStart && !addStop)
+        {
+            packet.append(*sharedData); // no copy
+        }
+        else
+        {
+            if (addStart) packet.push_back(MIDI_SX_START);
+            packet.append(sysEx, len);
+            if (addStop) packet.push_back(MIDI_SX_STOP);
+        }
     }
 
     if (packet.size() < sysExTxChunkSize)
         slotEmptyMIDIBuffer();
 
-    ioGate = true; // reopen gate
+    scheduleTx();
+}
+
+// Send a validated firmware/bootloader image. The framing was checked when it was loaded, so the
+// bytes go out straight from the mapping: in one call, or queued by reference for chunked sends.
+// The queue holds a reference to the image until the last chunk is out.
+void MidiDeviceManager::sendSysExImage(KMI_FwImagePtr image)
+{
+    if (!image)
+    {
+        DM_OUT << "ERROR: no image to send";
+        return;
+    }
+
+    if (sysExTxChunkSize == 0)
+    {
+        sendSysEx(image->data(), image->size(), nullptr);
+        return;
+    }
+
+    if (port_out_open == false)
+    {
+        DM_OUT << "ERROR: midi_out is not open, aborting sendSysExImage!";
+        return;
+    }
+
+    packet.append(image->data(), image->size(), image);
+    KMI_Metrics::add(metrics.txMessages, image->messageCount());
+    scheduleTx();
+}
+
+// *************************************************
+// Sysex signatures
+// - every message we act on is recognised by a fixed prefix at a fixed offset
+// - the table is classified in one pass without allocating, first match wins
+// *************************************************
+enum
+{
+    SX_CLASS_OTHER,             // not ours, passed to the application
+    SX_CLASS_LOOP_TEST,         // our own feedback loop test came back
+    SX_CLASS_FW_REPLY_SOFTSTEP, // SoftStep pre-bootloader firmware reply
+    SX_CLASS_FW_REPLY_12STEP,   // 12 Step firmware reply
+    SX_CLASS_ID_REPLY           // universal device id reply, all other devices
+};
+
+typedef struct
+{
+    const unsigned char *signature;
+    size_t length;
+    size_t offset;
+    int sysExClass;
+} SX_SIGNATURE;
 
+static const SX_SIGNATURE sysExSignatures[] =
+{
+    { _sx_ack_loop_test,     sizeof(_sx_ack_loop_test),     0, SX_CLASS_LOOP_TEST },
+    { _fw_reply_softstep,    sizeof(_fw_reply_softstep),    2, SX_CLASS_FW_REPLY_SOFTSTEP },
+    { _fw_reply_12step,      sizeof(_fw_reply_12step),      1, SX_CLASS_FW_REPLY_12STEP },
+    { _sx_id_reply_standard, sizeof(_sx_id_reply_standard), 0, SX_CLASS_ID_REPLY },
+};
+
+static int classifySysEx(const unsigned char *sysEx, size_t len)
+{
+    for (size_t i = 0; i < sizeof(sysExSignatures) / sizeof(sysExSignatures[0]); i++)
+    {
+        const SX_SIGNATURE &sig = sysExSignatures[i];
+        if (len >= sig.offset + sig.length && memcmp(sysEx + sig.offset, sig.signature, sig.length) == 0)
+        {
+            return sig.sysExClass;
+        }
+    }
+    return SX_CLASS_OTHER;
 }
 
 // *************************************************
 // slotProcessSysEx - parse incomming sysex
+// - classify by signature and dispatch to the handler for that class
 // - detect firmware/id responses and update firmwareUpdateState
 // - pass along all other sysex messages
+// - the array may be a view (QByteArray::fromRawData) of the RtMidi or pool buffer, it is only
+//   copied for signalRxSysExBA receivers
 // *************************************************
 void MidiDeviceManager::slotProcessSysEx(QByteArray sysExMessageByteArray, std::vector< unsigned char > *sysExMessageCharArray)
 {
-    DM_OUT << "slotProcessSysEx called - PID: " << PID << " deviceName: " << deviceName << " length: " << sysExMessageByteArray.length();
-
-    // ********************************************
-    // Test for feedback loop
-    // ********************************************
+    DM_VERBOSE << "slotProcessSysEx called - PID: " << PID << " deviceName: " << deviceName << " length: " << sysExMessageByteArray.length();
 
-    QByteArray feedbackLoopTest(reinterpret_cast<char*>(_sx_ack_loop_test), sizeof(_sx_ack_loop_test));
-    int feedbackTestIndex = sysExMessageByteArray.indexOf(feedbackLoopTest, 0);
+    const uchar *sysEx = reinterpret_cast<const uchar*>(sysExMessageByteArray.constData());
+    int sysExClass = classifySysEx(sysEx, sysExMessageByteArray.size());
 
-    if (feedbackTestIndex == 0) // feedback loop detected!
+    switch (sysExClass)
     {
-        DM_OUT << "*** FEEDBACK LOOP DETECTED, MIDI PORTS CLOSED *** - " << sysExMessageByteArray;
-        this->disconnect(SIGNAL(signalRxMidi_raw(uchar, uchar, uchar, uchar)));
-        slotCloseMidiIn(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
-        slotCloseMidiOut(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
-        kmiPorts->slotRefreshPortMaps(); // kick it
-        emit signalFeedbackLoopDetected(this);
-        slotErrorPopup("MIDI FEEDBACK LOOP DETECTED\nPorts Closed");
-    }
+    case SX_CLASS_FW_REPLY_SOFTSTEP:
+        sxHandleFwReplySoftStep(sysExMessageByteArray);
+        break;
+    case SX_CLASS_FW_REPLY_12STEP:
+        sxHandleFwReply12Step(sysExMessageByteArray);
+        break;
+    case SX_CLASS_ID_REPLY:
+        if (deviceName == "QuNeo")
+            sxHandleIdReplyQuNeo(sysExMessageByteArray, sysExMessageCharArray);
+        else
+            sxHandleIdReply(sysExMessageByteArray, sysExMessageCharArray);
+        break;
+    case SX_CLASS_LOOP_TEST:
+        sxHandleFeedbackLoop(sysExMessageByteArray);
+        // fall through, the loop test is still passed along
+    default:
+        if (sysExClass == SX_CLASS_OTHER) sxHandleTxAck(sysEx, sysExMessageByteArray.size());
+
+#ifdef MDM_DEBUG_ENABLED
+        DM_OUT << "sysExClass: " << sysExClass;
+        DM_OUT << "Unrecognized Syx: " << QString::fromStdString(sysExMessageByteArray.toStdString());;
+#endif
 
-    // ********************************************
-    // Define firmware version metadata
-    // ********************************************
+        DM_VERBOSE << "passing SysEx to applicaiton";
+        // send SysEx to application
+        if (isSignalConnected(QMetaMethod::fromSignal(&MidiDeviceManager::signalRxSysExBA)))
+        {
+            // receivers may queue it, so it can't point into a buffer that is about to be reused
+            emit signalRxSysExBA(QByteArray(sysExMessageByteArray.constData(), sysExMessageByteArray.size()));
+        }
+        emit signalRxSysEx(sysExMessageCharArray);
+        emit signalRxSysExData(sysEx, (size_t)sysExMessageByteArray.size());
+        if (rxEventTimestampNs) metrics.rxLatency.record(kmiHostTimeNs() - rxEventTimestampNs);
 
-    // Query for "pre-bootloader" SoftStep replies
-    QByteArray fwQueryReplySS(reinterpret_cast<char*>(_fw_reply_softstep), sizeof(_fw_reply_softstep));
-    int replyIndexSS = sysExMessageByteArray.indexOf(fwQueryReplySS, 0);
+        // leave function
+        return;
+    }
 
-    // Query for 12 Step
-    QByteArray fwQueryReply12S(reinterpret_cast<char*>(_fw_reply_12step), sizeof(_fw_reply_12step));
-    int replyIndex12S = sysExMessageByteArray.indexOf(fwQueryReply12S, 0);
+    sxProcessFirmwareVersion();
+}
 
-    // Query for all other devices (test 12Step)
-    QByteArray fwQueryReply(reinterpret_cast<char*>(_sx_id_reply_standard), sizeof(_sx_id_reply_standard));
-    int replyIndex = sysExMessageByteArray.indexOf(fwQueryReply, 0);
+// ********************************************
+// Feedback loop - our own loop test came back
+// ********************************************
+void MidiDeviceManager::sxHandleFeedbackLoop(const QByteArray &sysExMessageByteArray)
+{
+    DM_OUT << "*** FEEDBACK LOOP DETECTED, MIDI PORTS CLOSED *** - " << sysExMessageByteArray;
+    this->disconnect(SIGNAL(signalRxMidi_raw(uchar, uchar, uchar, uchar)));
+    slotCloseMidiIn(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
+    slotCloseMidiOut(SIGNAL_SEND); // better than letting the app crash? Only if we alert the end user, otherwise this becomes a support
+    kmiPorts->slotRefreshPortMaps(); // kick it
+    emit signalFeedbackLoopDetected(this);
+    slotErrorPopup("MIDI FEEDBACK LOOP DETECTED\nPorts Closed");
+}
 
-    // ********************************************
-    // PROCESS DEVICE SPECIFIC VERSION MESSAGES
-    // ********************************************
+// ********************************************
+// Universal ack/nak - tx flow control credits
+// F0 7E <device> 7F/7E <packet> F7, the loop test uses the same format but is classified first
+// ********************************************
+void MidiDeviceManager::sxHandleTxAck(const uchar *sysEx, int len)
+{
+    if (!sysExTxAckCredits.load(std::memory_order_relaxed) || len != 6 || sysEx[1] != SX_UNIVERSAL) return;
 
-    // ***** Soft Step Pre-Bootloader **************************************
-    if (replyIndexSS == 2)
+    if (sysEx[3] == SX_UNIV_ACK && sysExTxCredits < TX_ACK_WINDOW)
+    {
+        sysExTxCredits++;
+        QMetaObject::invokeMethod(this, "slotServiceTx", Qt::QueuedConnection); // we may be on the RtMidi thread
+    }
+    else if (sysEx[3] == SX_UNIV_NAK)
     {
-        pollingStatus = false; // turn off version polling
+        DM_OUT << "Tx nak received, packet: " << sysEx[4];
+        QMetaObject::invokeMethod(this, "slotTxNak", Qt::QueuedConnection);
+    }
+}
 
-        // this is the old softstep reply
-        deviceName = "SSCOM";
-        DM_OUT << "SoftStep old fw (no bootloader) reply:" <<  sysExMessageByteArray;
+// ***** Soft Step Pre-Bootloader **************************************
+void MidiDeviceManager::sxHandleFwReplySoftStep(const QByteArray &sysExMessageByteArray)
+{
+    pollingStatus = false; // turn off version polling
 
+    // this is the old softstep reply
+    deviceName = "SSCOM";
+    DM_OUT << "SoftStep old fw (no bootloader) reply:" <<  sysExMessageByteArray;
 
-        int fwVerWhole = (uchar)sysExMessageByteArray.at(68);
+    int fwVerWhole = (uchar)sysExMessageByteArray.at(68);
 
-        // no bootloader
-        deviceFirmwareVersion[2] = fwVerWhole % 10; // last digit
-        deviceFirmwareVersion[1] = (fwVerWhole - (uchar)deviceFirmwareVersion[2]) / 10; // second digit
-        deviceFirmwareVersion[0] = 0;
+    // no bootloader
+    deviceFirmwareVersion[2] = fwVerWhole % 10; // last digit
+    deviceFirmwareVersion[1] = (fwVerWhole - (uchar)deviceFirmwareVersion[2]) / 10; // second digit
+    deviceFirmwareVersion[0] = 0;
 
-        devicebootloaderVersion[2] = 0;
-        devicebootloaderVersion[1] = 0;
-        devicebootloaderVersion[0] = 0;
+    devicebootloaderVersion[2] = 0;
+    devicebootloaderVersion[1] = 0;
+    devicebootloaderVersion[0] = 0;
 
-        DM_OUT << QString("SoftStep fw ver: %1.%2.%3").arg((uchar)deviceFirmwareVersion[0]).arg((uchar)deviceFirmwareVersion[1]).arg((uchar)deviceFirmwareVersion[2]);
-        DM_OUT << QString("SoftStep bl ver: %1.%2.%3").arg((uchar)devicebootloaderVersion[0]).arg((uchar)devicebootloaderVersion[1]).arg((uchar)devicebootloaderVersion[2]);
-    }
+    DM_OUT << QString("SoftStep fw ver: %1.%2.%3").arg((uchar)deviceFirmwareVersion[0]).arg((uchar)deviceFirmwareVersion[1]).arg((uchar)deviceFirmwareVersion[2]);
+    DM_OUT << QString("SoftStep bl ver: %1.%2.%3").arg((uchar)devicebootloaderVersion[0]).arg((uchar)devicebootloaderVersion[1]).arg((uchar)devicebootloaderVersion[2]);
+}
 
-    // ***** 12 Step ****************************************
-    else if (replyIndex12S == 1)
-    {
-        pollingStatus = false; // turn off polling
+// ***** 12 Step ****************************************
+void MidiDeviceManager::sxHandleFwReply12Step(const QByteArray &sysExMessageByteArray)
+{
+    pollingStatus = false; // turn off polling
 
-        // EB TODO: this is a temporary cluge to make the editor work with old, non-bootloader firmware. Remove when fw1.0.0 is out
-        bootloaderMode = false;
+    // EB TODO: this is a temporary cluge to make the editor work with old, non-bootloader firmware. Remove when fw1.0.0 is out
+    bootloaderMode = false;
 
-        int fwVerWhole = (uchar)sysExMessageByteArray.at(68);
+    int fwVerWhole = (uchar)sysExMessageByteArray.at(68);
 
-        // no bootloader
-        deviceFirmwareVersion[2] = fwVerWhole % 10; // last digit
-        deviceFirmwareVersion[1] = (fwVerWhole - (uchar)deviceFirmwareVersion[2]) / 10; // second digit
-        deviceFirmwareVersion[0] = 0;
+    // no bootloader
+    deviceFirmwareVersion[2] = fwVerWhole % 10; // last digit
+    deviceFirmwareVersion[1] = (fwVerWhole - (uchar)deviceFirmwareVersion[2]) / 10; // second digit
+    deviceFirmwareVersion[0] = 0;
 
-        devicebootloaderVersion[2] = 0;
-        devicebootloaderVersion[1] = 0;
-        devicebootloaderVersion[0] = 0;
+    devicebootloaderVersion[2] = 0;
+    devicebootloaderVersion[1] = 0;
+    devicebootloaderVersion[0] = 0;
 
-        DM_OUT << QString("12Step fw ver: %1.%2.%3").arg((uchar)deviceFirmwareVersion[0]).arg((uchar)deviceFirmwareVersion[1]).arg((uchar)deviceFirmwareVersion[2]);
-    }
+    DM_OUT << QString("12Step fw ver: %1.%2.%3").arg((uchar)deviceFirmwareVersion[0]).arg((uchar)deviceFirmwareVersion[1]).arg((uchar)deviceFirmwareVersion[2]);
+}
 
-    // ***** QuNeo ****************************************
-    else if (replyIndex == 0 && deviceName == "QuNeo")
+// ***** QuNeo ****************************************
+void MidiDeviceManager::sxHandleIdReplyQuNeo(const QByteArray &sysExMessageByteArray, std::vector< unsigned char > *sysExMessageCharArray)
+{
+    pollingStatus = false; // turn off polling
+
+    if ((unsigned char)sysExMessageByteArray.at(9) == 1)
+    {
+        bootloaderMode = true;
+    }
+    else
     {
-        pollingStatus = false; // turn off polling
+        bootloaderMode = false;
+    }
 
-        if ((unsigned char)sysExMessageByteArray.at(9) == 1)
-        {
-            bootloaderMode = true;
-        }
-        else
-        {
-            bootloaderMode = false;
-        }
+    // reset
+    devicebootloaderVersion.clear();
+    deviceFirmwareVersion.clear();
 
-        // reset
-        devicebootloaderVersion.clear();
-        deviceFirmwareVersion.clear();
+    // get bl ver
+    devicebootloaderVersion.append ( ((uchar)sysExMessageCharArray->at(13)) ); // MSB
+    devicebootloaderVersion.append ( ((uchar)sysExMessageCharArray->at(12)) ); // LSB
 
-        // get bl ver
-        devicebootloaderVersion.append ( ((uchar)sysExMessageCharArray->at(13)) ); // MSB
-        devicebootloaderVersion.append ( ((uchar)sysExMessageCharArray->at(12)) ); // LSB
+    // get fw ver
+    deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(15) & 0xF0) >> 4 ); // left 4 bits
+    deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(15) & 0x0F) );      // right 4 bits
+    deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(14)) ); // LSB
 
-        // get fw ver
-        deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(15) & 0xF0) >> 4 ); // left 4 bits
-        deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(15) & 0x0F) );      // right 4 bits
-        deviceFirmwareVersion.append( ((uchar)sysExMessageCharArray->at(14)) ); // LSB
+    DM_OUT << "QuNeo fw reply- BL: " << devicebootloaderVersion << " FW: " << deviceFirmwareVersion << " fullMsg: " << sysExMessageByteArray;
+}
 
-        DM_OUT << "QuNeo fw reply- BL: " << devicebootloaderVersion << " FW: " << deviceFirmwareVersion << " fullMsg: " << sysExMessageByteArray;
-    }
-    // ***** All others *************************************
-    else if (replyIndex == 0)
-    {
-        pollingStatus = false; // turn off polling
+// ***** All others *************************************
+void MidiDeviceManager::sxHandleIdReply(const QByteArray &sysExMessageByteArray, std::vector< unsigned char > *sysExMessageCharArray)
+{
+    pollingStatus = false; // turn off polling
 
-        devicebootloaderVersion[0] = sysExMessageByteArray[12];
-        devicebootloaderVersion[1] = sysExMessageByteArray[13];
-        devicebootloaderVersion[2] = sysExMessageByteArray[14];
+    devicebootloaderVersion[0] = sysExMessageByteArray[12];
+    devicebootloaderVersion[1] = sysExMessageByteArray[13];
+    devicebootloaderVersion[2] = sysExMessageByteArray[14];
 
-        deviceFirmwareVersion[0] = sysExMessageByteArray[15];
-        deviceFirmwareVersion[1] = sysExMessageByteArray[16];
-        deviceFirmwareVersion[2] = sysExMessageByteArray[17];
+    deviceFirmwareVersion[0] = sysExMessageByteArray[15];
+    deviceFirmwareVersion[1] = sysExMessageByteArray[16];
+    deviceFirmwareVersion[2] = sysExMessageByteArray[17];
 
-        PID_MIDI = (uchar)sysExMessageCharArray->at(8); // store the MIDI PID - added for SoftStep to differentiate version 1 vs 2
+    PID_MIDI = (uchar)sysExMessageCharArray->at(8); // store the MIDI PID - added for SoftStep to differentiate version 1 vs 2
 
-        if ((unsigned char)sysExMessageByteArray.at(9) == 1)
-        {
-            bootloaderMode = true;
-            if (!deviceName.contains("Bootloader"))
-            {
-                deviceName = deviceName.append(" Bootloader");
-            }
-        }
-        else
+    if ((unsigned char)sysExMessageByteArray.at(9) == 1)
+    {
+        bootloaderMode = true;
+        if (!deviceName.contains("Bootloader"))
         {
-            bootloaderMode = false;
-            slotUpdatePID(PID_MIDI);
+            deviceName = deviceName.append(" Bootloader");
         }
-
-        DM_OUT << "ID Reply - PID_MIDI: " << PID_MIDI << " BL: " << devicebootloaderVersion << " FW: " << deviceFirmwareVersion << " bootloaderMode: " << bootloaderMode;
     }
-    // ********************************************
-    // process non fw/id SysEx Messages
-    // ********************************************
     else
     {
-#ifdef MDM_DEBUG_ENABLED
-        DM_OUT << "replyIndex: " << replyIndex;
-        DM_OUT << "replyIndex12S: " << replyIndex12S;
-        DM_OUT << "fwQueryReply12S: " << fwQueryReply12S;
-        DM_OUT << "replyIndexSS: " << replyIndexSS;
-        DM_OUT << "reply header: " << fwQueryReply;
-        DM_OUT << "Unrecognized Syx: " << QString::fromStdString(sysExMessageByteArray.toStdString());;
-#endif
-
-        DM_OUT << "passing SysEx to applicaiton";
-        // send SysEx to application
-        emit signalRxSysExBA(sysExMessageByteArray);
-        emit signalRxSysEx(sysExMessageCharArray);
-
-        // leave function
-        return;
+        bootloaderMode = false;
+        slotUpdatePID(PID_MIDI);
     }
 
-    // ********************************************
-    // process firmware version connection messages
-    // ********************************************
+    DM_OUT << "ID Reply - PID_MIDI: " << PID_MIDI << " BL: " << devicebootloaderVersion << " FW: " << deviceFirmwareVersion << " bootloaderMode: " << bootloaderMode;
+}
 
+// ********************************************
+// process firmware version connection messages
+// ********************************************
+void MidiDeviceManager::sxProcessFirmwareVersion()
+{
     // update this check from session settings
     ignoreFwVersionCheck = sessionSettings->value("IGNORE_FW_CHECKS", false).toBool();
 
@@ -1295,7 +1680,7 @@ void MidiDeviceManager::slotProcessSysEx(QByteArray sysExMessageByteArray, std::
         // update firmwareUpdateState if it isn't idle
         if (firmwareUpdateState)
         {
-            firmwareUpdateState = FWUD_STATE_BL_MODE;
+            fwSetState(FWUD_STATE_BL_MODE);
         }
         else
         {
@@ -1315,11 +1700,11 @@ void MidiDeviceManager::slotProcessSysEx(QByteArray sysExMessageByteArray, std::
             {
                 if (fwSaveRestoreGlobals == true)
                 {
-                    firmwareUpdateState = FWUD_STATE_GLOBALS_SEND;
+                    fwSetState(FWUD_STATE_GLOBALS_SEND);
                 }
                 else
                 {
-                    firmwareUpdateState = FWUD_STATE_SUCCESS;
+                    fwSetState(FWUD_STATE_SUCCESS);
                 }
             }
         }
@@ -1335,7 +1720,6 @@ void MidiDeviceManager::slotProcessSysEx(QByteArray sysExMessageByteArray, std::
         DM_OUT << "emit fw mismatch - fwv: " << deviceFirmwareVersion.toUInt() << "cfwv: " << applicationFirmwareVersion.toUInt();
         emit signalFirmwareDetected(this, false);
     }
-
 }
 
 
@@ -1343,33 +1727,32 @@ void MidiDeviceManager::slotProcessSysEx(QByteArray sysExMessageByteArray, std::
 bool MidiDeviceManager::slotOpenFirmwareFile(QString filePath)
 {
     DM_OUT << "slotOpenFirmwareFile called, file: " << filePath;
-    //Load Firmware File into a byte array
-    firmware = new QFile(filePath);
-    if (firmware->open(QIODevice::ReadOnly))
-    {
-        firmwareByteArray = firmware->readAll();
-        return true;
-    }
-    else
+
+    // map the file and check the sysex framing once, the TX path then sends straight from the mapping
+    QString error;
+    KMI_FwImagePtr image = KMI_FwImage::open(filePath, &error);
+    if (!image)
     {
+        DM_OUT << "ERROR: firmware file rejected: " << error;
         return false;
     }
+    slotSetFirmwareImage(image);
+    return true;
 }
 
 bool MidiDeviceManager::slotOpenBootloaderFile(QString filePath)
 {
     DM_OUT << "slotOpenBootloaderFile called, file: " << filePath;
-    //Load Firmware File into a byte array
-    bootloader = new QFile(filePath);
-    if (bootloader->open(QIODevice::ReadOnly))
-    {
-        bootloaderByteArray = bootloader->readAll();
-        return true;
-    }
-    else
+
+    QString error;
+    KMI_FwImagePtr image = KMI_FwImage::open(filePath, &error);
+    if (!image)
     {
+        DM_OUT << "ERROR: bootloader file rejected: " << error;
         return false;
     }
+    slotSetBootloaderImage(image);
+    return true;
 }
 
 // set up the firmware update process - enter bootloader, wait, send ud
@@ -1377,7 +1760,7 @@ void MidiDeviceManager::slotRequestFirmwareUpdate()
 {
 //    DM_OUT << "slotRequestFirmwareUpdate - fwUpdteRequested: " << fwUpdateRequested << " bootloaderMode: " << bootloaderMode << " globalsRequested: " << globalsRequested;
 
-    firmwareUpdateState = FWUD_STATE_BEGIN;
+    fwSetState(FWUD_STATE_BEGIN);
 }
 
 void MidiDeviceManager::slotFirmwareUpdateReset()
@@ -1418,12 +1801,6 @@ void MidiDeviceManager::slotSendMIDI(uchar status, uchar d1 = 255, uchar d2 = 25
     DM_OUT << QString("slotSendMIDI called - status: %1 d1: %2 d2: %3 channel: %4 newStatus: %5").arg(status).arg(d1).arg(d2).arg(chan).arg(newStatus);
 #endif
 
-    if (ioGate == false)
-    {
-        DM_OUT << "ioGate stopped an incomming MIDI message - status:" << status;
-        return; // do not send MIDI while sysex is transmitting
-    }
-
     switch (status)
     {
     // **********************************
@@ -1438,13 +1815,25 @@ void MidiDeviceManager::slotSendMIDI(uchar status, uchar d1 = 255, uchar d2 = 25
     case MIDI_PITCH_BEND:
         if ((chan != 255 && chan > 127) || d1 > 127 || d2 > 127) return; // catch bad data
         //DM_OUT << QString("packet: status: %1 d1: %2 d2: %3").arg(newStatus).arg(d1).arg(d2);
-        packet.insert(packet.end(), {newStatus, d1, d2});
+        if (status == MIDI_CONTROL_CHANGE && d1 >= MIDI_CC_NRPN_LSB && d1 <= MIDI_CC_RPN_MSB)
+        {
+            // address sent by hand, slotSendMIDI_NRPN can't assume the receiver's parameter any more
+            LAST_SENT_RPN[newStatus & 0x0F] = PARAM_NONE;
+            LAST_SENT_NRPN[newStatus & 0x0F] = PARAM_NONE;
+        }
+        {
+            const uchar message[3] = {newStatus, d1, d2};
+            txQueueShort(TX_LANE_CHANNEL, message, 3);
+        }
         break;
     // two byte packets
     case MIDI_PROG_CHANGE:
     case MIDI_CHANNEL_PRESSURE:
         if ((chan != 255 && chan > 127) || d1 > 127) return; // catch bad data
-        packet.insert(packet.end(), {newStatus, d1});
+        {
+            const uchar message[2] = {newStatus, d1};
+            txQueueShort(TX_LANE_CHANNEL, message, 2);
+        }
         break;
     default:
 
@@ -1460,22 +1849,31 @@ void MidiDeviceManager::slotSendMIDI(uchar status, uchar d1 = 255, uchar d2 = 25
         case MIDI_MTC:
         case MIDI_SONG_POSITION:
             if (d1 > 127 || d2 > 127) return; // catch bad data
-            packet.insert(packet.end(), {newStatus, d1, d2});
+            {
+                const uchar message[3] = {newStatus, d1, d2};
+                txQueueShort(TX_LANE_CHANNEL, message, 3);
+            }
             break;
         // two byte packets
         case MIDI_SONG_SELECT:
             if (d1 > 127) return; // catch bad data
-            packet.insert(packet.end(), {newStatus, d1});
+            {
+                const uchar message[2] = {newStatus, d1};
+                txQueueShort(TX_LANE_CHANNEL, message, 2);
+            }
             break;
         // single byte packets
         case MIDI_TUNE_REQUEST:
+            txQueueShort(TX_LANE_CHANNEL, &newStatus, 1);
+            break;
+        // realtime, goes out ahead of everything else
         case MIDI_RT_CLOCK:
         case MIDI_RT_START:
         case MIDI_RT_CONTINUE:
         case MIDI_RT_STOP:
         case MIDI_RT_ACTIVE_SENSE:
         case MIDI_RT_RESET:
-            packet.push_back(newStatus);
+            txQueueShort(TX_LANE_REALTIME, &newStatus, 1);
             break;
         // catch undefined and bad messages
         default:
@@ -1494,18 +1892,21 @@ void MidiDeviceManager::slotSendMIDI(uchar status, uchar d1 = 255, uchar d2 = 25
         return; // handler doesn't exist
     }
 
-    if (packet.size() > MAX_MIDI_PACKET_SIZE)
+    if (txLaneBytes > MAX_MIDI_PACKET_SIZE)
     {
         slotEmptyMIDIBuffer();
     }
+
+    scheduleTx(); // flush on the next event loop pass, messages sent before then go out together
 }
 
 void MidiDeviceManager::slotEmptyMIDIBuffer()
 {
-    std::vector<uchar> message;
-    static bool sendLastChunk = false;
     //static int syxPacketsSent = 0;
 
+    if (packet.empty()) txSysExOpen = false;
+    if (!txServiceLanes()) return; // send failed, ports are closed
+
     if (packet.size() == 0)
     {
         return;
@@ -1515,89 +1916,176 @@ void MidiDeviceManager::slotEmptyMIDIBuffer()
     {
         DM_OUT << "ERROR: SYSEX TX BUFFER OVERFLOW, DISCARDING";
         packet.clear();
+        sysExTxSendLastChunk = false;
         return;
     }
 
     // send sysex in chunks
-    if (packet.size() > sysExTxChunkSize || sendLastChunk == true)
+    if (packet.size() > sysExTxChunkSize || sysExTxSendLastChunk == true)
     {
-        if (syxExTxChunkTimer.elapsed() < sysExTxChunkDelay)
+        qint64 now = syxExTxChunkTimer.nsecsElapsed();
+        if (now < sysExTxNextChunkNs)
+        {
+            return; // enforce speed limit, scheduleTx arms midiSendTimer for the deadline
+        }
+
+        if (txThread && txThread->pending() > 0)
+        {
+            return; // the previous chunk is still going out, signalIdle resumes us
+        }
+
+        if (sysExTxBurstStartNs < 0)
         {
-            return; // enforce speed limit
+            sysExTxAckFallback = false; // new transfer, try the acks again with a full window
+            sysExTxCredits = TX_ACK_WINDOW;
+        }
+
+        if (sysExTxAckCredits && !sysExTxAckFallback)
+        {
+
+            if (sysExTxCredits <= 0)
+            {
+                if (sysExTxCreditWaitNs < 0) sysExTxCreditWaitNs = now;
+                if (now - sysExTxCreditWaitNs < TX_ACK_TIMEOUT_NS)
+                {
+                    return; // wait for the device to ack
+                }
+                DM_OUT << "No tx ack from device, falling back to paced chunks for this transfer";
+                sysExTxAckFallback = true;
+            }
+            sysExTxCreditWaitNs = -1;
         }
-        syxExTxChunkTimer.restart();
 
-        unsigned int sizeToSend = sendLastChunk ? (unsigned int)packet.size() : sysExTxChunkSize;
+        size_t sizeToSend = sysExTxSendLastChunk ? packet.size() : sysExTxChunkSize;
 
         //QString currentTime = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz");
 
         //DM_OUT << "Sending SysEx - current time: " << currentTime << " - " << sizeToSend << "/" << packet.size() << " bytes, current";
-        // Create a sub-vector for the chunk to send
-        std::vector<uint8_t> chunkToSend(packet.begin(), packet.begin() + sizeToSend);
+        // view the chunk in place, this can come back short at a segment boundary
+        const uchar *chunkToSend;
+        size_t chunkSize = packet.peek(&chunkToSend, sizeToSend);
 
-        // Check if the vector size is less than 6
-        if (chunkToSend.size() < 6)
+        // channel messages are waiting for a sysex boundary, end this chunk at the next one
+        if (!txLane[TX_LANE_CHANNEL].empty())
         {
-            // Check if the last byte is 247
-            if (!chunkToSend.empty() && chunkToSend.back() == MIDI_SX_STOP)
-            {
-                // Insert 10 zeros before the last byte
-                chunkToSend.insert(chunkToSend.end() - 1, 10, 0);
-            }
+            const uchar *stop = (const uchar *)memchr(chunkToSend, MIDI_SX_STOP, chunkSize);
+            if (stop != nullptr && size_t(stop - chunkToSend) + 1 >= 6) chunkSize = stop - chunkToSend + 1;
+        }
+        size_t consumeSize = chunkSize;
+
+        // Check if the chunk size is less than 6
+        uchar paddedChunk[16];
+        if (chunkSize < 6 && chunkToSend[chunkSize - 1] == MIDI_SX_STOP)
+        {
+            // Insert 10 zeros before the last byte
+            memcpy(paddedChunk, chunkToSend, chunkSize - 1);
+            memset(&paddedChunk[chunkSize - 1], 0, 10);
+            paddedChunk[chunkSize + 9] = MIDI_SX_STOP;
+            chunkToSend = paddedChunk;
+            chunkSize += 10;
         }
 
         // Send the chunk
         try
         {  
-            midi_out->sendMessage(&chunkToSend);
+            txSend(chunkToSend, chunkSize);
             //DM_OUT << "Sent packet: " << ++syxPacketsSent;
         }
         catch (RtMidiError &error)
         {
             QString errorString = QString("MIDI SEND LARGE SYSEX ERR: %1 \n Size: %2").arg(QString::fromStdString(error.getMessage()), QString::number(packet.size()));
             DM_OUT << errorString;
+            if (sysExTxAdaptive && sysExTxAdaptRetries < TX_ADAPT_MAX_RETRIES)
+            {
+                txAdaptBackOff(now); // nothing was consumed, slow down and send this chunk again
+                return;
+            }
             slotCloseMidiIn(SIGNAL_SEND);
             slotCloseMidiOut(SIGNAL_SEND);
             kmiPorts->slotRefreshPortMaps(); // kick it
             packet.clear();
+            sysExTxSendLastChunk = false;
             return;
         }
 
-        // Remove the sent chunk from the packet
-        packet.erase(packet.begin(), packet.begin() + sizeToSend);
+        // the last F0/F7 in the chunk says whether we stopped inside a message
+        for (size_t i = chunkSize; i > 0; i--)
+        {
+            if (chunkToSend[i - 1] == MIDI_SX_START) { txSysExOpen = true; break; }
+            if (chunkToSend[i - 1] == MIDI_SX_STOP) { txSysExOpen = false; break; }
+        }
+
+        // Remove the sent chunk from the packet, nothing is moved
+        packet.consume(consumeSize);
 
-        if (sendLastChunk) // if we just sent the last chunk, clear flag/buffer and exit
+        if (sysExTxAckCredits && !sysExTxAckFallback) sysExTxCredits--;
+        if (sysExTxAdaptive) txAdaptSuccess();
+
+        // schedule the next chunk from the previous deadline so timer jitter doesn't lower the
+        // average rate, re-anchor to now if we fell too far behind rather than bursting
+        if (sysExTxBurstStartNs < 0)
         {
-            sendLastChunk = false;
-            packet.clear();
-            return;
+            sysExTxBurstStartNs = now;
+            sysExTxBurstBytes = 0;
+        }
+        sysExTxBurstBytes += consumeSize;
+
+        double rate = txByteRate();
+        if (rate > 0)
+        {
+            qint64 anchor = (now - sysExTxNextChunkNs > TX_PACE_MAX_LAG_NS) ? now : sysExTxNextChunkNs;
+            sysExTxNextChunkNs = anchor + (qint64)(consumeSize * 1e9 / rate);
+        }
+        else
+        {
+            sysExTxNextChunkNs = now; // no speed limit
+        }
+
+        if (sysExTxSendLastChunk) // if we just sent the last chunk, clear flag/buffer and exit
+        {
+            if (packet.empty())
+            {
+                sysExTxSendLastChunk = false;
+            }
+            return; // the last chunk was split by a segment boundary, send the rest on the next pass
         }
 
         if (packet.size() < sysExTxChunkSize) // if we have one chunk left, loop around and send it
         {
-            sendLastChunk = true;
+            sysExTxSendLastChunk = true;
         }
         return;
     }
     else
     {
-        for (size_t i = 0; i < packet.size(); ++i)
+        // small amounts of data only, merge into one contiguous buffer
+        const uchar *bytes = packet.linearize();
+        size_t count = packet.size();
+        txBatchBuffer.clear();
+
+        for (size_t i = 0; i < count; ++i)
         {
-            if (packet[i] == MIDI_SX_START) // small sysex
+            if (bytes[i] == MIDI_SX_START) // small sysex
             {
+                if (!txFlushBatch()) // keep the order, short messages staged before it go first
+                {
+                    packet.clear();
+                    return;
+                }
+
                 std::vector<uchar> smallSysExPacket;
 
                 bool stopSearch = false;
 
                 while (!stopSearch)
                 {
-                    smallSysExPacket.push_back(packet[i++]);
+                    smallSysExPacket.push_back(bytes[i++]);
 
-                    if (packet[i] == MIDI_SX_STOP || i >= packet.size())
+                    if (i >= count || bytes[i] == MIDI_SX_STOP)
                     {
                         stopSearch = true;
                     }
-                    else if (packet[i] > 127)
+                    else if (bytes[i] > 127)
                     {
                         i--; // decrement index so the next loop looks at this byte
                         stopSearch = true;
@@ -1608,7 +2096,7 @@ void MidiDeviceManager::slotEmptyMIDIBuffer()
                 try
                 {
                     //DM_OUT << "RAW packet: " << packet;
-                    midi_out->sendMessage( &smallSysExPacket );
+                    txSend(smallSysExPacket.data(), smallSysExPacket.size());
                 }
                 catch (RtMidiError &error)
                 {
@@ -1623,56 +2111,16 @@ void MidiDeviceManager::slotEmptyMIDIBuffer()
                 }
                 continue; // continue for loop
             }
-            else // channel messages
-            {
-                // Check if the current byte is a status byte
-                if (packet[i] >= 0x80)
-                {
-                    // If there's already a message being constructed, send it
-                    if (!message.empty())
-                    {
-                        try
-                        {
-                            //DM_OUT << "RAW packet: " << packet;
-                            midi_out->sendMessage( &message );
-                        }
-                        catch (RtMidiError &error)
-                        {
-                            QString errorString = QString("MIDI SEND PACKET ERR: %1 \n Size: %2").arg(QString::fromStdString(error.getMessage()), QString::number(packet.size()));
-                            DM_OUT << errorString;
-                            slotCloseMidiIn(SIGNAL_SEND);
-                            slotCloseMidiOut(SIGNAL_SEND);
-                            kmiPorts->slotRefreshPortMaps(); // kick it
-                            //emit signalFwConsoleMessage(errorString);
-                        }
-                        //qDebug() << "Clear Packet1";
-                        message.clear(); // Clear the message vector for the next message
-                    }
-                }
-            }
 
-            // Add the current byte to the message
-            message.push_back(packet[i]);
+            // short messages are staged and sent as one batch, the table gives their length
+            size_t length = kmiMidiMessageLength(bytes[i]);
+            if (length == 0 || i + length > count) continue; // stray data byte or truncated message
 
-            // If it's the last byte but not a status byte, ensure the message is sent
-            if (i == packet.size() - 1 && !message.empty())
-            {
-                try
-                {
-                    //DM_OUT << "RAW packet: " << packet;
-                    midi_out->sendMessage( &message );
-                }
-                catch (RtMidiError &error)
-                {
-                    QString errorString = QString("MIDI SEND PACKET ERR: %1 \n Size: %2").arg(QString::fromStdString(error.getMessage()), QString::number(packet.size()));
-                    DM_OUT << errorString;
-                    //emit signalFwConsoleMessage(errorString);
-                    slotCloseMidiIn(SIGNAL_SEND);
-                    slotCloseMidiOut(SIGNAL_SEND);
-                    kmiPorts->slotRefreshPortMaps(); // kick it
-                }
-            }
+            txBatchBuffer.insert(txBatchBuffer.end(), bytes + i, bytes + i + length);
+            KMI_Metrics::add(metrics.txMessages);
+            i += length - 1;
         }
+        txFlushBatch();
     }
 
     // Clear the packet after processing all messages
@@ -1680,103 +2128,503 @@ void MidiDeviceManager::slotEmptyMIDIBuffer()
     //qDebug() << "Clear Packet2";
 }
 
-void MidiDeviceManager::slotInitNRPN()
+// *************************************************
+// Tx lanes
+// - realtime goes first and may split a chunked sysex, MIDI allows realtime bytes anywhere
+// - channel/system common messages follow, but only once the sysex stream is at a message
+//   boundary, the chunker cuts the current chunk at the next F7 while they wait
+// - nothing is dropped, a running upload only delays channel messages until the next F7
+// *************************************************
+void MidiDeviceManager::txQueueShort(int lane, const uchar *message, uchar length)
 {
-    for (int i = 0; i < NUM_MIDI_CHANNELS; i++)
+    TX_SHORT_MESSAGE shortMessage;
+    shortMessage.length = length;
+    shortMessage.queuedNs = kmiHostTimeNs();
+    memcpy(shortMessage.data, message, length);
+    txLane[lane].push_back(shortMessage);
+    txLaneBytes += length;
+}
+
+// false if a send failed and the ports were closed
+bool MidiDeviceManager::txServiceLanes()
+{
+    if (txLaneBytes == 0 || !port_out_open) return true;
+
+    // stage every lane that may go now, in priority order, and send them in one batch
+    txBatchBuffer.clear();
+    qint64 now = kmiHostTimeNs();
+    for (int lane = 0; lane < TX_LANE_COUNT; lane++)
     {
-        // rx
-        RPN_MSB[i] = 255;
-        RPN_LSB[i] = 255;
-        NRPN_MSB[i] = 255;
-        NRPN_LSB[i] = 255;
-        RPN_DATA_MSB[i] = 0;
-        RPN_DATA_LSB[i] = 0;
-        NRPN_DATA_MSB[i] = 0;
+        if (lane == TX_LANE_CHANNEL && txSysExOpen) break; // wait for the sysex boundary
 
-        LAST_SENT_NRPN[i] = 16384; // hopefully we never use this parameter #
+        std::vector<TX_SHORT_MESSAGE> &queue = txLane[lane];
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            txBatchBuffer.insert(txBatchBuffer.end(), queue[i].data, queue[i].data + queue[i].length);
+            txLaneBytes -= queue[i].length;
+            metrics.txLatency.record(now - queue[i].queuedNs); // until the batch call, with a tx thread until the hand-off
+        }
+        KMI_Metrics::add(metrics.txMessages, queue.size());
+        queue.clear(); // keeps its capacity
     }
+    return txFlushBatch();
 }
 
-void MidiDeviceManager::slotSendMIDI_NRPN(int parameter_number, int value, uchar channel)
+// send the staged short messages, as one OS call where the backend allows it (KMI_TxBatch)
+bool MidiDeviceManager::txFlushBatch()
 {
-    qDebug() << "slotSendMIDI_NRPN called parameter_number: " << parameter_number << " value: " << value << " channel: " << channel;
-    uint8_t param_msb, param_lsb, val_msb, val_lsb;
+    if (txBatchBuffer.empty()) return true;
+    if (capture->isRecording()) capture->append(CAPTURE_TX, kmiHostTimeNs(), txBatchBuffer.data(), txBatchBuffer.size());
 
-    if (channel & 0xF0) // check for bad values
+    // the direct CoreMIDI path is another client, keep it off while sysex is queued or half sent
+    bool allowDirect = packet.size() == 0 && !txSysExOpen;
+
+    try
     {
-        return;
+        if (txThread) txThread->sendBatch(txBatchBuffer.data(), txBatchBuffer.size(), &txBatch, allowDirect);
+        else txBatch.send(midi_out, txBatchBuffer.data(), txBatchBuffer.size(), allowDirect);
+        KMI_Metrics::add(metrics.txBytes, txBatchBuffer.size());
+        txBatchBuffer.clear(); // keeps its capacity
     }
-
-    val_msb   = (value  >> 7) & 0x7F;
-    val_lsb   =  value        & 0x7F;
-
-    //***  SEND PARAMETER NUMBER ON CHANGE  ***
-    if(parameter_number != LAST_SENT_NRPN[channel])
+    catch (RtMidiError &error)
     {
-        LAST_SENT_NRPN[channel] = parameter_number;
-
-        param_msb = (parameter_number >> 7) & 0x7F;
-        param_lsb =  parameter_number       & 0x7F;
+        KMI_Metrics::add(metrics.sendErrors);
+        DM_OUT << "MIDI SEND PACKET ERR: " << QString::fromStdString(error.getMessage()) << " Size: " << txBatchBuffer.size();
+        txBatchBuffer.clear();
+        for (int lane = 0; lane < TX_LANE_COUNT; lane++) txLane[lane].clear();
+        txLaneBytes = 0;
+        slotCloseMidiIn(SIGNAL_SEND);
+        slotCloseMidiOut(SIGNAL_SEND);
+        kmiPorts->slotRefreshPortMaps(); // kick it
+        return false;
+    }
+    return true;
+}
 
-        slotSendMIDI(MIDI_CONTROL_CHANGE, MIDI_CC_NRPN_MSB, param_msb, channel);
-        slotSendMIDI(MIDI_CONTROL_CHANGE, MIDI_CC_NRPN_LSB, param_lsb, channel);
+// *************************************************
+// Tx pacing
+// - midiSendTimer is single shot and only armed while packet has data
+// - chunks go out at sysExTxByteRate, each deadline is computed in ns from syxExTxChunkTimer
+// - when the timer resolution is coarser than one chunk several due chunks are sent per pass
+// *************************************************
+void MidiDeviceManager::slotServiceTx()
+{
+    for (int i = 0; i < TX_MAX_CHUNKS_PER_PASS; i++)
+    {
+        size_t remaining = packet.size();
+        slotEmptyMIDIBuffer();
+        if (packet.empty() || packet.size() == remaining) break; // done, or waiting for the next deadline
     }
+    scheduleTx();
+}
 
-    //***  SEND VALUE  ***
-    slotSendMIDI(MIDI_CONTROL_CHANGE, MIDI_CC_DATA_MSB, val_msb, channel);
-    slotSendMIDI(MIDI_CONTROL_CHANGE, MIDI_CC_DATA_LSB, val_lsb, channel);
+void MidiDeviceManager::slotSetTxByteRate(unsigned int bytesPerSecond)
+{
+    sysExTxByteRate = bytesPerSecond;
 }
 
-void MidiDeviceManager::slotParsePacket(QByteArray packetArray)
+double MidiDeviceManager::txByteRate() const
 {
-    // keep static for running status
-    static unsigned char status, chan;
+    if (sysExTxAdaptive) return sysExTxAdaptiveRate;
+    if (sysExTxByteRate) return sysExTxByteRate;
+    if (sysExTxChunkDelay == 0) return 0; // no speed limit
+    return sysExTxChunkSize * 1000.0 / sysExTxChunkDelay;
+}
 
-    unsigned char data1, data2;
+void MidiDeviceManager::scheduleTx()
+{
+    if (packet.empty()) txSysExOpen = false;
+    bool lanesDue = !txLane[TX_LANE_REALTIME].empty() || (!txLane[TX_LANE_CHANNEL].empty() && !txSysExOpen);
 
-    if (uchar(packetArray[0]) > 127) // not running status
+    if ((packet.empty() && !lanesDue) || !port_out_open)
     {
-        status = packetArray[0] & 0xF0;
-        chan = packetArray[0] & 0x0F;
-        // check packet length
-        data1 = (packetArray.length() > 1) ? packetArray[1] : 0;
-        data2 = (packetArray.length() > 2) ? packetArray[2] : 0;
-    }
-    else // running status
+        midiSendTimer.stop(); // nothing to send, sleep until something is queued
+        if (sysExTxBurstStartNs >= 0 && packet.empty())
+        {
+            txReportRate();
+            if (firmwareUpdateState == FWUD_STATE_FW_SENT_WAIT) handshakeKick(); // image is out, start the reboot wait now
+        }
+        return;
+    }
+
+    // channel messages and small sysex are flushed right away, only chunks wait for a deadline
+    int waitMs = 0;
+    if (!lanesDue && (packet.size() > sysExTxChunkSize || sysExTxSendLastChunk == true))
+    {
+        if (txThread && txThread->pending() > 0)
+        {
+            midiSendTimer.stop(); // don't spin while a chunk is blocked in the driver
+            return;               // signalIdle queues slotServiceTx
+        }
+
+        qint64 now = syxExTxChunkTimer.nsecsElapsed();
+        qint64 waitNs = sysExTxNextChunkNs - now;
+
+        // out of credits, an ack queues slotServiceTx, otherwise wake up for the ack timeout
+        if (sysExTxAckCredits && !sysExTxAckFallback && sysExTxCredits <= 0 && sysExTxCreditWaitNs >= 0)
+        {
+            waitNs = qMax(waitNs, sysExTxCreditWaitNs + TX_ACK_TIMEOUT_NS - now);
+        }
+        if (waitNs > 0) waitMs = (int)((waitNs + 999999) / 1000000);
+    }
+
+    if (midiSendTimer.isActive() && midiSendTimer.remainingTime() <= waitMs) return; // already due sooner
+
+    midiSendTimer.start(waitMs);
+}
+
+// *************************************************
+// Tx thread (opt in)
+// - the thread takes ownership of midi_out, every send and open/close goes through it
+// - pacing, chunking and credits still run here, the thread only makes the RtMidi calls
+// - one chunk is in flight at a time so a send blocked in the driver can't pile chunks up
+//   behind it, channel messages are queued without waiting
+// - send errors come back queued, the ports are closed as they are for a synchronous error
+// *************************************************
+void MidiDeviceManager::slotSetTxThread(bool enable)
+{
+    if (enable == (txThread != nullptr)) return;
+
+    if (enable)
+    {
+        txThread = new KMI_MidiOutThread(midi_out, this);
+        midi_out = nullptr; // owned by the thread now
+        connect(txThread, &KMI_MidiOutThread::signalSendError, this, &MidiDeviceManager::slotTxThreadError);
+        connect(txThread, &KMI_MidiOutThread::signalIdle, this, &MidiDeviceManager::slotServiceTx);
+        txThread->start(QThread::HighPriority);
+    }
+    else
+    {
+        midi_out = txThread->release(); // everything queued so far is sent first
+        delete txThread;
+        txThread = nullptr;
+    }
+    DM_OUT << "slotSetTxThread: " << enable;
+}
+
+void MidiDeviceManager::slotTxThreadError(QString errorMessage)
+{
+    DM_OUT << errorMessage;
+    KMI_Metrics::add(metrics.sendErrors);
+    if (!port_out_open) return; // already closed for an earlier error
+
+    packet.clear();
+    sysExTxSendLastChunk = false;
+    slotCloseMidiIn(SIGNAL_SEND);
+    slotCloseMidiOut(SIGNAL_SEND);
+    kmiPorts->slotRefreshPortMaps(); // kick it
+}
+
+// with a tx thread this only queues a copy, errors arrive in slotTxThreadError instead of throwing
+void MidiDeviceManager::txSend(const uchar *message, size_t size)
+{
+    if (capture->isRecording()) capture->append(CAPTURE_TX, kmiHostTimeNs(), message, size);
+
+    try
+    {
+        if (txThread) txThread->send(message, size);
+        else midi_out->sendMessage(message, size);
+    }
+    catch (RtMidiError &)
+    {
+        KMI_Metrics::add(metrics.sendErrors);
+        throw;
+    }
+    KMI_Metrics::add(metrics.txBytes, size);
+}
+
+// run a call on the RtMidiOut client from whichever thread owns it, RtMidiError propagates
+void MidiDeviceManager::midiOutCall(std::function<void(RtMidiOut *&)> function)
+{
+    if (txThread) txThread->call(function);
+    else function(midi_out);
+}
+
+// *************************************************
+// Adaptive chunking
+// - starts from the product's chunk size/delay, which are known to be safe
+// - every TX_ADAPT_GROW_AFTER good chunks the rate goes up by a quarter and the chunk size doubles
+// - a failed send or a nak halves the rate and returns to the base chunk size, a failed chunk is
+//   retried up to TX_ADAPT_MAX_RETRIES times before we give up and close the ports as before
+// - with ackCredits the device has to ack each chunk (universal ack), at most TX_ACK_WINDOW chunks
+//   are in flight. If no ack arrives within TX_ACK_TIMEOUT_NS the device is treated as not acking.
+// *************************************************
+void MidiDeviceManager::slotSetTxAdaptive(bool enable, bool ackCredits)
+{
+    if (enable && !sysExTxAdaptive)
+    {
+        sysExTxBaseChunkSize = sysExTxChunkSize ? sysExTxChunkSize : 48; // adaptive mode always chunks
+        sysExTxBaseRate = sysExTxByteRate ? sysExTxByteRate :
+                          sysExTxChunkDelay ? sysExTxBaseChunkSize * 1000.0 / sysExTxChunkDelay : TX_ADAPT_MAX_RATE;
+        sysExTxChunkSize = sysExTxBaseChunkSize;
+        sysExTxAdaptiveRate = sysExTxBaseRate;
+    }
+    else if (!enable && sysExTxAdaptive)
+    {
+        sysExTxChunkSize = sysExTxBaseChunkSize;
+    }
+
+    DM_OUT << "slotSetTxAdaptive - enable: " << enable << " ackCredits: " << ackCredits << " base rate: " << sysExTxBaseRate;
+
+    sysExTxAdaptive = enable;
+    sysExTxAckCredits = enable && ackCredits;
+    sysExTxAckFallback = false;
+    sysExTxAdaptSuccesses = 0;
+    sysExTxAdaptRetries = 0;
+    sysExTxCredits = TX_ACK_WINDOW;
+    sysExTxCreditWaitNs = -1;
+}
+
+void MidiDeviceManager::slotTxNak()
+{
+    if (sysExTxAdaptive) txAdaptBackOff(syxExTxChunkTimer.nsecsElapsed());
+}
+
+void MidiDeviceManager::txAdaptSuccess()
+{
+    sysExTxAdaptRetries = 0;
+
+    if (++sysExTxAdaptSuccesses < TX_ADAPT_GROW_AFTER) return;
+    sysExTxAdaptSuccesses = 0;
+
+    sysExTxAdaptiveRate = qMin(sysExTxAdaptiveRate * 1.25, (double)TX_ADAPT_MAX_RATE);
+    sysExTxChunkSize = qMin(sysExTxChunkSize * 2, (unsigned int)TX_ADAPT_MAX_CHUNK_SIZE);
+}
+
+void MidiDeviceManager::txAdaptBackOff(qint64 now)
+{
+    sysExTxAdaptSuccesses = 0;
+    sysExTxAdaptRetries++;
+
+    sysExTxAdaptiveRate = qMax(sysExTxAdaptiveRate / 2, sysExTxBaseRate / TX_ADAPT_MIN_RATE_DIV);
+    sysExTxChunkSize = sysExTxBaseChunkSize;
+    sysExTxNextChunkNs = now + (qint64)TX_ADAPT_BACKOFF_NS * sysExTxAdaptRetries;
+
+    DM_OUT << "Tx back off - rate: " << sysExTxAdaptiveRate << " chunk size: " << sysExTxChunkSize << " retry: " << sysExTxAdaptRetries;
+}
+
+void MidiDeviceManager::txReportRate()
+{
+    // the transfer ends when the last chunk's time slot does, not when it was handed to the driver
+    qint64 end = qMax(syxExTxChunkTimer.nsecsElapsed(), sysExTxNextChunkNs);
+    qint64 elapsedNs = end - sysExTxBurstStartNs;
+
+    sysExTxAchievedRate = elapsedNs > 0 ? sysExTxBurstBytes * 1e9 / elapsedNs : 0;
+    DM_OUT << "Tx rate achieved: " << sysExTxAchievedRate << " bytes/s, target: " << txByteRate() << " bytes: " << sysExTxBurstBytes;
+
+    emit signalTxRateReport(sysExTxAchievedRate, sysExTxBurstBytes, elapsedNs / 1000000);
+    sysExTxBurstStartNs = -1;
+}
+
+void MidiDeviceManager::slotInitNRPN()
+{
+    for (int i = 0; i < NUM_MIDI_CHANNELS; i++)
     {
-        DM_OUT << "running status!";
-        data1 = packetArray[0];
-        data2 = packetArray[1];
+        // rx
+        MIDI_PARAM_STATE &param = paramState[i];
+        param.mode = MODE_UNDEF;
+        param.rpnMSB = param.rpnLSB = 255;
+        param.nrpnMSB = param.nrpnLSB = 255;
+        param.rpnDataMSB = param.rpnDataLSB = 0;
+        param.nrpnDataMSB = param.nrpnDataLSB = 0;
+
+        // tx, the next parameter goes out with its full address
+        LAST_SENT_RPN[i] = PARAM_NONE;
+        LAST_SENT_NRPN[i] = PARAM_NONE;
+    }
+}
+
+void MidiDeviceManager::slotSendMIDI_NRPN(int parameter_number, int value, uchar channel)
+{
+    DM_VERBOSE << "slotSendMIDI_NRPN called parameter_number: " << parameter_number << " value: " << value << " channel: " << channel;
+
+    if (channel & 0xF0) // check for bad values
+    {
+        return;
+    }
+    if (restart || !connected) return; // same check as slotSendMIDI, the address isn't marked as sent
+
+    if (port_out_open == false)
+    {
+        DM_OUT << "ERROR: midi_out is not open, aborting slotSendMIDI_NRPN!";
+        return; // the address isn't marked as sent
+    }
+
+    txQueueNRPN(channel, parameter_number, value);
+
+    if (txLaneBytes > MAX_MIDI_PACKET_SIZE)
+    {
+        slotEmptyMIDIBuffer();
+    }
+
+    scheduleTx(); // same tail as slotSendMIDI
+}
+
+void MidiDeviceManager::slotSendMIDI_NRPNBlock(uchar channel, int firstParameter, QVector<int> values)
+{
+    sendNRPNBlock(channel, firstParameter, values.constData(), values.size());
+}
+
+// Calibration tables and zone setup are runs of consecutive parameters, within a run only the
+// parameter LSB changes so each value costs 3 or 4 CCs instead of 4, and they leave as one tx batch.
+void MidiDeviceManager::sendNRPNBlock(uchar channel, int firstParameter, const int *values, int count)
+{
+    DM_VERBOSE << "sendNRPNBlock called first parameter: " << firstParameter << " count: " << count << " channel: " << channel;
+
+    if ((channel & 0xF0) || values == nullptr || count <= 0 || firstParameter < 0) return;
+    if (restart || !connected) return;
+
+    if (port_out_open == false)
+    {
+        DM_OUT << "ERROR: midi_out is not open, aborting sendNRPNBlock!";
+        return;
+    }
+
+    for (int i = 0; i < count && firstParameter + i <= 0x3FFF; i++)
+    {
+        txQueueNRPN(channel, firstParameter + i, values[i]);
+
+        // long blocks go out in packet sized batches instead of piling up in the lane
+        if (txLaneBytes > MAX_MIDI_PACKET_SIZE)
+        {
+            slotEmptyMIDIBuffer();
+        }
+    }
+
+    scheduleTx(); // same tail as slotSendMIDI
+}
+
+// queue one NRPN, only the address bytes that differ from the last NRPN sent on this channel
+void MidiDeviceManager::txQueueNRPN(uchar channel, int parameter, int value)
+{
+    uint8_t param_msb, param_lsb, val_msb, val_lsb;
+
+    param_msb = (parameter >> 7) & 0x7F;
+    param_lsb =  parameter       & 0x7F;
+    val_msb   = (value  >> 7) & 0x7F;
+    val_lsb   =  value        & 0x7F;
+
+    uchar status = MIDI_CONTROL_CHANGE + channel;
+    uint16_t last = LAST_SENT_NRPN[channel];
+
+    //***  SEND PARAMETER NUMBER ON CHANGE  ***
+    if (last == PARAM_NONE || ((last >> 7) & 0x7F) != param_msb)
+    {
+        const uchar message[3] = {status, MIDI_CC_NRPN_MSB, param_msb};
+        txQueueShort(TX_LANE_CHANNEL, message, 3);
+    }
+    if (last == PARAM_NONE || (last & 0x7F) != param_lsb)
+    {
+        const uchar message[3] = {status, MIDI_CC_NRPN_LSB, param_lsb};
+        txQueueShort(TX_LANE_CHANNEL, message, 3);
+    }
+    LAST_SENT_NRPN[channel] = (param_msb << 7) | param_lsb;
+    LAST_SENT_RPN[channel] = PARAM_NONE; // the receiver is in NRPN mode now
+
+    //***  SEND VALUE  ***
+    const uchar dataMSB[3] = {status, MIDI_CC_DATA_MSB, val_msb};
+    const uchar dataLSB[3] = {status, MIDI_CC_DATA_LSB, val_lsb};
+    txQueueShort(TX_LANE_CHANNEL, dataMSB, 3);
+    txQueueShort(TX_LANE_CHANNEL, dataLSB, 3);
+}
+
+void MidiDeviceManager::slotParsePacket(QByteArray packetArray)
+{
+    parseMessage(reinterpret_cast<const unsigned char*>(packetArray.constData()), packetArray.size());
+}
+
+// parses a single channel/system common/realtime message in place, no allocation
+void MidiDeviceManager::parseMessage(const unsigned char *packetBytes, size_t length, qint64 timestampNs)
+{
+    unsigned char status, chan, data1, data2;
+    unsigned char messageType; // status for channel messages, the whole status byte for system messages
+
+    if (length == 0) return;
+
+    rxEventTimestampNs = timestampNs; // batch events and directly connected slots read it
+
+    if (packetBytes[0] > 127) // not running status
+    {
+        status = packetBytes[0] & 0xF0;
+        chan = packetBytes[0] & 0x0F;
+        messageType = (status == 0xF0) ? packetBytes[0] : status;
+        // check packet length
+        data1 = (length > 1) ? packetBytes[1] : 0;
+        data2 = (length > 2) ? packetBytes[2] : 0;
+
+        if (status != 0xF0)
+        {
+            rxRunningStatus = status;
+            rxRunningChan = chan;
+        }
+        else if (packetBytes[0] < MIDI_RT_CLOCK)
+        {
+            rxRunningStatus = 0; // system common cancels running status, realtime leaves it alone
+        }
+    }
+    else // running status
+    {
+        if (rxRunningStatus == 0) return; // nothing to run with
+
+        DM_VERBOSE << "running status!";
+        status = messageType = rxRunningStatus;
+        chan = rxRunningChan;
+        data1 = packetBytes[0];
+        data2 = (length > 1) ? packetBytes[1] : 0;
     }
 
 #ifdef MDM_DEBUG_ENABLED
     DM_OUT << "Packet Received - status: " << status << " ch: " << chan << " d1: " << data1 << " d2: " << data2;
 #endif
 
+    // queue the decoded event for signalRxMidiBatch
+    if (rxBatchMode)
+    {
+        int value;
+        switch (messageType)
+        {
+        case MIDI_PITCH_BEND:       value = (data1 << 7) | data2; break;
+        case MIDI_PROG_CHANGE:
+        case MIDI_CHANNEL_PRESSURE:
+        case MIDI_SONG_SELECT:      value = data1; break;
+        default:                    value = data2; break;
+        }
+        rxBatchAppend(messageType, chan, data1, data2, data1, value);
+    }
+
+    bool emitSignals = rxPerEventSignals;
+
     // emit raw packet, makes direct routing between ports simple
-    emit signalRxMidi_raw(status, data1, data2, chan);
+    if (emitSignals)
+    {
+        emit signalRxMidi_raw(status, data1, data2, chan);
+        emit signalRxMidi_rawTimed(status, data1, data2, chan, timestampNs);
+        metrics.rxLatency.record(kmiHostTimeNs() - timestampNs); // the typed signals follow right after
+    }
 
     // handle channel messages
-    switch(status)
+    switch(messageType)
     {
     case MIDI_NOTE_OFF:
-        emit signalRxMidi_noteOff(chan, data1, data2);
+        if (emitSignals) emit signalRxMidi_noteOff(chan, data1, data2);
         break;
 
     case MIDI_NOTE_ON: // 0x09
-        emit signalRxMidi_noteOn(chan, data1, data2);
+        if (emitSignals) emit signalRxMidi_noteOn(chan, data1, data2);
         break;
 
     case MIDI_NOTE_AFTERTOUCH: // 0xA0
-        emit signalRxMidi_polyAT(chan, data1, data2);
+        if (emitSignals) emit signalRxMidi_polyAT(chan, data1, data2);
         break;
 
     case MIDI_CONTROL_CHANGE:
         unsigned cc, val;
+        MIDI_PARAM_STATE *param;
         cc = data1;
         val = data2;
+        param = &paramState[chan];
 
-        emit signalRxMidi_controlChange(chan, data1, data2); // emit all CCs, including NRPN related ones
+        if (emitSignals) emit signalRxMidi_controlChange(chan, data1, data2); // emit all CCs, including NRPN related ones
 
         switch (cc) // also parse NRPN messaging
         {
@@ -1796,41 +2644,41 @@ void MidiDeviceManager::slotParsePacket(QByteArray packetArray)
 
             case MIDI_CC_RPN_LSB:
             {
-                RPN_LSB[chan] = val;
-                paramMode = MODE_RPN;
+                param->rpnLSB = val;
+                param->mode = (param->rpnMSB == 127 && param->rpnLSB == 127) ? MODE_UNDEF : MODE_RPN; // null function
                 break;
             }
 
             case MIDI_CC_RPN_MSB:
             {
-                RPN_MSB[chan] = val;
-                paramMode = MODE_RPN;
+                param->rpnMSB = val;
+                param->mode = (param->rpnMSB == 127 && param->rpnLSB == 127) ? MODE_UNDEF : MODE_RPN;
                 break;
             }
 
             case MIDI_CC_NRPN_LSB:
             {
-                NRPN_LSB[chan] = val;
-                paramMode = MODE_NRPN;
+                param->nrpnLSB = val;
+                param->mode = MODE_NRPN;
                 break;
             }
 
             case MIDI_CC_NRPN_MSB:
             {
-                NRPN_MSB[chan] = val;
-                paramMode = MODE_NRPN;
+                param->nrpnMSB = val;
+                param->mode = MODE_NRPN;
                 break;
             }
 
             case MIDI_CC_DATA_MSB:
             {
-                if (paramMode == MODE_RPN)
+                if (param->mode == MODE_RPN)
                 {
-                    RPN_DATA_MSB[chan] = val; // wait for LSB
+                    param->rpnDataMSB = val; // wait for LSB
                 }
-                else if (paramMode == MODE_NRPN)
+                else if (param->mode == MODE_NRPN)
                 {
-                    NRPN_DATA_MSB[chan] = val; // wait for LSB
+                    param->nrpnDataMSB = val; // wait for LSB
                 }
                 break;
             }
@@ -1838,45 +2686,45 @@ void MidiDeviceManager::slotParsePacket(QByteArray packetArray)
             // when we receive the LSB, we then emit the data
             case MIDI_CC_DATA_LSB:
             {
-                if (paramMode == MODE_RPN)
+                if (param->mode == MODE_RPN)
                 {
-                    RPN_DATA_LSB[chan] = val;
-                    emit signalRxMidi_RPN(chan, (RPN_MSB[chan] << 7) | (RPN_LSB[chan]), (RPN_DATA_MSB[chan] << 7) | (RPN_DATA_LSB[chan]));
+                    param->rpnDataLSB = val;
+                    rxEmitRPN(chan);
                 }
-                else if (paramMode == MODE_NRPN)
+                else if (param->mode == MODE_NRPN)
                 {
-                    NRPN_DATA_LSB[chan] = val;
-                    emit signalRxMidi_NRPN(chan, (NRPN_MSB[chan] << 7) | (NRPN_LSB[chan]), (NRPN_DATA_MSB[chan] << 7) | (NRPN_DATA_LSB[chan]));
+                    param->nrpnDataLSB = val;
+                    rxEmitNRPN(chan);
                 }
                 break;
             }
 
             case MIDI_CC_DATA_INC:
             {
-                if (paramMode == MODE_RPN && RPN_DATA_LSB[chan] < 0xFF)
+                if (param->mode == MODE_RPN && param->rpnDataLSB < 0xFF)
                 {
-                    RPN_DATA_LSB[chan]++;
-                    emit signalRxMidi_RPN(chan, (RPN_MSB[chan] << 7) | (RPN_LSB[chan]), (RPN_DATA_MSB[chan] << 7) | (RPN_DATA_LSB[chan]));
+                    param->rpnDataLSB++;
+                    rxEmitRPN(chan);
                 }
-                else if (paramMode == MODE_NRPN && NRPN_DATA_LSB[chan] < 0xFF)
+                else if (param->mode == MODE_NRPN && param->nrpnDataLSB < 0xFF)
                 {
-                    NRPN_DATA_LSB[chan]++;
-                    emit signalRxMidi_NRPN(chan, (NRPN_MSB[chan] << 7) | (NRPN_LSB[chan]), (NRPN_DATA_MSB[chan] << 7) | (NRPN_DATA_LSB[chan]));
+                    param->nrpnDataLSB++;
+                    rxEmitNRPN(chan);
                 }
                 break;
             }
 
             case MIDI_CC_DATA_DEC:
             {
-                if (paramMode == MODE_RPN && RPN_DATA_LSB[chan] > 0)
+                if (param->mode == MODE_RPN && param->rpnDataLSB > 0)
                 {
-                    RPN_DATA_LSB[chan]--;
-                    emit signalRxMidi_RPN(chan, (RPN_MSB[chan] << 7) | (RPN_LSB[chan]), (RPN_DATA_MSB[chan] << 7) | (RPN_DATA_LSB[chan]));
+                    param->rpnDataLSB--;
+                    rxEmitRPN(chan);
                 }
-                else if (paramMode == MODE_NRPN && NRPN_DATA_LSB[chan] > 0)
+                else if (param->mode == MODE_NRPN && param->nrpnDataLSB > 0)
                 {
-                    NRPN_DATA_LSB[chan]--;
-                    emit signalRxMidi_NRPN(chan, (NRPN_MSB[chan] << 7) | (NRPN_LSB[chan]), (NRPN_DATA_MSB[chan] << 7) | (NRPN_DATA_LSB[chan]));
+                    param->nrpnDataLSB--;
+                    rxEmitNRPN(chan);
                 }
                 break;
             }
@@ -1891,60 +2739,440 @@ void MidiDeviceManager::slotParsePacket(QByteArray packetArray)
         break; // end CCs
 
     case MIDI_PROG_CHANGE:
-        emit signalRxMidi_progChange(chan, data1);
+        if (emitSignals) emit signalRxMidi_progChange(chan, data1);
         break;
 
     case MIDI_CHANNEL_PRESSURE:
-        emit signalRxMidi_aftertouch(chan, data1);
+        if (emitSignals) emit signalRxMidi_aftertouch(chan, data1);
         break;
 
     case MIDI_PITCH_BEND:
-        emit signalRxMidi_pitchBend(chan, (data1 << 7) | data2);
+        if (emitSignals) emit signalRxMidi_pitchBend(chan, (data1 << 7) | data2);
         break;
 
     // handle system common messages
 
     case MIDI_MTC:
-        emit signalRxMidi_MTC(data1, data2);
+        if (emitSignals) emit signalRxMidi_MTC(data1, data2);
         break;
     case MIDI_SONG_POSITION:
-        emit signalRxMidi_SongPosition(data1, data2);
+        if (emitSignals) emit signalRxMidi_SongPosition(data1, data2);
         break;
     case MIDI_SONG_SELECT:
-        emit signalRxMidi_SongSelect(data1);
+        if (emitSignals) emit signalRxMidi_SongSelect(data1);
         break;
     case MIDI_TUNE_REQUEST:
-        emit signalRxMidi_TuneReq();
+        if (emitSignals) emit signalRxMidi_TuneReq();
         break;
     case MIDI_RT_CLOCK:
-        emit signalRxMidi_Clock();
+        if (emitSignals) emit signalRxMidi_Clock();
         break;
     case MIDI_RT_START:
-        emit signalRxMidi_Start();
+        if (emitSignals) emit signalRxMidi_Start();
         break;
     case MIDI_RT_CONTINUE:
-        emit signalRxMidi_Continue();
+        if (emitSignals) emit signalRxMidi_Continue();
         break;
     case MIDI_RT_STOP:
-        emit signalRxMidi_Stop();
+        if (emitSignals) emit signalRxMidi_Stop();
         break;
     case MIDI_RT_ACTIVE_SENSE:
-        emit signalRxMidi_ActSense();
+        if (emitSignals) emit signalRxMidi_ActSense();
         break;
     case MIDI_RT_RESET:
-        emit signalRxMidi_SysReset();
+        if (emitSignals) emit signalRxMidi_SysReset();
         break;
     }
 }
 
+// **********************************************************************************
+
+// emit the current RPN for this channel, and/or add it to the rx batch
+void MidiDeviceManager::rxEmitRPN(uchar chan)
+{
+    const MIDI_PARAM_STATE &param = paramState[chan];
+    int rpn = (param.rpnMSB << 7) | (param.rpnLSB);
+    int val = (param.rpnDataMSB << 7) | (param.rpnDataLSB);
+
+    if (rxBatchMode) rxBatchAppend(MIDI_EVENT_RPN, chan, param.rpnDataMSB, param.rpnDataLSB, rpn, val);
+    if (rxPerEventSignals) emit signalRxMidi_RPN(chan, rpn, val);
+}
+
+// emit the current NRPN for this channel, and/or add it to the rx batch
+void MidiDeviceManager::rxEmitNRPN(uchar chan)
+{
+    const MIDI_PARAM_STATE &param = paramState[chan];
+    int nrpn = (param.nrpnMSB << 7) | (param.nrpnLSB);
+    int val = (param.nrpnDataMSB << 7) | (param.nrpnDataLSB);
+
+    if (rxBatchMode) rxBatchAppend(MIDI_EVENT_NRPN, chan, param.nrpnDataMSB, param.nrpnDataLSB, nrpn, val);
+    if (rxPerEventSignals) emit signalRxMidi_NRPN(chan, nrpn, val);
+}
+
+// **********************************************************************************
+// ***** Rx Batch *******************************************************************
+// **********************************************************************************
+
+// Opt in bulk delivery. Decoded events are collected and emitted with signalRxMidiBatch once per
+// drain cycle (per slotDrainRxRing call). Batches are built on the owner thread, so this turns the
+// rx ring on, and turning the ring off ends batch mode.
+// coalesce - only the latest value of each CC, poly aftertouch, pitch bend and channel pressure is kept
+//            per channel in a batch. RPN/NRPN controllers are never coalesced.
+// perEventSignals - keep emitting signalRxMidi_raw and the typed signals alongside the batch
+void MidiDeviceManager::slotSetRxBatchMode(bool enable, bool coalesce, bool perEventSignals)
+{
+    DM_OUT << "slotSetRxBatchMode called - enable: " << enable << " coalesce: " << coalesce << " perEventSignals: " << perEventSignals;
+
+    slotFlushRxBatch(); // deliver anything collected under the previous settings
+
+    if (enable && !rxRingMode) slotSetRxRingMode(true); // the callback would otherwise batch on the RtMidi thread
+
+    rxBatchMode = enable;
+    rxBatchCoalesce = coalesce;
+    rxPerEventSignals = enable ? perEventSignals : true; // can't turn off per event signals without a batch
+}
+
+void MidiDeviceManager::rxBatchAppend(uchar type, uchar chan, uchar d1, uchar d2, int param, int value)
+{
+    short *slot = nullptr;
+
+    if (rxBatchCoalesce && chan < NUM_MIDI_CHANNELS)
+    {
+        switch (type)
+        {
+        case MIDI_CONTROL_CHANGE:
+            if (d1 < 128 &&
+                d1 != MIDI_CC_DATA_MSB && d1 != MIDI_CC_DATA_LSB &&
+                (d1 < MIDI_CC_DATA_INC || d1 > MIDI_CC_RPN_MSB)) // the parameter CCs are order dependant
+            {
+                slot = &rxCoalesceCC[chan][d1];
+            }
+            break;
+        case MIDI_NOTE_AFTERTOUCH:
+            if (d1 < 128) slot = &rxCoalescePolyAT[chan][d1];
+            break;
+        case MIDI_PITCH_BEND:
+            slot = &rxCoalesceBend[chan];
+            break;
+        case MIDI_CHANNEL_PRESSURE:
+            slot = &rxCoalescePressure[chan];
+            break;
+        }
+    }
+
+    MIDI_EVENT event = {type, chan, d1, d2, param, value, rxEventTimestampNs};
+
+    if (slot != nullptr && *slot >= 0)
+    {
+        rxBatch[*slot] = event; // overwrite the earlier value, keeps its position in the batch
+        return;
+    }
+
+    if (slot != nullptr)
+    {
+        *slot = rxBatch.size();
+    }
+    rxBatch.append(event);
+}
+
+void MidiDeviceManager::slotFlushRxBatch()
+{
+    if (rxBatch.isEmpty()) return;
+
+    // only clear the coalesce slots this batch used, much cheaper than wiping the tables
+    if (rxBatchCoalesce)
+    {
+        for (int i = 0; i < rxBatch.size(); i++)
+        {
+            const MIDI_EVENT &event = rxBatch.at(i);
+
+            if (event.chan >= NUM_MIDI_CHANNELS) continue;
+
+            switch (event.type)
+            {
+            case MIDI_CONTROL_CHANGE:   if (event.d1 < 128) rxCoalesceCC[event.chan][event.d1] = -1; break;
+            case MIDI_NOTE_AFTERTOUCH:  if (event.d1 < 128) rxCoalescePolyAT[event.chan][event.d1] = -1; break;
+            case MIDI_PITCH_BEND:       rxCoalesceBend[event.chan] = -1; break;
+            case MIDI_CHANNEL_PRESSURE: rxCoalescePressure[event.chan] = -1; break;
+            }
+        }
+    }
+
+    emit signalRxMidiBatch(MidiEventSpan(rxBatch));
+
+    if (!rxPerEventSignals) // otherwise already recorded at the per event emit
+    {
+        qint64 now = kmiHostTimeNs();
+        for (int i = 0; i < rxBatch.size(); i++) metrics.rxLatency.record(now - rxBatch.at(i).timestampNs);
+    }
+
+    rxBatch.clear(); // keeps capacity unless a queued receiver still holds this batch
+}
+
+// **********************************************************************************
+// ***** Rx Ring ********************************************************************
+// **********************************************************************************
+
+// When enabled, midiInCallback only copies incoming messages into rxRing and queues a single
+// slotDrainRxRing call. Parsing, signal emission and all state changes then happen on the thread
+// that owns this object.
+void MidiDeviceManager::slotSetRxRingMode(bool enable)
+{
+    DM_OUT << "slotSetRxRingMode called - enable: " << enable;
+
+    if (rxRingMode == enable) return;
+
+    rxRingMode = enable;
+
+    if (!enable)
+    {
+        slotDrainRxRing(); // parse anything the callback already queued
+
+        if (rxBatchMode)
+        {
+            DM_OUT << "rx batch mode needs the rx ring, turning it off";
+            slotSetRxBatchMode(false);
+        }
+    }
+}
+
+void MidiDeviceManager::slotSetRxClockEstimator(bool enable)
+{
+    DM_OUT << "slotSetRxClockEstimator called - enable: " << enable;
+    rxClock.setEstimator(enable);
+}
+
+// Clock arrives at 24 ppqn per device, active sense at ~3 Hz. With the fast path they are counted in
+// the callback (tempo, beat position, last sense time) and never parsed or signalled per tick, the
+// owner thread only hears about beats, tempo changes and transport changes.
+void MidiDeviceManager::slotSetRxRealtimeFastPath(bool enable)
+{
+    DM_OUT << "slotSetRxRealtimeFastPath called - enable: " << enable;
+    rxRealtimeFastPath = enable;
+}
+
+void MidiDeviceManager::slotSetRxRealtimeIgnore(bool clock, bool activeSense)
+{
+    DM_OUT << "slotSetRxRealtimeIgnore called - clock: " << clock << " active sense: " << activeSense;
+    rxIgnoreTiming = clock;
+    rxIgnoreSense = activeSense;
+
+    if (!port_in_open) return; // applied when the port opens
+
+    try
+    {
+        midi_in->ignoreTypes( false, rxIgnoreTiming, rxIgnoreSense );
+    }
+    catch (RtMidiError &error)
+    {
+        DM_OUT << "ignoreTypes error:" << (QString::fromStdString(error.getMessage()));
+    }
+}
+
+// Inbound sysex up to this size is kept, pieces delivered over several callbacks are joined first.
+// The pool's buffers can only be reserved while the callback is off, so with the in port open the
+// new size takes effect the next time it opens.
+void MidiDeviceManager::slotSetRxSysExMaxSize(int bytes)
+{
+    DM_OUT << "slotSetRxSysExMaxSize called - bytes: " << bytes;
+
+    if (bytes <= 0) return;
+    rxSysExMaxSize = (size_t)bytes;
+
+    if (!port_in_open) rxSysExPool.configure(rxSysExMaxSize);
+}
+
+// callback thread, true if the message was fully handled here
+bool MidiDeviceManager::rxRealtimePath(uchar status, qint64 timestampNs)
+{
+    switch (status)
+    {
+    case MIDI_RT_CLOCK:
+        if (rxRealtime.clock(timestampNs)) rxRealtimeNotify();
+        return true;
+    case MIDI_RT_ACTIVE_SENSE:
+        rxRealtime.sense(timestampNs);
+        return true;
+    // transport is rare, it's tracked here and still parsed so signalRxMidi_Start etc. fire
+    case MIDI_RT_START:
+        rxRealtime.start();
+        rxRealtimeNotify();
+        return false;
+    case MIDI_RT_CONTINUE:
+        rxRealtime.resume();
+        rxRealtimeNotify();
+        return false;
+    case MIDI_RT_STOP:
+        rxRealtime.stop();
+        rxRealtimeNotify();
+        return false;
+    case MIDI_RT_RESET:
+        return false;
+    default:
+        return true; // 0xF9/0xFD are undefined
+    }
+}
+
+// one queued slotEmitRealtime at a time, however many beats passed in between
+void MidiDeviceManager::rxRealtimeNotify()
+{
+    if (!rxRealtimeEmitPending.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, "slotEmitRealtime", Qt::QueuedConnection);
+    }
+}
+
+void MidiDeviceManager::slotEmitRealtime()
+{
+    rxRealtimeEmitPending = false; // clear first, a beat from now on queues another call
+
+    bool running = rxRealtime.isRunning();
+    if (running != rxTransportReported)
+    {
+        rxTransportReported = running;
+        emit signalRxTransport(running);
+    }
+
+    quint64 beat = rxRealtime.beatCount();
+    if (beat != rxBeatReported)
+    {
+        rxBeatReported = beat;
+        emit signalRxBeat(beat);
+    }
+
+    double bpm = rxRealtime.bpm();
+    if (qAbs(bpm - rxTempoReported) >= RT_TEMPO_DEADBAND)
+    {
+        rxTempoReported = bpm;
+        emit signalRxTempo(bpm);
+    }
+}
+
+void MidiDeviceManager::slotDrainRxRing()
+{
+    RX_RING_EVENT event;
+    int eventCount = 0;
+
+    // clear first so that anything pushed from now on queues another drain
+    rxRingDrainPending = false;
+
+    while (rxRing.pop(event))
+    {
+        const unsigned char *bytes = rxRing.bytes(event);
+
+        if (event.poolBuffer >= 0)
+        {
+            // joined or oversized sysex, processed in place and handed back to the pool
+            std::vector< unsigned char > *sysExMessage = rxSysExPool.vector(event.poolBuffer);
+            rxEventTimestampNs = event.timestampNs;
+            slotProcessSysEx(QByteArray::fromRawData(reinterpret_cast<const char*>(sysExMessage->data()), (int)sysExMessage->size()), sysExMessage);
+            rxSysExPool.release(event.poolBuffer);
+        }
+        else if (bytes[0] == MIDI_SX_START)
+        {
+            rxRingSysExMessage.assign(bytes, bytes + event.length); // reused, no allocation once it has grown
+            rxRing.releaseSlab(event); // copied, give the slab back to the callback
+
+            rxEventTimestampNs = event.timestampNs;
+            slotProcessSysEx(QByteArray::fromRawData(reinterpret_cast<const char*>(rxRingSysExMessage.data()), (int)rxRingSysExMessage.size()), &rxRingSysExMessage);
+        }
+        else
+        {
+            parseMessage(bytes, event.length, event.timestampNs);
+            rxRing.releaseSlab(event); // anything longer than RX_RING_INLINE_SIZE is in the slab too
+        }
+
+        // don't starve the event loop under dense streams, pick up the rest on the next pass
+        if (++eventCount >= RX_RING_DRAIN_BATCH && !rxRing.isEmpty())
+        {
+            if (!rxRingDrainPending.exchange(true))
+            {
+                QMetaObject::invokeMethod(this, "slotDrainRxRing", Qt::QueuedConnection);
+            }
+            break;
+        }
+    }
+
+    if (rxBatchMode) slotFlushRxBatch(); // one batch per drain cycle
+}
+
+// **********************************************************************************
+// ***** Metrics ********************************************************************
+// **********************************************************************************
+
+// counters are always on, this only controls the periodic signal
+void MidiDeviceManager::slotSetMetricsInterval(int ms)
+{
+    if (ms <= 0)
+    {
+        if (metricsTimer) metricsTimer->stop();
+        return;
+    }
+
+    if (metricsTimer == nullptr)
+    {
+        metricsTimer = new QTimer(this);
+        connect(metricsTimer, &QTimer::timeout, this, &MidiDeviceManager::slotEmitMetrics);
+    }
+    metricsTimer->start(ms);
+}
+
+void MidiDeviceManager::slotResetMetrics()
+{
+    metrics.reset();
+}
+
+void MidiDeviceManager::slotEmitMetrics()
+{
+    emit signalMetrics(metrics.snapshot());
+}
+
+// **********************************************************************************
+// ***** Capture ********************************************************************
+// **********************************************************************************
+// Everything received (in the RtMidi callback, before parsing) and everything written to midi_out is
+// appended to a binary log. The callers only queue a copy, the file is written on the writer thread.
+bool MidiDeviceManager::slotStartCapture(QString filePath)
+{
+    if (!capture->start(filePath))
+    {
+        DM_OUT << "slotStartCapture: couldn't open " << filePath;
+        return false;
+    }
+    DM_OUT << "capture started - " << deviceName << " file: " << filePath;
+    return true;
+}
+
+void MidiDeviceManager::slotStopCapture()
+{
+    if (!capture->isRecording() && !capture->isRunning()) return;
+
+    capture->stop();
+    DM_OUT << "capture stopped - records: " << capture->records() << " bytes: " << capture->bytesWritten() << " dropped: " << capture->dropped();
+}
+
 // **********************************************************************************
 // ***** Error Popup ****************************************************************
 // **********************************************************************************
+// Called from the receive path (feedback loop), so it must not block: the message box is non-modal
+// and is created on the GUI thread, whichever thread this manager lives in. Without a QApplication
+// (headless) there is nothing to show and signalErrorMessage is the only report.
 void MidiDeviceManager::slotErrorPopup(QString errorMessage)
 {
-    QMessageBox errBox;
-    errBox.setText(errorMessage);
-    errBox.exec();
+    DM_OUT << "ERROR: " << errorMessage;
+    emit signalErrorMessage(errorMessage);
+
+#ifndef KMI_MDM_HEADLESS
+    if (qobject_cast<QApplication *>(QCoreApplication::instance()) == nullptr) return; // no widgets
+
+    QTimer::singleShot(0, QCoreApplication::instance(), [errorMessage]()
+    {
+        QMessageBox *errBox = new QMessageBox();
+        errBox->setAttribute(Qt::WA_DeleteOnClose);
+        errBox->setText(errorMessage);
+        errBox->show();
+    });
+#endif
 }
 
 // **********************************************************************************
@@ -1953,12 +3181,24 @@ void MidiDeviceManager::slotErrorPopup(QString errorMessage)
 
 void MidiDeviceManager::midiInCallback( double deltatime, std::vector< unsigned char > *message, void *thisCaller )
 {
-    if (deltatime == 0 && 1 == 0) return; // suppress warning
-
     // create pointer for the mdm that called this
     MidiDeviceManager * thisMidiDeviceManager;
     thisMidiDeviceManager = (MidiDeviceManager*) thisCaller;
 
+    // stamp before anything is queued, RtMidi's delta places the message on the driver timeline
+    qint64 timestampNs = thisMidiDeviceManager->rxClock.stamp(deltatime, kmiHostTimeNs());
+    thisMidiDeviceManager->capture->append(CAPTURE_RX, timestampNs, message->data(), message->size()); // copied into the preallocated rx lane, no allocation, lock or file I/O here
+
+    KMI_Metrics::add(thisMidiDeviceManager->metrics.rxMessages);
+    KMI_Metrics::add(thisMidiDeviceManager->metrics.rxBytes, message->size());
+
+    // realtime fast path, clock and active sense never reach the parser or the rx ring
+    if (thisMidiDeviceManager->rxRealtimeFastPath.load(std::memory_order_relaxed) &&
+        message->size() == 1 && message->at(0) >= MIDI_RT_CLOCK)
+    {
+        if (thisMidiDeviceManager->rxRealtimePath(message->at(0), timestampNs)) return;
+    }
+
     if (message->at(0) != 248) // ignore clock
     {
 #ifdef MDM_DEBUG_ENABLED
@@ -1966,52 +3206,91 @@ void MidiDeviceManager::midiInCallback( double deltatime, std::vector< unsigned
 #endif
     }
 
-    QByteArray packetArray;
+    // join sysex delivered in pieces, whole messages are used in place
+    KMI_RxSysExPool &sysExPool = thisMidiDeviceManager->rxSysExPool;
+    int sysExState = sysExPool.feed(message->data(), message->size());
+    int sysExBuffer = -1;
 
-    // ioGate used to pause MIDI during sysex...?
-    if(thisMidiDeviceManager->ioGate)
+    switch (sysExState)
     {
-        if (message->size() < 999)
-        {
-            // load the packet into our QByteArray
-            for (int i = 0; i < (int)message->size(); i++)
-            {
-                packetArray.append( (uchar)message->at(i) );
+    case RX_SYSEX_PENDING:
+        return; // more to come
+    case RX_SYSEX_DROPPED:
+        KMI_Metrics::add(thisMidiDeviceManager->metrics.rxDropped); // reported through getMetrics/signalMetrics
 #ifdef MDM_DEBUG_ENABLED
-                if (message->at(0) != 248) // ignore clock
-                    DM_OUT_P << "Byte[" << i <<"]: " << message->at(i);
+        DM_OUT_P << "ERROR- SysEx dropped, longer than" << sysExPool.maxSize() << "bytes or no free rx buffer (" << message->size() << " bytes)";
 #endif
-            }
-
-            //DM_OUT_P << "midi in - message size: " << message->size() << " byte0: " << (uchar)packetArray[0];
+        return;
+    case RX_SYSEX_COMPLETE:
+        sysExBuffer = sysExPool.completed();
+        break;
+    }
 
-            // standard messages
-            if ((uchar)packetArray[0] != (uchar)MIDI_SX_START)
-            {
-                if (message->at(0) != 248) // ignore clock
-                {
-#ifdef MDM_DEBUG_ENABLED
-                    DM_OUT_P << "MIDI Channel Event: ";
-#endif
-                }
-                thisMidiDeviceManager->slotParsePacket(packetArray);
-            }
-            else // sysex
+    // input is never gated, sysex uploads only affect the tx lanes
+    if (thisMidiDeviceManager->rxRingMode && !message->empty())
+    {
+        // hand off to the owning thread, one queued drain per batch of messages
+        bool queued;
+        if (sysExBuffer < 0 && sysExState == RX_SYSEX_WHOLE && message->size() > RX_RING_SYSEX_SLAB_SIZE)
+        {
+            sysExBuffer = sysExPool.acquireCopy(message->data(), message->size()); // won't fit the slab
+            if (sysExBuffer < 0)
             {
-#ifdef MDM_DEBUG_ENABLED
-                DM_OUT_P << "SysEx received";
- #endif
-                thisMidiDeviceManager->slotProcessSysEx(packetArray, message);
+                KMI_Metrics::add(thisMidiDeviceManager->metrics.rxDropped); // every pool buffer in flight
+                return;
             }
         }
+
+        if (sysExBuffer >= 0)
+        {
+            queued = thisMidiDeviceManager->rxRing.pushPooled(timestampNs, sysExBuffer, sysExPool.length(sysExBuffer));
+            if (!queued) sysExPool.release(sysExBuffer);
+        }
         else
         {
-            DM_OUT_P << "ERROR- MIDI Message greater than 999 bytes (" << message->size() << " bytes) - write some more code to handle this!!";
+            queued = thisMidiDeviceManager->rxRing.push(timestampNs, message->data(), message->size());
+        }
+
+        if (!queued)
+        {
+            KMI_Metrics::add(thisMidiDeviceManager->metrics.rxDropped); // ring full
         }
+        else if (!thisMidiDeviceManager->rxRingDrainPending.exchange(true))
+        {
+            QMetaObject::invokeMethod(thisMidiDeviceManager, "slotDrainRxRing", Qt::QueuedConnection);
+        }
+        return;
     }
-    else
+
+#ifdef MDM_DEBUG_ENABLED
+    for (int i = 0; i < (int)message->size(); i++)
     {
-        DM_OUT_P << "ioGate stopped midiInCallback - message size:" << message->size();
-        return; // do not send MIDI while sysex is transmitting
+        if (message->at(0) != 248) // ignore clock
+            DM_OUT_P << "Byte[" << i <<"]: " << message->at(i);
+    }
+#endif
+
+    // standard messages
+    if (sysExState == RX_SYSEX_NOT_SYSEX)
+    {
+        if (message->at(0) != 248) // ignore clock
+        {
+#ifdef MDM_DEBUG_ENABLED
+            DM_OUT_P << "MIDI Channel Event: ";
+#endif
+        }
+        // parse straight from the RtMidi buffer, no copy
+        thisMidiDeviceManager->parseMessage(message->data(), message->size(), timestampNs);
+    }
+    else // sysex, a view of the RtMidi buffer or of the pool buffer it was joined in
+    {
+#ifdef MDM_DEBUG_ENABLED
+        DM_OUT_P << "SysEx received";
+#endif
+        std::vector< unsigned char > *sysExMessage = sysExBuffer < 0 ? message : sysExPool.vector(sysExBuffer);
+        QByteArray packetArray = QByteArray::fromRawData(reinterpret_cast<const char*>(sysExMessage->data()), (int)sysExMessage->size());
+        thisMidiDeviceManager->rxEventTimestampNs = timestampNs;
+        thisMidiDeviceManager->slotProcessSysEx(packetArray, sysExMessage);
+        if (sysExBuffer >= 0) sysExPool.release(sysExBuffer);
     }
 }
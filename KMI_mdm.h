@@ -15,16 +15,30 @@
 */
 
 #include <QDebug>
-#include <QWidget>
-#include <QtGui>
-#include <QApplication>
+#include <QObject>
+#include <QtCore>
 #include <QTimer>
 #include <QElapsedTimer>
 
+#include <atomic>
+#include <functional>
+
 #include "RtMidi.h"
 #include "KMI_ports.h"
+#include "KMI_rxRing.h"
+#include "KMI_rxClock.h"
+#include "KMI_rxRealtime.h"
+#include "KMI_rxSysEx.h"
+#include "KMI_metrics.h"
+#include "KMI_capture.h"
+#include "KMI_txQueue.h"
+#include "KMI_fwImage.h"
+#include "KMI_midiOutThread.h"
+#include "KMI_txBatch.h"
 #include "midi.h"
 
+class QDialog; // errDialog, the core doesn't include QtWidgets
+
 typedef enum
 {
     MODE_UNDEF,
@@ -32,6 +46,18 @@ typedef enum
     MODE_NRPN
 } PARAM_MODE;
 
+// rx RPN/NRPN state for one channel, the callback only touches this channel's cache line
+typedef struct alignas(64)
+{
+    uchar mode;                 // PARAM_MODE, set by whichever address CC arrived last on this channel
+    uchar rpnMSB, rpnLSB;       // CC101/CC100, 127/127 is the RPN null function
+    uchar nrpnMSB, nrpnLSB;     // CC99/CC98
+    uchar rpnDataMSB, rpnDataLSB;   // CC6/CC38, kept per parameter type so switching doesn't mix values
+    uchar nrpnDataMSB, nrpnDataLSB;
+} MIDI_PARAM_STATE;
+
+#define PARAM_NONE 0xFFFF // LAST_SENT_* value that never matches a parameter, the next send carries the full address
+
 enum PARAM_DATA_TYPES
 {
     DATA_LSB,
@@ -47,6 +73,74 @@ enum
     SIGNAL_SEND
 };
 
+// tx priority lanes for short messages, bulk sysex is queued in packet behind both
+enum
+{
+    TX_LANE_REALTIME,   // clock, start/stop, active sense, may go out between any two sysex chunks
+    TX_LANE_CHANNEL,    // channel and system common, only at a sysex message boundary
+    TX_LANE_COUNT
+};
+
+typedef struct
+{
+    uchar length;
+    uchar data[3];
+    qint64 queuedNs;    // kmiHostTimeNs() when queued, for the tx latency histogram
+} TX_SHORT_MESSAGE;
+
+// decoded parameter events only appear in rx batches, they can't collide with a status byte
+#define MIDI_EVENT_RPN  0x01
+#define MIDI_EVENT_NRPN 0x02
+
+// a decoded rx event, delivered in bulk by signalRxMidiBatch
+typedef struct
+{
+    uchar type;     // channel status (MIDI_NOTE_ON etc), full system status byte (MIDI_RT_CLOCK etc), or MIDI_EVENT_RPN/NRPN
+    uchar chan;
+    uchar d1;
+    uchar d2;
+    int param;      // note/cc number, or the RPN/NRPN parameter number
+    int value;      // d2 for 3 byte messages, d1 for 2 byte messages, 14 bit value for pitch bend and RPN/NRPN
+    qint64 timestampNs; // host time the message arrived, kmiHostTimeNs() timeline (KMI_rxClock.h)
+} MIDI_EVENT;
+
+// contiguous, read-only array of events from one drain cycle. The data is implicitly shared, so
+// queued (cross-thread) delivery only copies a reference.
+class MidiEventSpan
+{
+public:
+    MidiEventSpan() {}
+    explicit MidiEventSpan(const QVector<MIDI_EVENT> &e) : events(e) {}
+
+    const MIDI_EVENT *data() const { return events.constData(); }
+    const MIDI_EVENT *begin() const { return events.constData(); }
+    const MIDI_EVENT *end() const { return events.constData() + events.size(); }
+    const MIDI_EVENT &operator[](int i) const { return events.at(i); }
+    int size() const { return events.size(); }
+    bool isEmpty() const { return events.isEmpty(); }
+
+private:
+    QVector<MIDI_EVENT> events;
+};
+Q_DECLARE_METATYPE(MidiEventSpan)
+
+// sysex tx pacing
+#define TX_PACE_MAX_LAG_NS 2000000 // a chunk later than this re-anchors the schedule instead of bursting to catch up
+#define TX_MAX_CHUNKS_PER_PASS 16 // chunks sent per timer pass when the rate outruns the timer resolution
+
+// adaptive chunking (opt in), see slotSetTxAdaptive
+#define TX_ADAPT_GROW_AFTER 16          // successful chunks before the chunk size and rate are raised
+#define TX_ADAPT_MAX_CHUNK_SIZE 1024    // largest adaptive chunk in bytes
+#define TX_ADAPT_MAX_RATE 256000        // fastest adaptive rate in bytes per second
+#define TX_ADAPT_MIN_RATE_DIV 8         // never slow below the product's base rate divided by this
+#define TX_ADAPT_MAX_RETRIES 5          // consecutive failed sends of one chunk before the ports are closed
+#define TX_ADAPT_BACKOFF_NS 20000000    // wait this long per retry after a failed send
+#define TX_ACK_WINDOW 4                 // chunks in flight before an ack is needed
+#define TX_ACK_TIMEOUT_NS 250000000     // no ack within this time and the device is treated as not acking
+
+// rx ring
+#define RX_RING_DRAIN_BATCH 256 // max events parsed per slotDrainRxRing call before yielding to the event loop
+
 // enumerate the states of the firmware update process, not all apply to every product
 enum
 {
@@ -73,11 +167,13 @@ enum
     BL_INSTALL_COMPLETE
 };
 
-class MidiDeviceManager : public QWidget
+// QObject based so it runs without a GUI (QCoreApplication) or moved to a worker thread.
+// The only widget it ever shows is the optional slotErrorPopup, see KMI_MDM_HEADLESS.
+class MidiDeviceManager : public QObject
 {
     Q_OBJECT
 public:
-    explicit MidiDeviceManager(QWidget *parent = nullptr, int initPID = -1, QString objectNameInit = "undefined", KMI_Ports *kmiP = NULL);
+    explicit MidiDeviceManager(QObject *parent = nullptr, int initPID = -1, QString objectNameInit = "undefined", KMI_Ports *kmiP = NULL);
 
     // from device
     static void midiInCallback ( double deltatime, std::vector< unsigned char > *message, void *userData );
@@ -103,7 +199,13 @@ public:
 
     // RtMidi devices
     RtMidiIn *midi_in;
-    RtMidiOut *midi_out;
+    RtMidiOut *midi_out;        // nullptr while txThread owns it, use midiOutCall/txSend
+
+    // optional I/O thread, see slotSetTxThread
+    KMI_MidiOutThread *txThread;
+
+    // KMI_Ports port table version, RtMidi is only consulted again when the table moves
+    quint64 portTableVersionChecked;    // table version port_in/port_out were last verified against
 
     // KMI_Ports pointer
     KMI_Ports *kmiPorts;
@@ -120,11 +222,14 @@ public:
     QByteArray deviceFirmwareVersion;
     QByteArray applicationFirmwareVersion;
 
-    QFile *firmware;
+    // firmware/bootloader images are mapped read-only and shared by reference, see KMI_fwImage.h.
+    // the byte arrays are views of the same data and are only valid while the image is held.
+    // an editor that still assigns a byte array directly gets it wrapped and validated at send time
+    KMI_FwImagePtr firmwareImage;
     QByteArray firmwareByteArray;
 
     // for bootloader trojan horse firmware, ie softstep
-    QFile *bootloader;
+    KMI_FwImagePtr bootloaderImage;
     QByteArray bootloaderByteArray;
 
     //Helper variables to process sysex
@@ -137,49 +242,123 @@ public:
 
     int firmwareUpdateState;    // state of fw update process
     int installingBootloader;   // state of bootloader install process
+    bool fwStepQueued;          // an immediate state machine step is already posted, owner thread only, see fwSetState
+    int fwResendCount;          // resends done in the current wait state
+    int fwCountdownLast;        // last "Timeout in" second reported, -1 = none yet
     QElapsedTimer firmwareUpdateStateTimer;
     int fwVerPollSkipConnectCycles; // set this count to not send fwver request for x connect cycles
     QElapsedTimer fwVerRequestTimer; // time since the last fwver request was sent
     bool firstFwVerRequestHasBeenSent; // set this high the first time we send a request, if false then don't wait for timer
 
-    QElapsedTimer syxExTxChunkTimer; // speed limit for chunk transmission
+    QElapsedTimer syxExTxChunkTimer; // monotonic clock for chunk pacing deadlines, never restarted
     unsigned int sysExTxChunkSize; // if 0 then send at once, if non-zero then break sysex into chunks this many bytes in size
     unsigned int sysExTxChunkDelay; // if 0 then send at once, if non-zero then wait this many ms between chunks
+    unsigned int sysExTxByteRate; // chunk pacing in bytes per second, if 0 then derived from sysExTxChunkSize/sysExTxChunkDelay
+    qint64 sysExTxNextChunkNs; // syxExTxChunkTimer deadline for the next chunk
+    qint64 sysExTxBurstStartNs; // when the first chunk of the current transfer was sent, -1 if idle
+    qint64 sysExTxBurstBytes; // bytes sent so far in the current transfer
+    double sysExTxAchievedRate; // bytes per second achieved by the last completed transfer
+    bool sysExTxSendLastChunk; // set when less than one chunk remains, the next pass sends it all
+
+    // adaptive chunking (opt in), see slotSetTxAdaptive
+    bool sysExTxAdaptive;               // raise the chunk size/rate while sends succeed, back off and retry when they throw
+    std::atomic<bool> sysExTxAckCredits; // the device sends a universal ack per chunk, read by sxHandleTxAck on the RtMidi thread
+    bool sysExTxAckFallback;            // no ack arrived in time, the rest of this transfer is only paced
+    unsigned int sysExTxBaseChunkSize;  // product chunk size, restored when adaptive mode is turned off
+    double sysExTxBaseRate;             // product rate the adaptive rate starts from
+    double sysExTxAdaptiveRate;         // current adaptive rate in bytes per second
+    int sysExTxAdaptSuccesses;          // chunks sent since the last adjustment
+    int sysExTxAdaptRetries;            // consecutive failed sends of the current chunk
+    std::atomic<int> sysExTxCredits;    // returned by slotProcessSysEx, which can run on the RtMidi thread
+    qint64 sysExTxCreditWaitNs;         // when we ran out of credits, -1 if not waiting
+    std::vector<uchar> sysExTxFramed; // reused when a sysex sent all at once is missing F0/F7
 
     QTimer* versionPoller;
 
-    // stops MIDI if sysex is sending
-    bool ioGate;
-
 #define MAX_MIDI_SYSEX_SIZE 150000 // this is the check when sending sysex
 #define MAX_MIDI_PACKET_SIZE 64 // this is the check when building channel/common messages
-    std::vector<uchar> packet; // packet to stuff outgoing midi packets into (not sysex)
-    QTimer midiSendTimer;
+    KMI_TxQueue packet; // outgoing sysex, sent whole or in paced chunks
+    std::vector<TX_SHORT_MESSAGE> txLane[TX_LANE_COUNT]; // short messages, sent ahead of packet, see txServiceLanes
+    size_t txLaneBytes; // bytes queued in all lanes
+    bool txSysExOpen; // the last chunk sent stopped inside a sysex message, channel messages must wait
+    std::vector<uchar> txBatchBuffer; // short messages staged for one txFlushBatch, reused
+    KMI_TxBatch txBatch; // one OS call per batch where the backend allows it, used on the midi_out thread
+    QTimer midiSendTimer; // single shot, only armed while packet has data, see scheduleTx
 
     QDialog* errDialog;
 
-    //------ Rx MIDI Parameter Address Variables
-    uchar RPN_MSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar RPN_LSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar NRPN_MSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar NRPN_LSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-
-    //------ Rx MIDI Parameter Data Variables
-    uchar RPN_DATA_MSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar RPN_DATA_LSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar NRPN_DATA_MSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-    uchar NRPN_DATA_LSB[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-
-    //----- TX MIDI Parameter Data Variables
+    // Rx ring - when enabled the RtMidi callback only copies messages into rxRing and the owning
+    // thread parses them in batches, so no member state is touched from the driver thread
+    std::atomic<bool> rxRingMode;
+    std::atomic<bool> rxRingDrainPending; // set by the callback when a drain has been queued
+    KMI_RxRing rxRing;
+
+    // Rx timestamps, stamped in the RtMidi callback from its deltatime, see KMI_rxClock.h
+    KMI_RxClock rxClock;
+    qint64 rxEventTimestampNs; // timestamp of the message being parsed, valid in directly connected rx slots
+
+    // Rx realtime fast path (opt in), see slotSetRxRealtimeFastPath and KMI_rxRealtime.h
+    std::atomic<bool> rxRealtimeFastPath;
+    std::atomic<bool> rxRealtimeEmitPending; // set by the callback when slotEmitRealtime has been queued
+    KMI_RxRealtime rxRealtime;
+    bool rxIgnoreTiming;        // RtMidi ignoreTypes, clock and MTC never reach the callback
+    bool rxIgnoreSense;
+    double rxTempoReported;     // owner thread, last signalRxTempo value
+    quint64 rxBeatReported;
+    bool rxTransportReported;
+
+    // Rx sysex reassembly, see slotSetRxSysExMaxSize and KMI_rxSysEx.h
+    KMI_RxSysExPool rxSysExPool;
+    size_t rxSysExMaxSize;      // applied to the pool when the in port opens
+
+    // counters and latency histograms, lock-free, see KMI_metrics.h and getMetrics
+    KMI_Metrics metrics;
+    QTimer *metricsTimer;       // created by slotSetMetricsInterval
+    int portOutOpens;           // successful output port opens, anything after the first is a reconnect
+
+    // rx/tx capture log, see slotStartCapture and KMI_capture.h. The writer lives as long as the
+    // manager so the RtMidi callback never sees it go away, it's idle unless recording
+    KMI_CaptureWriter *capture;
+    std::vector<unsigned char> rxRingSysExMessage; // reused when passing drained sysex to slotProcessSysEx
+
+    //------ Rx MIDI Parameter state, address and data per channel, see slotInitNRPN
+    MIDI_PARAM_STATE paramState[NUM_MIDI_CHANNELS];
+
+    //----- TX MIDI Parameter Data Variables, sending thread only so kept apart from the rx state
     uint16_t LAST_SENT_RPN[NUM_MIDI_CHANNELS];
     uint16_t LAST_SENT_NRPN[NUM_MIDI_CHANNELS];
 
-    PARAM_MODE paramMode = MODE_UNDEF;
+    //----- Rx running status, kept per manager so devices don't share it
+    uchar rxRunningStatus;
+    uchar rxRunningChan;
+
+    //----- Rx batch delivery (opt in), see slotSetRxBatchMode
+    bool rxBatchMode;           // collect decoded events and emit signalRxMidiBatch once per drain cycle, rx ring only
+    bool rxBatchCoalesce;       // only keep the latest CC/pitch bend/pressure value per channel in each batch
+    bool rxPerEventSignals;     // keep emitting signalRxMidi_raw and the typed signalRxMidi_* signals
+    QVector<MIDI_EVENT> rxBatch;
+    short rxCoalesceCC[NUM_MIDI_CHANNELS][128];     // index into rxBatch, -1 if not in this batch
+    short rxCoalescePolyAT[NUM_MIDI_CHANNELS][128];
+    short rxCoalesceBend[NUM_MIDI_CHANNELS];
+    short rxCoalescePressure[NUM_MIDI_CHANNELS];
 
 // public functions
 
     QByteArray decode8BitArray(QByteArray this8BitArray);
 
+    KMI_MetricsSnapshot getMetrics() const { return metrics.snapshot(); } // any thread
+
+    void sendNRPNBlock(uchar channel, int firstParameter, const int *values, int count); // contiguous NRPNs, one address
+
+    // zero copy, parses one channel/system message straight from the caller's (ie RtMidi's) buffer
+    void parseMessage(const unsigned char *packetBytes, size_t length, qint64 timestampNs = kmiHostTimeNs());
+
+    qint64 getRxClockOffsetNs() { return rxClock.offsetNs(); }  // host - driver timeline
+    qint64 getRxClockLagNs() { return rxClock.lastLagNs(); }    // how late the last message reached the callback
+
+    const KMI_RxRealtime &getRxRealtime() const { return rxRealtime; } // clock/sense counters and bpm, any thread
+    const KMI_RxSysExPool &getRxSysExPool() const { return rxSysExPool; } // stitched/dropped counters, any thread
+
 signals:
     // detect MIDI feedback loop
     void signalFeedbackLoopDetected(MidiDeviceManager*);
@@ -192,6 +371,7 @@ signals:
     void signalStopGlobalTimer();
     void signalBootloaderMode(bool);
     void signalConnected(bool);
+    void signalErrorMessage(QString errorMessage); // always emitted, popup or not
 
     // firmware update
     void signalFwConsoleMessage(QString message);
@@ -204,9 +384,22 @@ signals:
     // SysEx messages
     void signalRxSysExBA(QByteArray sysExMessageByteArray);
     void signalRxSysEx(std::vector< unsigned char > *message);
+    // the same message in place, no copy. Only valid during the call, connect directly
+    // (e.g. to KMI_Decode::slotDecodeBytes)
+    void signalRxSysExData(const unsigned char *bytes, size_t length);
+
+    // chunked sysex transfer finished, reports the pacing actually achieved
+    void signalTxRateReport(double bytesPerSecond, qint64 bytes, qint64 elapsedMs);
+
+    // periodic metrics, see slotSetMetricsInterval
+    void signalMetrics(const KMI_MetricsSnapshot &snapshot);
+
+    // batched rx, one emit per drain cycle when rxBatchMode is enabled
+    void signalRxMidiBatch(const MidiEventSpan &events);
 
     // channel messages
     void signalRxMidi_raw(uchar status, uchar d1, uchar d2, uchar chan);
+    void signalRxMidi_rawTimed(uchar status, uchar d1, uchar d2, uchar chan, qint64 timestampNs);
     void signalRxMidi_noteOff(uchar chan, uchar note, uchar velocity);
     void signalRxMidi_noteOn(uchar chan, uchar note, uchar velocity);
     void signalRxMidi_polyAT(uchar chan, uchar note, uchar val);
@@ -229,6 +422,11 @@ signals:
     void signalRxMidi_ActSense();
     void signalRxMidi_SysReset();
 
+    // realtime fast path, at most once per beat instead of once per tick
+    void signalRxTempo(double bpm);         // changed by RT_TEMPO_DEADBAND or more
+    void signalRxBeat(quint64 beat);        // quarter notes since start
+    void signalRxTransport(bool running);   // start/continue/stop
+
 public slots:
 
     void slotUpdatePID(int thisPID);
@@ -263,7 +461,12 @@ public slots:
     // firmware update
     bool slotOpenFirmwareFile(QString filePath);
     bool slotOpenBootloaderFile(QString filePath);
+    void slotSetFirmwareImage(KMI_FwImagePtr image);   // shared image, ie from KMI_FwOrchestrator
+    void slotSetBootloaderImage(KMI_FwImagePtr image);
     void slotRequestFirmwareUpdate();
+    void slotGlobalsReceived();     // globals backup arrived, advances the update immediately
+    void slotFwUpdateStep();        // run the firmware update state machine now
+    void slotSendBootloaderImage();
     //void slotSendFirmware();
     void slotFirmwareUpdateReset();
 
@@ -274,17 +477,83 @@ public slots:
     void slotSendMIDI(uchar status, uchar d1, uchar d2, uchar chan);
 
     void slotEmptyMIDIBuffer();
+    void slotServiceTx(); // midiSendTimer target, sends whatever is due and re-arms
+    void slotSetTxByteRate(unsigned int bytesPerSecond); // 0 = use sysExTxChunkSize/sysExTxChunkDelay
+    void slotSetTxAdaptive(bool enable, bool ackCredits = false);
+    void slotTxNak();
+    void slotSetTxThread(bool enable); // move midi_out and all sends onto a dedicated thread for this device
 
     void slotInitNRPN();
     void slotSendMIDI_NRPN(int parameter_number, int value, uchar channel);
+    void slotSendMIDI_NRPNBlock(uchar channel, int firstParameter, QVector<int> values); // values[i] goes to firstParameter + i
+
+    void slotParsePacket(QByteArray packetArray); // copies, use parseMessage from the same thread
 
-    void slotParsePacket(QByteArray packetArray);
+    void slotSetRxRingMode(bool enable);
+    void slotSetRxClockEstimator(bool enable); // track drift between the driver clock and the host
+    void slotSetRxRealtimeFastPath(bool enable); // clock/active sense skip the parser, see signalRxTempo
+    void slotSetRxRealtimeIgnore(bool clock, bool activeSense); // drop them in RtMidi instead, clock includes MTC
+    void slotSetRxSysExMaxSize(int bytes); // longest inbound sysex kept, RX_SYSEX_MAX_SIZE by default
+    void slotDrainRxRing();
 
-    void slotErrorPopup(QString errorMessage);
+    void slotSetRxBatchMode(bool enable, bool coalesce = false, bool perEventSignals = true);
+    void slotFlushRxBatch();
+
+    void slotErrorPopup(QString errorMessage); // non-modal, never blocks the caller
+
+    void slotSetMetricsInterval(int ms); // emit signalMetrics every ms, 0 = off (poll getMetrics instead)
+    void slotResetMetrics();
+
+    bool slotStartCapture(QString filePath); // log rx/tx with timestamps, replay with KMI_CaptureReplay
+    void slotStopCapture();
+
+private slots:
+    void slotTxThreadError(QString errorMessage);
+    void slotEmitMetrics();
+    void slotEmitRealtime();
+    void slotFwSetState(int state); // fwSetState posted from the RtMidi thread
 
 private:
     bool callbackIsSet;
 
+    void sendSysEx(const unsigned char *sysEx, int len, const QByteArray *sharedData);
+    void sendSysExImage(KMI_FwImagePtr image);
+    KMI_FwImagePtr fwImageFromArray(KMI_FwImagePtr image, const QByteArray &imageArray, QString *errorString);
+
+    void fwSetState(int state);
+    bool fwUpdateStep();
+    int fwStateTimeoutMs(int state);
+    qint64 fwNextDeadlineMs();
+    void handshakeKick();
+    void scheduleHandshake();
+
+    void scheduleTx();
+    void txSend(const uchar *message, size_t size);
+    void txQueueShort(int lane, const uchar *message, uchar length);
+    void txQueueNRPN(uchar channel, int parameter, int value);
+    bool txServiceLanes();
+    bool txFlushBatch();
+    void midiOutCall(std::function<void(RtMidiOut *&)> function);
+    double txByteRate() const;
+    void txReportRate();
+    void txAdaptSuccess();
+    void txAdaptBackOff(qint64 now);
+
+    // sysex handlers, one per class recognised by slotProcessSysEx
+    void sxHandleFeedbackLoop(const QByteArray &sysExMessageByteArray);
+    void sxHandleTxAck(const uchar *sysEx, int len);
+    void sxHandleFwReplySoftStep(const QByteArray &sysExMessageByteArray);
+    void sxHandleFwReply12Step(const QByteArray &sysExMessageByteArray);
+    void sxHandleIdReplyQuNeo(const QByteArray &sysExMessageByteArray, std::vector< unsigned char > *sysExMessageCharArray);
+    void sxHandleIdReply(const QByteArray &sysExMessageByteArray, std::vector< unsigned char > *sysExMessageCharArray);
+    void sxProcessFirmwareVersion();
+
+    void rxBatchAppend(uchar type, uchar chan, uchar d1, uchar d2, int param, int value);
+    void rxEmitRPN(uchar chan);
+    void rxEmitNRPN(uchar chan);
+    bool rxRealtimePath(uchar status, qint64 timestampNs);
+    void rxRealtimeNotify();
+
 };
 
 #endif // MIDIDEVICEMANAGER_H
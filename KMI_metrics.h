@@ -0,0 +1,179 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_METRICS_H
+#define KMI_METRICS_H
+
+/* KMI Metrics
+
+  Per manager counters and latency histograms, cheap enough to leave on in production.
+
+  - every counter is a relaxed atomic, written from the RtMidi callback, the manager's thread or
+    the tx thread without locks, read from anywhere
+  - KMI_Histogram is log-linear (HDR style): 8 sub-buckets per power of two, so every value is
+    kept within 12.5%, from 1 ns to ~18 minutes in 312 buckets
+  - snapshot() copies everything into a plain KMI_MetricsSnapshot for polling or signalMetrics,
+    concurrent updates may land in the next snapshot
+
+  Header only.
+
+*/
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include <QMetaType>
+#include <atomic>
+
+#define HISTOGRAM_SUB_BITS      3       // 2^3 sub-buckets per octave
+#define HISTOGRAM_SUB_BUCKETS   (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_EXPONENT  40      // values above 2^41 ns are counted in the last bucket
+#define HISTOGRAM_BUCKETS       (HISTOGRAM_SUB_BUCKETS + (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+class KMI_Histogram
+{
+public:
+    KMI_Histogram() { reset(); }
+
+    void reset()
+    {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) buckets[i].store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+    // any thread, negative values count as 0
+    void record(qint64 value)
+    {
+        quint64 v = value > 0 ? quint64(value) : 0;
+        buckets[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+
+        quint64 previous = maximum.load(std::memory_order_relaxed);
+        while (v > previous && !maximum.compare_exchange_weak(previous, v, std::memory_order_relaxed)) {}
+    }
+
+    quint64 count() const { return total.load(std::memory_order_relaxed); }
+    qint64 max() const { return qint64(maximum.load(std::memory_order_relaxed)); }
+
+    // upper bound of the bucket holding the given percentile (0-100), 0 if nothing was recorded
+    qint64 percentile(double percent) const
+    {
+        quint64 recorded = count();
+        if (recorded == 0) return 0;
+
+        quint64 target = quint64(recorded * percent / 100.0 + 0.5);
+        if (target < 1) target = 1;
+
+        quint64 seen = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= target) return qMin(bucketUpper(i), max());
+        }
+        return max();
+    }
+
+private:
+    static int bucketIndex(quint64 v)
+    {
+        if (v < HISTOGRAM_SUB_BUCKETS) return int(v);
+
+        int exponent = 63 - qCountLeadingZeroBits(v);
+        if (exponent > HISTOGRAM_MAX_EXPONENT) return HISTOGRAM_BUCKETS - 1;
+
+        int mantissa = int(v >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+        return HISTOGRAM_SUB_BUCKETS + (exponent - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS + mantissa;
+    }
+
+    static qint64 bucketUpper(int index)
+    {
+        if (index < HISTOGRAM_SUB_BUCKETS) return index;
+
+        int exponent = (index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS;
+        int mantissa = (index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+        return (qint64(HISTOGRAM_SUB_BUCKETS + mantissa + 1) << (exponent - HISTOGRAM_SUB_BITS)) - 1;
+    }
+
+    std::atomic<quint64> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<quint64> total;
+    std::atomic<quint64> maximum;
+};
+
+// plain copy of KMI_Metrics, latencies in ns
+typedef struct
+{
+    quint64 rxMessages;
+    quint64 rxBytes;
+    quint64 rxDropped;          // rx ring full, sysex over the max size or no free sysex buffer
+    quint64 txMessages;
+    quint64 txBytes;
+    quint64 sendErrors;
+    quint64 reconnects;         // output port opened again after the first time
+
+    quint64 rxLatencyCount;     // rx timestamp -> signal emitted
+    qint64 rxLatencyP50;
+    qint64 rxLatencyP99;
+    qint64 rxLatencyMax;
+
+    quint64 txLatencyCount;     // short message queued -> sendMessage
+    qint64 txLatencyP50;
+    qint64 txLatencyP99;
+    qint64 txLatencyMax;
+} KMI_MetricsSnapshot;
+Q_DECLARE_METATYPE(KMI_MetricsSnapshot)
+
+class KMI_Metrics
+{
+public:
+    KMI_Metrics() { reset(); }
+
+    void reset()
+    {
+        rxMessages.store(0, std::memory_order_relaxed);
+        rxBytes.store(0, std::memory_order_relaxed);
+        rxDropped.store(0, std::memory_order_relaxed);
+        txMessages.store(0, std::memory_order_relaxed);
+        txBytes.store(0, std::memory_order_relaxed);
+        sendErrors.store(0, std::memory_order_relaxed);
+        reconnects.store(0, std::memory_order_relaxed);
+        rxLatency.reset();
+        txLatency.reset();
+    }
+
+    static void add(std::atomic<quint64> &counter, quint64 value = 1) { counter.fetch_add(value, std::memory_order_relaxed); }
+
+    KMI_MetricsSnapshot snapshot() const
+    {
+        KMI_MetricsSnapshot s;
+        s.rxMessages = rxMessages.load(std::memory_order_relaxed);
+        s.rxBytes = rxBytes.load(std::memory_order_relaxed);
+        s.rxDropped = rxDropped.load(std::memory_order_relaxed);
+        s.txMessages = txMessages.load(std::memory_order_relaxed);
+        s.txBytes = txBytes.load(std::memory_order_relaxed);
+        s.sendErrors = sendErrors.load(std::memory_order_relaxed);
+        s.reconnects = reconnects.load(std::memory_order_relaxed);
+
+        s.rxLatencyCount = rxLatency.count();
+        s.rxLatencyP50 = rxLatency.percentile(50);
+        s.rxLatencyP99 = rxLatency.percentile(99);
+        s.rxLatencyMax = rxLatency.max();
+
+        s.txLatencyCount = txLatency.count();
+        s.txLatencyP50 = txLatency.percentile(50);
+        s.txLatencyP99 = txLatency.percentile(99);
+        s.txLatencyMax = txLatency.max();
+        return s;
+    }
+
+    std::atomic<quint64> rxMessages;
+    std::atomic<quint64> rxBytes;
+    std::atomic<quint64> rxDropped;
+    std::atomic<quint64> txMessages;
+    std::atomic<quint64> txBytes;
+    std::atomic<quint64> sendErrors;
+    std::atomic<quint64> reconnects;
+    KMI_Histogram rxLatency;
+    KMI_Histogram txLatency;
+};
+
+#endif // KMI_METRICS_H
@@ -0,0 +1,161 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI MIDI Out Thread
+
+  See KMI_midiOutThread.h for details.
+
+*/
+
+#include "KMI_midiOutThread.h"
+#include <QDebug>
+
+KMI_MidiOutThread::KMI_MidiOutThread(RtMidiOut *thisMidiOut, QObject *parent) : QThread(parent)
+{
+    midiOut = thisMidiOut;
+    sentBytes.store(0, std::memory_order_relaxed);
+    sendFailed = false;
+}
+
+KMI_MidiOutThread::~KMI_MidiOutThread()
+{
+    stop();
+    delete midiOut;
+}
+
+// ****************************
+// Public Functions
+// ****************************
+
+void KMI_MidiOutThread::send(const unsigned char *message, size_t size)
+{
+    if (size == 0) return;
+
+    Command *command = new Command();
+    command->type = TX_CMD_SEND;
+    command->bytes.assign(message, message + size);
+    command->done = nullptr;
+    queue.post(command);
+}
+
+void KMI_MidiOutThread::sendBatch(const unsigned char *messages, size_t size, KMI_TxBatch *batch, bool allowDirect)
+{
+    if (size == 0) return;
+
+    Command *command = new Command();
+    command->type = TX_CMD_BATCH;
+    command->bytes.assign(messages, messages + size);
+    command->batch = batch;
+    command->allowDirect = allowDirect;
+    command->done = nullptr;
+    queue.post(command);
+}
+
+void KMI_MidiOutThread::call(std::function<void(RtMidiOut *&)> function)
+{
+    if (!isRunning() || QThread::currentThread() == this)
+    {
+        function(midiOut); // nothing to wait for
+        return;
+    }
+
+    QSemaphore done;
+    Command command;
+    command.type = TX_CMD_CALL;
+    command.function = function;
+    command.done = &done;
+    queue.post(&command);
+    done.acquire();
+
+    if (command.error) std::rethrow_exception(command.error);
+}
+
+RtMidiOut *KMI_MidiOutThread::release()
+{
+    stop();
+    RtMidiOut *thisMidiOut = midiOut;
+    midiOut = nullptr;
+    return thisMidiOut;
+}
+
+// ****************************
+// Private Functions
+// ****************************
+
+void KMI_MidiOutThread::run()
+{
+    while (true)
+    {
+        queue.wait();
+
+        Command *command;
+        while ((command = queue.take()) != nullptr)
+        {
+            bool stopping = (command->type == TX_CMD_STOP);
+            if (!stopping) execute(command);
+
+            if (command->done) command->done->release(); // the caller owns it, don't touch it after this
+            else delete command;
+
+            bool more = queue.finish();
+            if (stopping) return; // stop() frees anything posted after it
+            if (!more) break;
+        }
+
+        emit signalIdle();
+    }
+}
+
+void KMI_MidiOutThread::execute(Command *command)
+{
+    if (command->type == TX_CMD_CALL)
+    {
+        try
+        {
+            command->function(midiOut);
+        }
+        catch (...)
+        {
+            command->error = std::current_exception(); // rethrown on the caller's thread
+        }
+        sendFailed = false; // the port was (re)opened or closed, sending makes sense again
+        return;
+    }
+
+    if (sendFailed || midiOut == nullptr) return; // the manager is closing the port
+
+    try
+    {
+        if (command->type == TX_CMD_BATCH) command->batch->send(midiOut, command->bytes.data(), command->bytes.size(), command->allowDirect);
+        else midiOut->sendMessage(command->bytes.data(), command->bytes.size());
+        sentBytes.fetch_add(command->bytes.size(), std::memory_order_relaxed);
+    }
+    catch (RtMidiError &error)
+    {
+        sendFailed = true;
+        emit signalSendError(QString("MIDI SEND ERR: %1 \n Size: %2").arg(QString::fromStdString(error.getMessage()), QString::number(command->bytes.size())));
+    }
+}
+
+void KMI_MidiOutThread::stop()
+{
+    if (isRunning())
+    {
+        QSemaphore done;
+        Command command;
+        command.type = TX_CMD_STOP;
+        command.done = &done;
+        queue.post(&command); // everything queued before it still goes out
+        done.acquire();
+        wait();
+    }
+
+    // sends posted after the stop command
+    Command *command;
+    while ((command = queue.take()) != nullptr)
+    {
+        if (command->done) command->done->release();
+        else delete command;
+        queue.finish();
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_MIDIOUTTHREAD_H
+#define KMI_MIDIOUTTHREAD_H
+
+/* KMI MIDI Out Thread
+
+  Optional per device I/O thread for MidiDeviceManager (see slotSetTxThread).
+
+  - owns the RtMidiOut client, nothing else touches it while the thread exists
+  - messages are copied into commands and handed over through a lock-free MPSC queue, so a
+    blocking sendMessage (WinMM with large sysex) only stalls this device's thread
+  - open/close and other client calls go through the same queue with call(), they run after
+    everything queued before them and RtMidiError is rethrown in the caller
+  - failed sends are reported with signalSendError, queued sends are dropped until the next call()
+  - signalIdle is emitted each time the queue runs empty, the manager paces sysex chunks on it
+
+  Both signals are emitted from this thread, connect them with the default (queued) connection.
+
+*/
+
+#include <QThread>
+#include <QSemaphore>
+#include <QString>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include "RtMidi.h"
+#include "KMI_mpscQueue.h"
+#include "KMI_txBatch.h"
+
+enum
+{
+    TX_CMD_SEND,
+    TX_CMD_BATCH,
+    TX_CMD_CALL,
+    TX_CMD_STOP
+};
+
+class KMI_MidiOutThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit KMI_MidiOutThread(RtMidiOut *midiOut, QObject *parent = nullptr); // takes ownership
+    ~KMI_MidiOutThread();
+
+    // any thread
+    void send(const unsigned char *message, size_t size);
+    void sendBatch(const unsigned char *messages, size_t size, KMI_TxBatch *batch, bool allowDirect = true); // back to back short messages
+    void call(std::function<void(RtMidiOut *&)> function); // blocks until it ran on this thread
+    int pending() const { return queue.pending(); }
+    quint64 bytesSent() const { return sentBytes.load(std::memory_order_relaxed); }
+
+    // stop the thread and hand the client back to the caller
+    RtMidiOut *release();
+
+signals:
+    void signalSendError(QString errorMessage);
+    void signalIdle();
+
+protected:
+    void run() override;
+
+private:
+    struct Command : KMI_MpscNode
+    {
+        int type;
+        std::vector<unsigned char> bytes;           // TX_CMD_SEND/TX_CMD_BATCH
+        KMI_TxBatch *batch;                         // TX_CMD_BATCH
+        bool allowDirect;                           // TX_CMD_BATCH, see KMI_TxBatch::send
+        std::function<void(RtMidiOut *&)> function; // TX_CMD_CALL
+        std::exception_ptr error;
+        QSemaphore *done;                           // set when the caller waits, and owns the command
+    };
+
+    void execute(Command *command);
+    void stop();
+
+    KMI_MpscWakeQueue<Command> queue;   // pending() counts commands not yet executed
+    std::atomic<quint64> sentBytes;
+    RtMidiOut *midiOut;
+    bool sendFailed;                    // io thread only
+};
+
+#endif // KMI_MIDIOUTTHREAD_H
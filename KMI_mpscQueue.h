@@ -0,0 +1,143 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_MPSCQUEUE_H
+#define KMI_MPSCQUEUE_H
+
+/* KMI MPSC Queue
+
+  Lock-free multi-producer/single-consumer queue of intrusive nodes (Vyukov's algorithm).
+
+  - push is one atomic exchange and one store, any number of threads can push at once
+  - pop is only called from the consumer thread and never blocks
+  - pop can return nullptr while a push is half way in even though the queue isn't empty,
+    the consumer should retry (see KMI_MidiOutThread::run)
+  - the queue never allocates, nodes are owned by whoever created them
+
+  KMI_MpscWakeQueue adds a pending count and a semaphore for a consumer thread that sleeps while
+  the queue is empty: post() wakes it on the empty -> not empty transition only.
+
+  Header only, KMI_MpscWakeQueue needs QtCore (QSemaphore).
+
+*/
+
+#include <atomic>
+#include <thread>
+#include <QSemaphore>
+
+struct KMI_MpscNode
+{
+    std::atomic<KMI_MpscNode *> mpscNext;
+};
+
+template <typename T> // T derives from KMI_MpscNode
+class KMI_MpscQueue
+{
+public:
+    KMI_MpscQueue()
+    {
+        stub.mpscNext.store(nullptr, std::memory_order_relaxed);
+        head.store(&stub, std::memory_order_relaxed);
+        tail = &stub;
+    }
+
+    // any thread
+    void push(T *node)
+    {
+        pushNode(node);
+    }
+
+    // consumer thread only
+    T *pop()
+    {
+        KMI_MpscNode *first = tail;
+        KMI_MpscNode *next = first->mpscNext.load(std::memory_order_acquire);
+
+        if (first == &stub)
+        {
+            if (next == nullptr) return nullptr; // empty
+            tail = next;
+            first = next;
+            next = next->mpscNext.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr)
+        {
+            tail = next;
+            return static_cast<T *>(first);
+        }
+
+        if (first != head.load(std::memory_order_acquire)) return nullptr; // a push is in flight
+
+        // first is the last node, park the stub behind it so it can be handed out
+        pushNode(&stub);
+        next = first->mpscNext.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail = next;
+            return static_cast<T *>(first);
+        }
+        return nullptr;
+    }
+
+private:
+    void pushNode(KMI_MpscNode *node)
+    {
+        node->mpscNext.store(nullptr, std::memory_order_relaxed);
+        KMI_MpscNode *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->mpscNext.store(node, std::memory_order_release);
+    }
+
+    std::atomic<KMI_MpscNode *> head;   // producers
+    KMI_MpscNode *tail;                 // consumer
+    KMI_MpscNode stub;
+};
+
+template <typename T> // T derives from KMI_MpscNode
+class KMI_MpscWakeQueue
+{
+public:
+    KMI_MpscWakeQueue()
+    {
+        pendingCount.store(0, std::memory_order_relaxed);
+    }
+
+    // any thread
+    void post(T *node)
+    {
+        queue.push(node);
+        if (pendingCount.fetch_add(1, std::memory_order_acq_rel) == 0) wake.release();
+    }
+
+    int pending() const { return pendingCount.load(std::memory_order_acquire); }
+
+    // consumer thread only. Sleep until something is posted, false on timeout (-1 waits forever)
+    bool wait(int timeoutMs = -1)
+    {
+        return wake.tryAcquire(1, timeoutMs);
+    }
+
+    // the next node, nullptr if nothing is pending (a token left over from a discarded post).
+    // Waits out a push that is counted but not linked in yet
+    T *take()
+    {
+        if (pending() == 0) return nullptr;
+
+        T *node;
+        while ((node = queue.pop()) == nullptr) std::this_thread::yield();
+        return node;
+    }
+
+    // call once per taken node when done with it, true if more are pending
+    bool finish()
+    {
+        return pendingCount.fetch_sub(1, std::memory_order_acq_rel) > 1;
+    }
+
+private:
+    KMI_MpscQueue<T> queue;
+    std::atomic<int> pendingCount;      // posted and not yet finished
+    QSemaphore wake;                    // one token per empty -> not empty transition
+};
+
+#endif // KMI_MPSCQUEUE_H
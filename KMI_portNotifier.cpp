@@ -0,0 +1,286 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Port Notifier
+
+  See KMI_portNotifier.h for details.
+
+  Link requirements are the same as RtMidi's: CoreMIDI/CoreFoundation on macOS, libasound on Linux.
+  Windows needs nothing extra, cfgmgr32 is loaded with QLibrary.
+
+*/
+
+#include "KMI_portNotifier.h"
+#include <QDebug>
+
+#ifdef Q_OS_MAC
+#include <CoreMIDI/CoreMIDI.h>
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+#include <QSocketNotifier>
+#include <QVector>
+#include <alsa/asoundlib.h>
+#include <poll.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <QLibrary>
+#include <windows.h>
+#include <cfgmgr32.h>
+#endif
+
+// ****************************
+// Backend callbacks
+// ****************************
+
+#ifdef Q_OS_MAC
+// called on the run loop that was current when the client was created
+static void macNotifyProc(const MIDINotification *message, void *refCon)
+{
+    if (message->messageID == kMIDIMsgSetupChanged)
+    {
+        static_cast<KMI_PortNotifier *>(refCon)->notifyFromBackend();
+    }
+}
+#endif
+
+#if defined(Q_OS_WIN) && defined(CM_NOTIFY_FILTER_FLAG_ALL_INTERFACE_CLASSES) // SDK 8+ headers
+
+// KSCATEGORY_AUDIO, USB MIDI interfaces register under it. Defined here to avoid pulling in ks.h
+static const GUID kmiKsCategoryAudio = { 0x6994AD04, 0x93EF, 0x11D0, { 0xA3, 0xCC, 0x00, 0xA0, 0xC9, 0x22, 0x31, 0x96 } };
+
+typedef CONFIGRET (WINAPI *CM_Register_Notification_t)(PCM_NOTIFY_FILTER, PVOID, PCM_NOTIFY_CALLBACK, PHCMNOTIFICATION);
+typedef CONFIGRET (WINAPI *CM_Unregister_Notification_t)(HCMNOTIFICATION);
+
+// called on a system thread pool thread
+static DWORD CALLBACK winNotifyProc(HCMNOTIFICATION, PVOID context, CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA, DWORD)
+{
+    if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL || action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL)
+    {
+        static_cast<KMI_PortNotifier *>(context)->notifyFromBackend();
+    }
+    return ERROR_SUCCESS;
+}
+#endif
+
+// ****************************
+// Constructor/Destructor
+// ****************************
+
+KMI_PortNotifier::KMI_PortNotifier(QObject *parent) : QObject(parent)
+{
+    active = false;
+
+#ifdef Q_OS_MAC
+    macClient = 0;
+#endif
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+    alsaSeq = nullptr;
+    alsaPort = -1;
+#endif
+#ifdef Q_OS_WIN
+    winNotify = nullptr;
+    winUnregister = nullptr;
+#endif
+
+    debounceTimer = new QTimer(this);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(PORT_NOTIFY_DEBOUNCE_MS);
+    connect(debounceTimer, SIGNAL(timeout()), this, SLOT(slotDebounceDone()));
+
+    active = openBackend();
+    qDebug() << "KMI_PortNotifier backend active:" << active;
+}
+
+KMI_PortNotifier::~KMI_PortNotifier()
+{
+    closeBackend();
+}
+
+// ****************************
+// Public Functions
+// ****************************
+
+void KMI_PortNotifier::notifyFromBackend()
+{
+    QMetaObject::invokeMethod(this, "slotNotify", Qt::QueuedConnection);
+}
+
+// ****************************
+// Private Slots
+// ****************************
+
+void KMI_PortNotifier::slotNotify()
+{
+    debounceTimer->start(); // restart, emit once the burst settles
+}
+
+void KMI_PortNotifier::slotDebounceDone()
+{
+    emit signalPortsChanged();
+}
+
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+void KMI_PortNotifier::slotAlsaReadable()
+{
+    if (alsaSeq == nullptr) return;
+
+    bool changed = false;
+    int ourClient = snd_seq_client_id(alsaSeq);
+    snd_seq_event_t *ev = nullptr;
+
+    // drain everything that is pending, the seq handle is non-blocking
+    while (true)
+    {
+        int result = snd_seq_event_input(alsaSeq, &ev);
+
+        if (result == -ENOSPC)
+        {
+            changed = true; // input overrun, we lost events so rescan anyway
+            continue;
+        }
+        if (result < 0 || ev == nullptr) break;
+
+        switch (ev->type)
+        {
+        case SND_SEQ_EVENT_CLIENT_START:
+        case SND_SEQ_EVENT_CLIENT_EXIT:
+        case SND_SEQ_EVENT_CLIENT_CHANGE:
+        case SND_SEQ_EVENT_PORT_START:
+        case SND_SEQ_EVENT_PORT_EXIT:
+        case SND_SEQ_EVENT_PORT_CHANGE:
+            if (ev->data.addr.client != ourClient) changed = true;
+            break;
+        default:
+            break; // subscriptions etc. don't change the port list
+        }
+    }
+
+    if (changed) slotNotify();
+}
+#endif
+
+// ****************************
+// Private Functions
+// ****************************
+
+bool KMI_PortNotifier::openBackend()
+{
+#ifdef Q_OS_MAC
+    OSStatus result = MIDIClientCreate(CFSTR("KMI Port Notifier"), macNotifyProc, this, &macClient);
+    if (result != noErr)
+    {
+        qDebug() << "KMI_PortNotifier: MIDIClientCreate failed:" << result;
+        macClient = 0;
+        return false;
+    }
+    return true;
+
+#elif defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+    if (snd_seq_open(&alsaSeq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0)
+    {
+        qDebug() << "KMI_PortNotifier: snd_seq_open failed";
+        alsaSeq = nullptr;
+        return false;
+    }
+    snd_seq_set_client_name(alsaSeq, "KMI Port Notifier");
+
+    // no SUBS_WRITE so RtMidi doesn't list it as an output, we can still subscribe it ourselves
+    alsaPort = snd_seq_create_simple_port(alsaSeq, "announce",
+                                          SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT,
+                                          SND_SEQ_PORT_TYPE_APPLICATION);
+
+    if (alsaPort < 0 || snd_seq_connect_from(alsaSeq, alsaPort, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0)
+    {
+        qDebug() << "KMI_PortNotifier: couldn't subscribe to the ALSA announce port";
+        closeBackend();
+        return false;
+    }
+
+    int fdCount = snd_seq_poll_descriptors_count(alsaSeq, POLLIN);
+    QVector<struct pollfd> fds(fdCount);
+    fdCount = snd_seq_poll_descriptors(alsaSeq, fds.data(), fdCount, POLLIN);
+
+    for (int i = 0; i < fdCount; i++)
+    {
+        QSocketNotifier *notifier = new QSocketNotifier(fds[i].fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &KMI_PortNotifier::slotAlsaReadable); // signature differs Qt5/6
+        alsaNotifiers.append(notifier);
+    }
+    return fdCount > 0;
+
+#elif defined(Q_OS_WIN) && defined(CM_NOTIFY_FILTER_FLAG_ALL_INTERFACE_CLASSES)
+    // Windows 8+, on 7 the symbol doesn't exist and we stay on polling
+    CM_Register_Notification_t cmRegister =
+            (CM_Register_Notification_t)QLibrary::resolve("cfgmgr32", "CM_Register_Notification");
+    winUnregister = (void *)QLibrary::resolve("cfgmgr32", "CM_Unregister_Notification");
+
+    if (cmRegister == nullptr || winUnregister == nullptr)
+    {
+        qDebug() << "KMI_PortNotifier: CM_Register_Notification not available, polling";
+        winUnregister = nullptr;
+        return false;
+    }
+
+    CM_NOTIFY_FILTER filter;
+    ZeroMemory(&filter, sizeof(filter));
+    filter.cbSize = sizeof(filter);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = kmiKsCategoryAudio;
+
+    HCMNOTIFICATION handle = nullptr;
+    CONFIGRET result = cmRegister(&filter, this, winNotifyProc, &handle);
+    if (result != CR_SUCCESS)
+    {
+        qDebug() << "KMI_PortNotifier: CM_Register_Notification failed:" << result;
+        winUnregister = nullptr;
+        return false;
+    }
+    winNotify = handle;
+
+    // interface arrival comes before WinMM has enumerated the ports, give it time to settle
+    debounceTimer->setInterval(PORT_NOTIFY_DEBOUNCE_MS * 5);
+    return true;
+
+#else
+    return false; // no backend for this platform, KMI_Ports polls
+#endif
+}
+
+void KMI_PortNotifier::closeBackend()
+{
+    active = false;
+    debounceTimer->stop();
+
+#ifdef Q_OS_MAC
+    if (macClient)
+    {
+        MIDIClientDispose(macClient);
+        macClient = 0;
+    }
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+    qDeleteAll(alsaNotifiers);
+    alsaNotifiers.clear();
+
+    if (alsaSeq)
+    {
+        if (alsaPort >= 0) snd_seq_delete_simple_port(alsaSeq, alsaPort);
+        snd_seq_close(alsaSeq);
+        alsaSeq = nullptr;
+        alsaPort = -1;
+    }
+#endif
+
+#if defined(Q_OS_WIN) && defined(CM_NOTIFY_FILTER_FLAG_ALL_INTERFACE_CLASSES)
+    // waits for any callback in flight, so the context pointer is safe to drop afterwards
+    if (winNotify && winUnregister)
+    {
+        ((CM_Unregister_Notification_t)winUnregister)((HCMNOTIFICATION)winNotify);
+    }
+    winNotify = nullptr;
+    winUnregister = nullptr;
+#endif
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_PORTNOTIFIER_H
+#define KMI_PORTNOTIFIER_H
+
+/* KMI Port Notifier
+
+  Listens for OS level MIDI setup changes so KMI_Ports doesn't have to recreate RtMidi to find them.
+
+  - macOS: CoreMIDI client with a MIDINotifyProc (kMIDIMsgSetupChanged)
+  - Linux: ALSA sequencer client subscribed to the system announce port
+  - Windows: CM_Register_Notification on the audio/MIDI device interface class, resolved from
+    cfgmgr32.dll at runtime so Windows 7 still loads (it falls back to polling there)
+
+  Notifications arrive in bursts (a device, then each of its ports) and on whatever thread the
+  backend uses, so they are funneled into a queued, debounced signalPortsChanged() on the
+  object's thread. If no backend could be opened isActive() returns false and KMI_Ports keeps polling.
+
+*/
+
+#include <QObject>
+#include <QTimer>
+
+#define PORT_NOTIFY_DEBOUNCE_MS     50      // collapse a hot-plug burst into one rescan
+
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+class QSocketNotifier;
+typedef struct _snd_seq snd_seq_t;
+#endif
+
+class KMI_PortNotifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KMI_PortNotifier(QObject *parent = nullptr);
+    ~KMI_PortNotifier();
+
+    bool isActive() { return active; }   // true if an OS notification backend is running
+
+    // posted from backend callbacks, safe to call from any thread
+    void notifyFromBackend();
+
+signals:
+    void signalPortsChanged();      // debounced, emitted on the notifier's thread
+
+private slots:
+    void slotNotify();              // restarts the debounce timer
+    void slotDebounceDone();
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+    void slotAlsaReadable();
+#endif
+
+private:
+    bool active;
+    QTimer *debounceTimer;
+
+    bool openBackend();
+    void closeBackend();
+
+#ifdef Q_OS_MAC
+    unsigned int macClient;         // MIDIClientRef
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__LINUX_ALSA__)
+    snd_seq_t *alsaSeq;
+    int alsaPort;
+    QList<QSocketNotifier*> alsaNotifiers;
+#endif
+
+#ifdef Q_OS_WIN
+    void *winNotify;                // HCMNOTIFICATION
+    void *winUnregister;            // CM_Unregister_Notification, resolved at runtime
+#endif
+};
+
+#endif // KMI_PORTNOTIFIER_H
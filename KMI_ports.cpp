@@ -17,13 +17,14 @@
 
 #include "KMI_ports.h"
 #include "KMI_DevData.h"
+#include <algorithm>
 
 #define qsFromStd QString::fromStdString
 
 int lastMIDIIN_QuNexus = 0; // for portNameFix on Windows
 int lastMIDIOUT_QuNexus = 0;
 
-KMI_Ports::KMI_Ports(QWidget *Parent)
+KMI_Ports::KMI_Ports(QObject *Parent)
 {
     qDebug() << "KMI_Ports instance created";
 
@@ -46,6 +47,16 @@ KMI_Ports::KMI_Ports(QWidget *Parent)
     connect(devicePoller, SIGNAL(timeout()), this, SLOT(slotPollDevices()));
     //devicePoller->start(1);
 
+    // OS hot-plug notifications, when these are available slotPollDevices only runs a slow safety scan
+    portNotifier = new KMI_PortNotifier(this);
+    connect(portNotifier, SIGNAL(signalPortsChanged()), this, SLOT(slotPortsChanged()));
+    fallbackPollTimer.start();
+    rescanPending = false;
+
+    lastInputHash = lastOutputHash = 0;
+    portSnapshotValid = false;
+    portTableVersion = 0; // no table until the first enumeration
+
     // debug enum translations
     inOut <<
             "IN" <<
@@ -67,6 +78,16 @@ void KMI_Ports::slotPollDevices()
 //    int newInputCount = 0;
 //    int newOutputCount = 0;
 
+    if (portNotifier->isActive())
+    {
+        // the backend tells us about changes, only rescan occasionally in case an event was missed.
+        // RtMidi enumerates live on every backend we have a notifier for, so no need to recreate it
+        if (!rescanPending && fallbackPollTimer.elapsed() < PORT_FALLBACK_POLL_MS) return;
+
+        slotPortsChanged();
+        return;
+    }
+
     //qDebug() << "slotPollDevices called - delete/recreate active RtMidi instances";
 
     if (numInputs) // don't re-initialize RtMidi if there are no inputs
@@ -115,6 +136,25 @@ void KMI_Ports::slotPollDevices()
     //}
 }
 
+// Notifier path, the port list is rescanned without tearing down the RtMidi clients
+void KMI_Ports::slotPortsChanged()
+{
+    fallbackPollTimer.restart();
+    rescanPending = false;
+
+    try
+    {
+        if (checkPortsForChanges())
+        {
+            listMaps();
+        }
+    }
+    catch (RtMidiError &error)
+    {
+        qDebug() << "slotPortsChanged RtMidi error:" << (QString::fromStdString(error.getMessage()));
+    }
+}
+
 // force a refresh by clearing the port metadata
 void KMI_Ports::slotRefreshPortMaps()
 {
@@ -123,6 +163,8 @@ void KMI_Ports::slotRefreshPortMaps()
     numOutputs = 0;
     midiInputPorts.clear();
     midiOutputPorts.clear();
+    rescanPending = true; // next devicePoller tick reports everything as new
+    portSnapshotValid = false; // maps no longer match the last hash
 
     qDebug() << "************ all ports disconnected, listing ports **************";
     listMaps();
@@ -132,9 +174,9 @@ void KMI_Ports::slotRefreshPortMaps()
 // Public Functions (not slots)
 // ****************************
 
-// Function that polls system MIDI devices looking for changes. Windows
-// does not report changes automatically, so we must ping constantly to detect them. We can use
-// this for MacOS as well to have consistent behavior and streamlined development.
+// Function that polls system MIDI devices looking for changes. Called from slotPortsChanged when
+// KMI_PortNotifier reports an OS setup change, or from slotPollDevices when no notifier backend is
+// available (Windows 7, non-ALSA Linux) and we must ping constantly to detect them.
 //
 // We need to scan inputs and outputs at the same time and first report deletions, then additions, then changes
 int KMI_Ports::checkPortsForChanges() // returns the number of changed ports (additions, subtractions, port renumbers)
@@ -143,223 +185,171 @@ int KMI_Ports::checkPortsForChanges() // returns the number of changed ports (ad
 
     //if (IN_PORT_MGR == nullptr || OUT_PORT_MGR == nullptr) return 0; // safety check
 
-    //qDebug() << "++ pollPorts called - inOrOut: " << inOut[inOrOut] << "\n";
+    QVector<KMI_PortEntry> newInputs, newOutputs;
+    quint64 newInputHash = loadPortSnapshot(PORT_IN, newInputs);
+    quint64 newOutputHash = loadPortSnapshot(PORT_OUT, newOutputs);
 
-    // update map pointer
-    QMap<QString, int> *globalInputPortMap = &midiInputPorts;
-    QMap<QString, int> *globalOutputPortMap = &midiOutputPorts;
+    // managers only look at RtMidi again when this version moves
+    std::shared_ptr<const KMI_PortTable> current = getPortTable();
+    if (!current || current->inputHash != newInputHash || current->outputHash != newOutputHash)
+    {
+        publishPortTable(newInputHash, newOutputHash, newInputs, newOutputs);
+    }
 
-    QMap<QString, int> newInputPortMap;
-    QMap<QString, int> newOutputPortMap;
+    // nothing moved since the last enumeration, skip the sort and diff
+    if (portSnapshotValid && newInputHash == lastInputHash && newOutputHash == lastOutputHash)
+    {
+        return 0;
+    }
 
-    newInputPortMap.clear(); // ensure the map is empty
-    newOutputPortMap.clear(); // ensure the map is empty
+    QVector<KMI_PortEntry> inRemoved, inAdded, inChanged;
+    QVector<KMI_PortEntry> outRemoved, outAdded, outChanged;
 
-    unsigned int numInPorts = IN_PORT_MGR->getPortCount();
-    unsigned int numOutPorts = OUT_PORT_MGR->getPortCount();
+    diffPortSnapshot(midiInputPorts, newInputs, inRemoved, inAdded, inChanged);
+    diffPortSnapshot(midiOutputPorts, newOutputs, outRemoved, outAdded, outChanged);
 
-    //qDebug() << "Load newInputPortMap";
-    // load newInputPortMap with the current RtMidi port list
-    for (uint thisPort = 0; thisPort < (numInPorts); thisPort++)
-    {
-        QString newPortName = getInPortName(thisPort);
+    lastInputHash = newInputHash;
+    lastOutputHash = newOutputHash;
+    portSnapshotValid = true;
 
-        if (newPortName != "None" && newPortName != "")
-        {
-            newInputPortMap.insert(newPortName, thisPort); // add this to our new map
-        }
-    }
+    // the maps are already up to date, report deletions, then additions, then changes
+    for (const KMI_PortEntry &e : inRemoved) emit signalPortUpdated(e.name, PORT_IN, PORT_DISCONNECT, e.port);
+    for (const KMI_PortEntry &e : outRemoved) emit signalPortUpdated(e.name, PORT_OUT, PORT_DISCONNECT, e.port);
+    for (const KMI_PortEntry &e : inAdded) emit signalPortUpdated(e.name, PORT_IN, PORT_CONNECT, e.port);
+    for (const KMI_PortEntry &e : outAdded) emit signalPortUpdated(e.name, PORT_OUT, PORT_CONNECT, e.port);
+    for (const KMI_PortEntry &e : inChanged) emit signalPortUpdated(e.name, PORT_IN, PORT_CHANGED, e.port);
+    for (const KMI_PortEntry &e : outChanged) emit signalPortUpdated(e.name, PORT_OUT, PORT_CHANGED, e.port);
 
-    //qDebug() << "Load newOutputPortMap";
-    // load newOutputPortMap with the current RtMidi port list
-    for (uint thisPort = 0; thisPort < (numOutPorts); thisPort++)
-    {
-        QString newPortName = getOutPortName(thisPort);
+    returnValue = inRemoved.size() + outRemoved.size() + inAdded.size() + outAdded.size() + inChanged.size() + outChanged.size();
+    return returnValue;
+}
 
-        if (newPortName != "None" && newPortName != "")
-        {
-            newOutputPortMap.insert(newPortName, thisPort); // add this to our new map
-        }
-    }
+// Enumerate one direction into a list sorted by name, returns a hash of the raw enumeration.
+// The hash covers name and index of every port, so any add/remove/rename/renumber changes it.
+quint64 KMI_Ports::loadPortSnapshot(uchar inOrOut, QVector<KMI_PortEntry> &snapshot)
+{
+    quint64 hash = 0xcbf29ce484222325ULL; // FNV-1a 64
+    unsigned int numPorts = (inOrOut == PORT_IN) ? IN_PORT_MGR->getPortCount() : OUT_PORT_MGR->getPortCount();
 
-    // *************************************************************************************************************
-    // DELETE INPUTS - compare globalInputPortMap to newInputPortMap and delete ports that have been disconnected
-    // *************************************************************************************************************
-    //qDebug() << "Delete missing inputs";
-    QMap<QString, int>::iterator i = globalInputPortMap->begin();
-    while (i != globalInputPortMap->end())
-    {
-        // get the key/value pair
-        QString globalInputPortMapName = i.key();
-        int globalMapPort = i.value();
+    snapshot.clear();
+    snapshot.reserve(numPorts);
 
-        // check if this port has been deleted
-        if (!newInputPortMap.contains(globalInputPortMapName))
-        {
-            //qDebug() << "****** Input Port delete " << globalInputPortMapName << "\n";
-            // tell main app to disconnect port
-            emit signalPortUpdated(globalInputPortMapName, PORT_IN, PORT_DISCONNECT, globalMapPort);
+    for (uint thisPort = 0; thisPort < numPorts; thisPort++)
+    {
+        QString newPortName = (inOrOut == PORT_IN) ? getInPortName(thisPort) : getOutPortName(thisPort);
 
-            // update our global port map
-            i = globalInputPortMap->erase(i); // erases this entry
+        if (newPortName == "None" || newPortName == "") continue;
 
-            returnValue++; // increase changed port count to return;
-        }
-        else
+        const ushort *c = newPortName.utf16();
+        for (int n = 0; n < newPortName.length(); n++)
         {
-            i++;
+            hash = (hash ^ c[n]) * 0x100000001b3ULL;
         }
+        hash = (hash ^ (0x10000 | thisPort)) * 0x100000001b3ULL; // index, also separates names
+
+        KMI_PortEntry entry;
+        entry.name = newPortName;
+        entry.port = thisPort;
+        snapshot.append(entry);
     }
 
-    // *************************************************************************************************************
-    // DELETE OUTPUTS - compare globalOutputPortMap to newOutputPortMap and delete ports that have been disconnected
-    // *************************************************************************************************************
-    //qDebug() << "Delete missing outputs";
-    i = globalOutputPortMap->begin();
-    while (i != globalOutputPortMap->end())
-    {
-        // get the key/value pair
-        QString globalOutputPortMapName = i.key();
-        int globalMapPort = i.value();
+    // stable so duplicate names keep enumeration order, the last one wins below like QMap::insert did
+    std::stable_sort(snapshot.begin(), snapshot.end(),
+                     [](const KMI_PortEntry &a, const KMI_PortEntry &b) { return a.name < b.name; });
 
-        // check if this port has been deleted
-        if (!newOutputPortMap.contains(globalOutputPortMapName))
+    int out = 0;
+    for (int n = 0; n < snapshot.size(); n++)
+    {
+        if (out && snapshot[out - 1].name == snapshot[n].name)
         {
-            //qDebug() << "****** Output Port delete " << globalOutputPortMapName << "\n";
-            // tell main app to disconnect port
-            emit signalPortUpdated(globalOutputPortMapName, PORT_OUT, PORT_DISCONNECT, globalMapPort);
-
-            // update our global port map
-            i = globalOutputPortMap->erase(i); // erases this entry
-
-            returnValue++; // increase changed port count to return;
+            snapshot[out - 1].port = snapshot[n].port;
         }
         else
         {
-            i++;
+            snapshot[out++] = snapshot[n];
         }
     }
+    snapshot.resize(out);
 
-    // *************************************************************************************************************
-    // FIND INPUTS - Search newInputPortMap and find new ports that aren't in globalInputPortMap and add/connect them
-    // *************************************************************************************************************
-    //qDebug() << "Find new inputs";
-    i = newInputPortMap.begin();
-    while (i != newInputPortMap.end())
-    {
-        // get the key/value pair
-        QString newInputPortMapName = i.key();
-        int newMapPort = i.value();
+    return hash;
+}
 
-        // check if this port is new
-        if (!globalInputPortMap->contains(newInputPortMapName))
-        {
-            //qDebug() << "****** Input Port add " << newInputPortMapName << "\n";
-            // alert main app
-            emit signalPortUpdated(newInputPortMapName, PORT_IN, PORT_CONNECT, newMapPort);
+// Single merge pass of the (sorted) previous map against the sorted new snapshot. Fills the
+// event lists and rebuilds portMap. Names that survive keep the previous QString so the map
+// keys stay shared between enumerations instead of holding a fresh copy each poll.
+void KMI_Ports::diffPortSnapshot(QMap<QString, int> &portMap, const QVector<KMI_PortEntry> &snapshot,
+                                 QVector<KMI_PortEntry> &removed, QVector<KMI_PortEntry> &added,
+                                 QVector<KMI_PortEntry> &changed)
+{
+    QMap<QString, int> newMap;
+    QMap<QString, int>::const_iterator old = portMap.cbegin();
+    int n = 0;
 
-            // update the global i/o map
-            globalInputPortMap->insert(newInputPortMapName, newMapPort); // increments i
+    while (old != portMap.cend() || n < snapshot.size())
+    {
+        KMI_PortEntry entry;
 
-            returnValue++; // increase changed port count to return;
-        }
-        else
+        if (n >= snapshot.size() || (old != portMap.cend() && old.key() < snapshot[n].name))
         {
-            i++;
+            // in the old map only, disconnected
+            entry.name = old.key();
+            entry.port = old.value();
+            removed.append(entry);
+            ++old;
         }
-    }
-
-    // *************************************************************************************************************
-    // FIND OUTPUTS - Search newOutputPortMap and find new ports that aren't in globalOutputPortMap and add/connect them
-    // *************************************************************************************************************
-    //qDebug() << "Find new outputs";
-    i = newOutputPortMap.begin();
-    while (i != newOutputPortMap.end())
-    {
-        // get the key/value pair
-        QString newOutputPortMapName = i.key();
-        int newMapPort = i.value();
-
-        // check if this port is new
-        if (!globalOutputPortMap->contains(newOutputPortMapName))
+        else if (old == portMap.cend() || snapshot[n].name < old.key())
         {
-            //qDebug() << "****** Output Port add " << newOutputPortMapName << "\n";
-
-            // alert main app
-            emit signalPortUpdated(newOutputPortMapName, PORT_OUT, PORT_CONNECT, newMapPort);
-
-            // update the global i/o map
-            globalOutputPortMap->insert(newOutputPortMapName, newMapPort);  // increments i
-
-            returnValue++; // increase changed port count to return;
+            // in the new snapshot only, connected
+            entry = snapshot[n++];
+            added.append(entry);
+            newMap.insert(newMap.cend(), entry.name, entry.port);
         }
         else
         {
-            i++;
+            // in both, check for a renumber
+            entry.name = old.key();
+            entry.port = snapshot[n++].port;
+            if (entry.port != old.value()) changed.append(entry);
+            newMap.insert(newMap.cend(), entry.name, entry.port);
+            ++old;
         }
     }
 
-    // *************************************************************************************************************
-    // FIND CHANGED INPUTS - Compare globalInputPortMap to newInputPortMap and find changed port numbers
-    // *************************************************************************************************************
-    //qDebug() << "Find changed inputs";
-    i = globalInputPortMap->begin();
-    while (i != globalInputPortMap->end())
-    {
-        // get the old key/value pair
-        QString globalInputPortMapName = i.key();
-        int globalMapPort = i.value();
-
-        // get the new port number
-        int updatedPort = newInputPortMap.value(globalInputPortMapName);
-
-        // check if the port # has changed
-        if (updatedPort != globalMapPort)
-        {
-            // update our portmap
-            globalInputPortMap->insert(globalInputPortMapName, updatedPort);
-
-            // tell main app to update port
-            emit signalPortUpdated(globalInputPortMapName, PORT_IN, PORT_CHANGED, updatedPort);
-
-            returnValue++; // increase changed port count to return;
-        }
-        i++; // increment
-
-    }
+    portMap.swap(newMap);
+}
 
-    // *************************************************************************************************************
-    // FIND CHANGED OUTPUTS - Compare globalOutputPortMap to newOutputPortMap and find changed port numbers
-    // *************************************************************************************************************
-    //qDebug() << "Find changed outputs";
-    i = globalOutputPortMap->begin();
-    while (i != globalOutputPortMap->end())
-    {
-        // get the key/value pair
-        QString globalOutputPortMapName = i.key();
-        int globalMapPort = i.value();
+void KMI_Ports::publishPortTable(quint64 inputHash, quint64 outputHash,
+                                 const QVector<KMI_PortEntry> &inputs, const QVector<KMI_PortEntry> &outputs)
+{
+    std::shared_ptr<KMI_PortTable> table = std::make_shared<KMI_PortTable>();
 
-        // get the new port number
-        int updatedPort = newOutputPortMap.value(globalOutputPortMapName);
+    table->version = portTableVersion.load(std::memory_order_relaxed) + 1;
+    table->inputHash = inputHash;
+    table->outputHash = outputHash;
+    table->inputs = inputs;     // implicitly shared, no deep copy
+    table->outputs = outputs;
 
-        // check if the port # has changed
-        if (updatedPort != globalMapPort)
-        {
-            // update our portmap
-            globalOutputPortMap->insert(globalOutputPortMapName, updatedPort);
+    std::atomic_store(&portTable, std::shared_ptr<const KMI_PortTable>(table));
+    portTableVersion.store(table->version, std::memory_order_release);
+}
 
-            // tell main app to update port
-            emit signalPortUpdated(globalOutputPortMapName, PORT_OUT, PORT_CHANGED, updatedPort);
+// binary search a sorted table list by name
+int KMI_Ports::findPort(const QVector<KMI_PortEntry> &ports, const QString &portName)
+{
+    QVector<KMI_PortEntry>::const_iterator it = std::lower_bound(ports.cbegin(), ports.cend(), portName,
+                                    [](const KMI_PortEntry &e, const QString &name) { return e.name < name; });
 
-            returnValue++; // increase changed port count to return;
-        }
-        i++; // increment
-    }
-    return returnValue;
+    if (it == ports.cend() || it->name != portName) return -1;
+    return it->port;
 }
 
+// The lookups below answer from the shared table once there is one, so they cost a binary search
+// instead of an RtMidi enumeration. Before the first poll they fall back to asking RtMidi.
 int KMI_Ports::getInPortNumber (QString thisPortName)
 {
+    std::shared_ptr<const KMI_PortTable> table = getPortTable();
+    if (table) return findPort(table->inputs, thisPortName);
+
     if (IN_PORT_MGR == nullptr || OUT_PORT_MGR == nullptr) return -1; // safety check
 
     //qDebug() << "getInPortNumber called: " << thisPortName;
@@ -376,6 +366,9 @@ int KMI_Ports::getInPortNumber (QString thisPortName)
 
 int KMI_Ports::getOutPortNumber (QString thisPortName)
 {
+    std::shared_ptr<const KMI_PortTable> table = getPortTable();
+    if (table) return findPort(table->outputs, thisPortName);
+
     if (IN_PORT_MGR == nullptr || OUT_PORT_MGR == nullptr) return -1; // safety check
 
     //qDebug() << "getOutPortNumber called: " << thisPortName;
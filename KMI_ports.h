@@ -15,8 +15,15 @@
 */
 
 #include "RtMidi.h"
-#include <QtWidgets>
+#include "KMI_portNotifier.h"
+#include <QtCore>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+// With an OS notifier running, devicePoller ticks only rescan this often as a safety net
+#define PORT_FALLBACK_POLL_MS   5000
 
 enum
 {
@@ -31,21 +38,39 @@ enum
     PORT_OUT,
 };
 
+// one enumerated port, snapshots are kept sorted by name
+typedef struct
+{
+    QString name;
+    int port;
+} KMI_PortEntry;
+
+// Immutable snapshot of the OS port list, published by KMI_Ports each time the enumeration changes.
+// Readers take a reference with getPortTable() and keep it as long as they like, a new table is
+// swapped in rather than modified, so no locking is needed.
+typedef struct
+{
+    quint64 version;                    // increments with every publish, 0 = nothing enumerated yet
+    quint64 inputHash, outputHash;      // enumeration hashes this table was built from
+    QVector<KMI_PortEntry> inputs;      // sorted by name, one entry per name
+    QVector<KMI_PortEntry> outputs;
+} KMI_PortTable;
+
 extern int lastMIDIIN_QuNexus, lastMIDIOUT_QuNexus;
 
 QString portNameFix(QString); // strip port number from end of RtMidi windows port names
 
-class KMI_Ports : public QWidget
+class KMI_Ports : public QObject
 {
     Q_OBJECT
 
 public:
 
-    QWidget *thisParent;
+    QObject *thisParent;
     QStringList inOut;
     QStringList mType;
 
-    explicit KMI_Ports(QWidget *parent = nullptr);
+    explicit KMI_Ports(QObject *parent = nullptr);
 
     // public variables
     int numInputs, numOutputs;
@@ -69,6 +94,15 @@ public:
     //------------------- Polling
     QTimer* devicePoller;
 
+    //------------------- Hot-plug notifications
+    KMI_PortNotifier *portNotifier;     // OS port change events, polling is the fallback
+    QElapsedTimer fallbackPollTimer;    // time since the last full rescan
+    bool rescanPending;                 // slotRefreshPortMaps cleared the maps, rescan on the next poll
+
+    // hash of the last enumeration, checkPortsForChanges returns early while it's unchanged
+    quint64 lastInputHash, lastOutputHash;
+    bool portSnapshotValid;             // false until the maps match a hashed enumeration
+
     // pubic functions
     int getInPortNumber(QString);
     int getOutPortNumber(QString);
@@ -77,6 +111,23 @@ public:
     int checkPortsForChanges();          // checks for MIDI i/o changes
     void listMaps();
 
+    // shared port table, see KMI_PortTable
+    std::shared_ptr<const KMI_PortTable> getPortTable() const { return std::atomic_load(&portTable); }
+    quint64 getPortTableVersion() const { return portTableVersion.load(std::memory_order_acquire); }
+    static int findPort(const QVector<KMI_PortEntry> &ports, const QString &portName); // -1 if missing
+
+    quint64 loadPortSnapshot(uchar inOrOut, QVector<KMI_PortEntry> &snapshot);
+    void diffPortSnapshot(QMap<QString, int> &portMap, const QVector<KMI_PortEntry> &snapshot,
+                          QVector<KMI_PortEntry> &removed, QVector<KMI_PortEntry> &added,
+                          QVector<KMI_PortEntry> &changed);
+
+private:
+    std::shared_ptr<const KMI_PortTable> portTable;     // only swapped with std::atomic_store
+    std::atomic<quint64> portTableVersion;
+
+    void publishPortTable(quint64 inputHash, quint64 outputHash,
+                          const QVector<KMI_PortEntry> &inputs, const QVector<KMI_PortEntry> &outputs);
+
 signals:
 
     // portUpdated is emitted anytime the system MIDI ports change.
@@ -94,6 +145,7 @@ public slots:
 
     void slotPollDevices();         // call pollPorts for input/output
     void slotRefreshPortMaps();         // force refresh
+    void slotPortsChanged();            // OS reported a MIDI setup change, rescan now
 
 #ifndef Q_OS_WIN
     void slotCreateVirtualIn(QString portName);
@@ -0,0 +1,126 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_RXCLOCK_H
+#define KMI_RXCLOCK_H
+
+/* KMI Rx Clock
+
+  Turns RtMidi's per message deltatime into monotonic host timestamps, in the RtMidi callback,
+  before any event loop queuing.
+
+  - kmiHostTimeNs() is one process wide QElapsedTimer, so timestamps from different devices compare
+  - the deltas are accumulated into a driver timeline (deviceNs) and mapped to host time with an
+    offset, host = deviceNs + offset
+  - the offset is anchored on the first message and only ever lowered, an event is never stamped
+    later than it was seen
+  - timestamps never go backwards
+  - the optional estimator tracks the offset as the minimum of (arrival - deviceNs) over the last
+    two windows, which follows drift between the driver clock and the host in both directions
+    and filters out scheduling delays in the callback
+
+  stamp() is only called from the RtMidi callback, the accessors can be read from any thread.
+
+*/
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+#include <atomic>
+#include <cmath>
+
+#define RX_CLOCK_WINDOW_NS 2000000000LL // estimator window, the offset follows drift at this granularity
+
+inline qint64 kmiHostTimeNs()
+{
+    static QElapsedTimer *hostClock = []()
+    {
+        QElapsedTimer *clock = new QElapsedTimer();
+        clock->start();
+        return clock;
+    }();
+    return hostClock->nsecsElapsed();
+}
+
+class KMI_RxClock
+{
+public:
+    KMI_RxClock()
+    {
+        estimator = false;
+        reset();
+    }
+
+    // next message starts a new timeline, ie after the input port was (re)opened
+    void reset()
+    {
+        anchored = false;
+        deviceNs = 0;
+        offset = 0;
+        windowStartNs = 0;
+        windowMin = previousWindowMin = 0;
+        lastTimestampNs = 0;
+        publishedOffset.store(0, std::memory_order_relaxed);
+        publishedLag.store(0, std::memory_order_relaxed);
+    }
+
+    void setEstimator(bool enable) { estimator.store(enable, std::memory_order_relaxed); } // any thread
+
+    // callback thread
+    qint64 stamp(double deltatime, qint64 arrivalNs)
+    {
+        if (deltatime > 0) deviceNs += (qint64)std::llround(deltatime * 1e9);
+
+        qint64 raw = arrivalNs - deviceNs; // >= the real offset, arrival is never early
+
+        if (!anchored)
+        {
+            anchored = true;
+            offset = raw;
+            windowStartNs = arrivalNs;
+            windowMin = previousWindowMin = raw;
+        }
+        else if (estimator.load(std::memory_order_relaxed))
+        {
+            if (arrivalNs - windowStartNs >= RX_CLOCK_WINDOW_NS)
+            {
+                previousWindowMin = windowMin;
+                windowMin = raw;
+                windowStartNs = arrivalNs;
+            }
+            else if (raw < windowMin)
+            {
+                windowMin = raw;
+            }
+            offset = qMin(windowMin, previousWindowMin);
+        }
+        else if (raw < offset)
+        {
+            offset = raw; // the driver clock runs slow, don't stamp events in the future
+        }
+
+        qint64 timestampNs = deviceNs + offset;
+        if (timestampNs < lastTimestampNs) timestampNs = lastTimestampNs; // the offset dropped, stay monotonic
+        lastTimestampNs = timestampNs;
+        publishedOffset.store(offset, std::memory_order_relaxed);
+        publishedLag.store(arrivalNs - timestampNs, std::memory_order_relaxed);
+        return timestampNs;
+    }
+
+    // any thread
+    qint64 offsetNs() const { return publishedOffset.load(std::memory_order_relaxed); }   // host - driver timeline
+    qint64 lastLagNs() const { return publishedLag.load(std::memory_order_relaxed); }     // arrival - timestamp of the last event
+
+private:
+    std::atomic<bool> estimator;
+    bool anchored;
+    qint64 deviceNs;
+    qint64 offset;
+    qint64 windowStartNs;
+    qint64 windowMin;
+    qint64 previousWindowMin;
+    qint64 lastTimestampNs;
+    std::atomic<qint64> publishedOffset;
+    std::atomic<qint64> publishedLag;
+};
+
+#endif // KMI_RXCLOCK_H
@@ -0,0 +1,117 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_RXREALTIME_H
+#define KMI_RXREALTIME_H
+
+/* KMI Rx Realtime
+
+  Clock and active sense bookkeeping for the realtime fast path (see
+  MidiDeviceManager::slotSetRxRealtimeFastPath).
+
+  - clock() is called from the RtMidi callback for every 0xF8, no allocation and no locks
+  - the tick interval is smoothed (1/8 EMA) on the KMI_RxClock timestamps, which already have
+    the callback's scheduling jitter removed, and turned into BPM at 24 ppqn
+  - a tick more than RT_TEMPO_RESYNC times off the smoothed interval restarts the average, so a
+    tempo jump settles within a beat instead of drifting over several
+  - clock() returns true on each beat (every 24th tick since start/continue, or since the first
+    tick seen), the caller hands the throttled signals to its own thread then
+  - start/continue/stop keep the transport state and the beat position
+
+  Counters and the tempo can be read from any thread.
+
+*/
+
+#include <QtGlobal>
+#include <atomic>
+
+#define RT_PPQN             24      // MIDI clock ticks per quarter note
+#define RT_TEMPO_RESYNC     2.0     // interval ratio that restarts the average
+#define RT_TEMPO_DEADBAND   0.5     // bpm change reported as a tempo change
+
+class KMI_RxRealtime
+{
+public:
+    KMI_RxRealtime() { reset(); }
+
+    void reset()
+    {
+        ticks.store(0, std::memory_order_relaxed);
+        beats.store(0, std::memory_order_relaxed);
+        senses.store(0, std::memory_order_relaxed);
+        lastSense.store(0, std::memory_order_relaxed);
+        tempo.store(0, std::memory_order_relaxed);
+        running.store(false, std::memory_order_relaxed);
+        lastTickNs = 0;
+        intervalNs = 0;
+        tickInBeat = 0;
+    }
+
+    // callback thread, returns true when a beat completed
+    bool clock(qint64 timestampNs)
+    {
+        ticks.fetch_add(1, std::memory_order_relaxed);
+
+        if (lastTickNs != 0)
+        {
+            double interval = double(timestampNs - lastTickNs);
+            if (interval > 0)
+            {
+                if (intervalNs <= 0 || interval > intervalNs * RT_TEMPO_RESYNC || interval * RT_TEMPO_RESYNC < intervalNs)
+                    intervalNs = interval; // first interval or a jump, start over
+                else
+                    intervalNs += (interval - intervalNs) / 8;
+
+                tempo.store(60e9 / (intervalNs * RT_PPQN), std::memory_order_relaxed);
+            }
+        }
+        lastTickNs = timestampNs;
+
+        if (++tickInBeat < RT_PPQN) return false;
+        tickInBeat = 0;
+        beats.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // callback thread
+    void start()
+    {
+        tickInBeat = 0;
+        beats.store(0, std::memory_order_relaxed);
+        running.store(true, std::memory_order_relaxed);
+    }
+    void resume() { running.store(true, std::memory_order_relaxed); }   // continue
+    void stop()
+    {
+        running.store(false, std::memory_order_relaxed);
+        lastTickNs = 0; // the clock may pause with the transport, don't average across the gap
+    }
+    void sense(qint64 timestampNs)
+    {
+        senses.fetch_add(1, std::memory_order_relaxed);
+        lastSense.store(timestampNs, std::memory_order_relaxed);
+    }
+
+    // any thread
+    double bpm() const { return tempo.load(std::memory_order_relaxed); }     // 0 until two ticks arrived
+    quint64 clockTicks() const { return ticks.load(std::memory_order_relaxed); }
+    quint64 beatCount() const { return beats.load(std::memory_order_relaxed); }  // since start
+    quint64 senseCount() const { return senses.load(std::memory_order_relaxed); }
+    qint64 lastSenseNs() const { return lastSense.load(std::memory_order_relaxed); }
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> ticks;
+    std::atomic<quint64> beats;
+    std::atomic<quint64> senses;
+    std::atomic<qint64> lastSense;
+    std::atomic<double> tempo;
+    std::atomic<bool> running;
+
+    // callback thread
+    qint64 lastTickNs;
+    double intervalNs;
+    int tickInBeat;
+};
+
+#endif // KMI_RXREALTIME_H
@@ -0,0 +1,188 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_RXRING_H
+#define KMI_RXRING_H
+
+/* KMI Rx Ring
+
+  Single-producer/single-consumer hand-off between the RtMidi callback (driver thread) and the
+  thread that owns a MidiDeviceManager.
+
+  - the producer (midiInCallback) only copies bytes, it never allocates, locks or waits
+  - channel/system common/realtime messages are stored inline (up to 3 bytes)
+  - longer messages (sysex, or anything else a backend hands over in one piece) are stored in a
+    separate byte slab, each message is kept contiguous so the consumer can read it in place.
+    The consumer calls releaseSlab once it is done with every slab event, not only sysex
+  - if either the event ring or the slab is full the message is dropped and counted
+  - sysex that lives in a KMI_RxSysExPool buffer (stitched, or larger than the slab) is passed
+    by buffer index with pushPooled, the consumer releases the buffer to the pool itself
+
+  Header only, no Qt dependency.
+
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#define RX_RING_SIZE            1024    // number of events, must be a power of two
+#define RX_RING_SYSEX_SLAB_SIZE 65536   // bytes reserved for inbound sysex, must be a power of two
+#define RX_RING_INLINE_SIZE     3       // channel messages are never longer than this
+
+typedef struct
+{
+    int64_t  timestampNs;   // host time of this message, stamped in the callback (KMI_rxClock.h)
+    uint32_t length;        // total message length in bytes
+    uint32_t sysexStart;    // monotonic slab index of the first byte (slab events only)
+    uint32_t sysexEnd;      // monotonic slab index after the last byte, released when the event is consumed
+    uint8_t  data[RX_RING_INLINE_SIZE]; // inline bytes for messages up to RX_RING_INLINE_SIZE
+    bool     inSlab;        // the bytes are in the slab, longer than RX_RING_INLINE_SIZE
+    int16_t  poolBuffer;    // KMI_RxSysExPool buffer holding the sysex, -1 if it's in the slab
+} RX_RING_EVENT;
+
+class KMI_RxRing
+{
+public:
+    KMI_RxRing()
+    {
+        eventHead.store(0, std::memory_order_relaxed);
+        eventTail.store(0, std::memory_order_relaxed);
+        slabHead = 0;
+        slabTail.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+    }
+
+    // ----------------------------------------------------------
+    // producer side, only call from the RtMidi callback
+    // ----------------------------------------------------------
+
+    bool push(int64_t timestampNs, const unsigned char *message, size_t length)
+    {
+        uint32_t head = eventHead.load(std::memory_order_relaxed);
+
+        if (head - eventTail.load(std::memory_order_acquire) >= RX_RING_SIZE)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false; // event ring is full
+        }
+
+        RX_RING_EVENT &e = events[head & (RX_RING_SIZE - 1)];
+        e.timestampNs = timestampNs;
+        e.length = (uint32_t)length;
+        e.poolBuffer = -1;
+
+        if (length > RX_RING_INLINE_SIZE)
+        {
+            // keep every message contiguous, skip the tail of the slab if it won't fit
+            uint32_t start = slabHead;
+            uint32_t offset = start & (RX_RING_SYSEX_SLAB_SIZE - 1);
+            if (offset + length > RX_RING_SYSEX_SLAB_SIZE)
+            {
+                start += RX_RING_SYSEX_SLAB_SIZE - offset;
+            }
+
+            if (length > RX_RING_SYSEX_SLAB_SIZE ||
+                (start + length) - slabTail.load(std::memory_order_acquire) > RX_RING_SYSEX_SLAB_SIZE)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false; // slab is full
+            }
+
+            memcpy(&slab[start & (RX_RING_SYSEX_SLAB_SIZE - 1)], message, length);
+            slabHead = start + (uint32_t)length;
+
+            e.inSlab = true;
+            e.sysexStart = start;
+            e.sysexEnd = slabHead;
+        }
+        else
+        {
+            e.inSlab = false;
+            e.sysexStart = e.sysexEnd = 0;
+            memcpy(e.data, message, length);
+        }
+
+        eventHead.store(head + 1, std::memory_order_release); // publish
+        return true;
+    }
+
+    // sysex held in a pool buffer, only the index is queued
+    bool pushPooled(int64_t timestampNs, int poolBuffer, size_t length)
+    {
+        uint32_t head = eventHead.load(std::memory_order_relaxed);
+
+        if (head - eventTail.load(std::memory_order_acquire) >= RX_RING_SIZE)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false; // event ring is full
+        }
+
+        RX_RING_EVENT &e = events[head & (RX_RING_SIZE - 1)];
+        e.timestampNs = timestampNs;
+        e.length = (uint32_t)length;
+        e.inSlab = false;
+        e.poolBuffer = (int16_t)poolBuffer;
+        e.sysexStart = e.sysexEnd = 0;
+
+        eventHead.store(head + 1, std::memory_order_release); // publish
+        return true;
+    }
+
+    // ----------------------------------------------------------
+    // consumer side, only call from the owning thread
+    // ----------------------------------------------------------
+
+    bool pop(RX_RING_EVENT &event)
+    {
+        uint32_t tail = eventTail.load(std::memory_order_relaxed);
+
+        if (tail == eventHead.load(std::memory_order_acquire))
+        {
+            return false; // empty
+        }
+
+        event = events[tail & (RX_RING_SIZE - 1)];
+        eventTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pointer to the first byte of a popped event, valid until releaseSlab is called.
+    // Not for pooled events, their bytes are in the pool
+    const unsigned char *bytes(const RX_RING_EVENT &event) const
+    {
+        return event.inSlab ? &slab[event.sysexStart & (RX_RING_SYSEX_SLAB_SIZE - 1)] : event.data;
+    }
+
+    // hand slab space back to the producer once an event has been processed, no-op for inline
+    // and pooled events
+    void releaseSlab(const RX_RING_EVENT &event)
+    {
+        if (event.inSlab)
+        {
+            slabTail.store(event.sysexEnd, std::memory_order_release);
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return eventTail.load(std::memory_order_acquire) == eventHead.load(std::memory_order_acquire);
+    }
+
+    // number of messages dropped because the ring or slab was full
+    uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    RX_RING_EVENT events[RX_RING_SIZE];
+    std::atomic<uint32_t> eventHead;    // written by producer
+    std::atomic<uint32_t> eventTail;    // written by consumer
+
+    unsigned char slab[RX_RING_SYSEX_SLAB_SIZE];
+    uint32_t slabHead;                  // producer only
+    std::atomic<uint32_t> slabTail;     // written by consumer
+
+    std::atomic<uint32_t> dropped;
+};
+
+#endif // KMI_RXRING_H
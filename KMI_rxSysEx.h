@@ -0,0 +1,237 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_RXSYSEX_H
+#define KMI_RXSYSEX_H
+
+/* KMI Rx SysEx Pool
+
+  Inbound sysex reassembly for the RtMidi callback (see MidiDeviceManager::slotSetRxSysExMaxSize).
+
+  - a fixed set of RX_SYSEX_POOL_BUFFERS buffers is reserved up front by configure(), the
+    callback only copies into them, it never allocates, locks or waits
+  - some backends hand over long sysex in pieces: F0 ... without the F7, then data bytes,
+    the last piece ends with F7. feed() stitches the pieces into one buffer
+  - realtime bytes between the pieces are passed through, any other status byte abandons the
+    message being assembled
+  - a message arriving whole (F0 ... F7 in one callback) is not copied, the caller uses the
+    RtMidi buffer in place (RX_SYSEX_WHOLE)
+  - messages over the max size, or with every buffer still in use, are dropped and counted,
+    the rest of a dropped message is skipped up to its F7
+  - a completed buffer belongs to the consumer until release(), which may be called from
+    another thread (the rx ring drain), so messages can be in flight while the next one is
+    assembled
+
+  feed()/acquireCopy() are callback thread only, configure()/reset() only while the callback
+  isn't installed. Counters can be read from any thread. Header only, no Qt dependency.
+
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define RX_SYSEX_POOL_BUFFERS   4       // messages assembled or in flight at once
+#define RX_SYSEX_MAX_SIZE       65536   // default max inbound sysex length in bytes
+
+#define RX_SYSEX_START          0xF0
+#define RX_SYSEX_END            0xF7
+#define RX_SYSEX_REALTIME       0xF8    // this and above may appear inside a sysex
+
+enum
+{
+    RX_SYSEX_NOT_SYSEX,     // not sysex, parse as usual
+    RX_SYSEX_WHOLE,         // a complete sysex in the caller's buffer, nothing copied
+    RX_SYSEX_PENDING,       // piece stored (or skipped), nothing to deliver yet
+    RX_SYSEX_COMPLETE,      // the last piece arrived, deliver buffer completed()
+    RX_SYSEX_DROPPED        // too large or no free buffer, counted in dropped()
+};
+
+class KMI_RxSysExPool
+{
+public:
+    KMI_RxSysExPool()
+    {
+        limit = 0;
+        assembling = -1;
+        skipping = false;
+        lastCompleted = -1;
+        for (int i = 0; i < RX_SYSEX_POOL_BUFFERS; i++) inUse[i].store(false, std::memory_order_relaxed);
+        stitchedCount.store(0, std::memory_order_relaxed);
+        droppedCount.store(0, std::memory_order_relaxed);
+    }
+
+    // ----------------------------------------------------------
+    // owner thread, callback not installed
+    // ----------------------------------------------------------
+
+    // reserve the buffers, only reallocates when maxSize grows and no buffer is still in flight.
+    // Returns the max size in effect.
+    size_t configure(size_t maxSize)
+    {
+        reset();
+
+        if (maxSize > buffers[0].capacity())
+        {
+            bool idle = true;
+            for (int i = 0; i < RX_SYSEX_POOL_BUFFERS; i++) idle = idle && !inUse[i].load(std::memory_order_acquire);
+
+            if (idle)
+            {
+                for (int i = 0; i < RX_SYSEX_POOL_BUFFERS; i++)
+                {
+                    std::vector<unsigned char>().swap(buffers[i]); // give back the old reservation first
+                    buffers[i].reserve(maxSize);
+                }
+            }
+        }
+
+        limit = maxSize < buffers[0].capacity() ? maxSize : buffers[0].capacity();
+        return limit;
+    }
+
+    // abandon a message being assembled, buffers in flight stay with their consumer
+    void reset()
+    {
+        if (assembling >= 0) release(assembling);
+        assembling = -1;
+        skipping = false;
+    }
+
+    // ----------------------------------------------------------
+    // producer side, only call from the RtMidi callback
+    // ----------------------------------------------------------
+
+    int feed(const unsigned char *bytes, size_t length)
+    {
+        if (length == 0) return RX_SYSEX_NOT_SYSEX;
+
+        unsigned char first = bytes[0];
+        bool ends = bytes[length - 1] == RX_SYSEX_END;
+
+        if (first == RX_SYSEX_START)
+        {
+            if (assembling >= 0 || skipping) abandon(); // the previous one never got its F7
+
+            if (length > limit) return drop(ends);
+            if (ends) return RX_SYSEX_WHOLE;
+
+            assembling = acquire();
+            if (assembling < 0) return drop(false);
+
+            buffers[assembling].insert(buffers[assembling].end(), bytes, bytes + length);
+            return RX_SYSEX_PENDING;
+        }
+
+        if (assembling < 0 && !skipping) return RX_SYSEX_NOT_SYSEX;
+        if (first >= RX_SYSEX_REALTIME) return RX_SYSEX_NOT_SYSEX; // interleaved clock etc.
+
+        if ((first & 0x80) && first != RX_SYSEX_END)
+        {
+            abandon(); // a new message started, the sysex was cut off
+            return RX_SYSEX_NOT_SYSEX;
+        }
+
+        // continuation
+        if (skipping)
+        {
+            if (ends) skipping = false;
+            return RX_SYSEX_PENDING;
+        }
+
+        std::vector<unsigned char> &buffer = buffers[assembling];
+        if (buffer.size() + length > limit)
+        {
+            release(assembling);
+            assembling = -1;
+            return drop(ends);
+        }
+
+        buffer.insert(buffer.end(), bytes, bytes + length);
+        if (!ends) return RX_SYSEX_PENDING;
+
+        lastCompleted = assembling;
+        assembling = -1;
+        stitchedCount.fetch_add(1, std::memory_order_relaxed);
+        return RX_SYSEX_COMPLETE;
+    }
+
+    // buffer of the message RX_SYSEX_COMPLETE was returned for
+    int completed() const { return lastCompleted; }
+
+    // copy a whole message into a free buffer, for consumers that can't use the caller's buffer in
+    // place (larger than the rx ring slab). Returns the buffer, -1 if none is free.
+    int acquireCopy(const unsigned char *bytes, size_t length)
+    {
+        if (length > limit) return -1;
+
+        int index = acquire();
+        if (index >= 0) buffers[index].insert(buffers[index].end(), bytes, bytes + length);
+        return index;
+    }
+
+    // ----------------------------------------------------------
+    // consumer side, valid until release
+    // ----------------------------------------------------------
+
+    const unsigned char *data(int buffer) const { return buffers[buffer].data(); }
+    size_t length(int buffer) const { return buffers[buffer].size(); }
+    std::vector<unsigned char> *vector(int buffer) { return &buffers[buffer]; }
+
+    // any thread, hands the buffer back to the producer
+    void release(int buffer)
+    {
+        buffers[buffer].clear(); // keeps the reservation
+        inUse[buffer].store(false, std::memory_order_release);
+    }
+
+    // ----------------------------------------------------------
+    // any thread
+    // ----------------------------------------------------------
+
+    size_t maxSize() const { return limit; }
+    uint64_t stitched() const { return stitchedCount.load(std::memory_order_relaxed); }   // messages reassembled from pieces
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    int acquire()
+    {
+        for (int i = 0; i < RX_SYSEX_POOL_BUFFERS; i++)
+        {
+            if (!inUse[i].load(std::memory_order_acquire))
+            {
+                inUse[i].store(true, std::memory_order_relaxed);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int drop(bool ends)
+    {
+        skipping = !ends;
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return RX_SYSEX_DROPPED;
+    }
+
+    void abandon()
+    {
+        if (assembling >= 0) droppedCount.fetch_add(1, std::memory_order_relaxed);
+        reset();
+    }
+
+    std::vector<unsigned char> buffers[RX_SYSEX_POOL_BUFFERS];
+    std::atomic<bool> inUse[RX_SYSEX_POOL_BUFFERS];
+    size_t limit;                       // max message length, at most the reserved capacity
+
+    // producer only
+    int assembling;                     // buffer being filled, -1 if none
+    bool skipping;                      // dropping the rest of a message up to its F7
+    int lastCompleted;
+
+    std::atomic<uint64_t> stitchedCount;
+    std::atomic<uint64_t> droppedCount;
+};
+
+#endif // KMI_RXSYSEX_H
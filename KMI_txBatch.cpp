@@ -0,0 +1,135 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* KMI Tx Batch
+
+  See KMI_txBatch.h for details.
+
+  Links CoreMIDI on macOS, same as RtMidi and KMI_PortNotifier.
+
+*/
+
+#include "KMI_txBatch.h"
+#include <QDebug>
+
+#ifdef Q_OS_MAC
+#include <CoreMIDI/CoreMIDI.h>
+#endif
+
+#define TX_BATCH_DIRECT_MAX 65535 // MIDIPacket length is 16 bit, larger batches go through RtMidi
+
+KMI_TxBatch::KMI_TxBatch()
+{
+#ifdef Q_OS_MAC
+    macClient = 0;
+    macPort = 0;
+    macDestination = 0;
+#endif
+}
+
+KMI_TxBatch::~KMI_TxBatch()
+{
+#ifdef Q_OS_MAC
+    if (macPort) MIDIPortDispose(macPort);
+    if (macClient) MIDIClientDispose(macClient);
+#endif
+}
+
+// ****************************
+// Public Functions
+// ****************************
+
+void KMI_TxBatch::setDestination(unsigned int portIndex)
+{
+#ifdef Q_OS_MAC
+    macDestination = 0;
+
+    if (macClient == 0)
+    {
+        OSStatus result = MIDIClientCreate(CFSTR("KMI Tx Batch"), nullptr, nullptr, &macClient);
+        if (result == noErr) result = MIDIOutputPortCreate(macClient, CFSTR("KMI Tx Batch Out"), &macPort);
+        if (result != noErr)
+        {
+            qDebug() << "KMI_TxBatch: couldn't create a CoreMIDI output port:" << result;
+            if (macClient) MIDIClientDispose(macClient);
+            macClient = 0;
+            macPort = 0;
+            return;
+        }
+    }
+
+    // RtMidi's CoreMIDI output port numbers are destination indices
+    if (portIndex < MIDIGetNumberOfDestinations())
+    {
+        macDestination = MIDIGetDestination(portIndex);
+    }
+#else
+    Q_UNUSED(portIndex);
+#endif
+}
+
+void KMI_TxBatch::clearDestination()
+{
+#ifdef Q_OS_MAC
+    macDestination = 0;
+#endif
+}
+
+bool KMI_TxBatch::isDirect() const
+{
+#ifdef Q_OS_MAC
+    return macDestination != 0;
+#else
+    return false;
+#endif
+}
+
+void KMI_TxBatch::send(RtMidiOut *midiOut, const unsigned char *bytes, size_t size, bool allowDirect)
+{
+    if (size == 0) return;
+
+    if (allowDirect && isDirect() && size <= TX_BATCH_DIRECT_MAX && sendDirect(bytes, size)) return;
+
+    // one RtMidi call per message, lengths come from the table
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t length = kmiMidiMessageLength(bytes[i]);
+        if (length == 0 || i + length > size)
+        {
+            qDebug() << "KMI_TxBatch: dropping malformed batch tail at" << i << "of" << size;
+            return;
+        }
+        midiOut->sendMessage(bytes + i, length);
+        i += length;
+    }
+}
+
+// ****************************
+// Private Functions
+// ****************************
+
+bool KMI_TxBatch::sendDirect(const unsigned char *bytes, size_t size)
+{
+#ifdef Q_OS_MAC
+    // complete messages can share one packet, so the whole batch is a single MIDIPacketList entry
+    size_t listSize = sizeof(MIDIPacketList) + size;
+    if (packetListBuffer.size() < listSize) packetListBuffer.resize(listSize);
+
+    MIDIPacketList *packetList = reinterpret_cast<MIDIPacketList *>(packetListBuffer.data());
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    packet = MIDIPacketListAdd(packetList, listSize, packet, 0, size, bytes);
+
+    if (packet == nullptr || MIDISend(macPort, macDestination, packetList) != noErr)
+    {
+        qDebug() << "KMI_TxBatch: MIDISend failed, falling back to RtMidi";
+        macDestination = 0;
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(bytes);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_TXBATCH_H
+#define KMI_TXBATCH_H
+
+/* KMI Tx Batch
+
+  Sends a staged run of short (1-3 byte) MIDI messages in as few driver calls as the backend allows.
+
+  - RtMidi only takes one short message per sendMessage, so on most backends a batch is still one
+    call per message, split with kmiMidiMessageLength instead of scanning for status bytes
+  - on macOS the batch is packed into one MIDIPacketList and handed to CoreMIDI with a single
+    MIDISend, through our own output port to the destination RtMidi has open
+  - setDestination/clearDestination follow the RtMidi port, a virtual port has no destination and
+    uses the per message path
+  - the direct path is a second CoreMIDI client, so it can overtake or split a sysex still going
+    out through RtMidi's port. Callers pass allowDirect = false while any sysex is queued or open
+
+  Not thread safe, call it from whichever thread owns the RtMidiOut.
+
+*/
+
+#include <QtGlobal>
+#include <vector>
+#include "RtMidi.h"
+
+// length of a short message from its status byte, 0 for data bytes and sysex (F0/F7)
+static const unsigned char kmiMidiMessageLengthTable[256] =
+{
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 0x00 data
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, 3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // 0x80 note off/on
+    3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, 3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, // 0xA0 poly AT, CC
+    2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2, // 0xC0 program, pressure
+    3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,                                  // 0xE0 pitch bend
+    0,2,3,2,1,1,1,0,1,1,1,1,1,1,1,1                                   // 0xF0 system common/realtime
+};
+
+inline unsigned char kmiMidiMessageLength(unsigned char status)
+{
+    return kmiMidiMessageLengthTable[status];
+}
+
+class KMI_TxBatch
+{
+public:
+    KMI_TxBatch();
+    ~KMI_TxBatch();
+
+    // follow the RtMidi output port, the index is the same one passed to RtMidiOut::openPort
+    void setDestination(unsigned int portIndex);
+    void clearDestination();
+    bool isDirect() const;      // true if batches bypass RtMidi (one OS call per batch)
+
+    // bytes holds complete short messages back to back, a malformed tail is dropped.
+    // Throws RtMidiError like RtMidiOut::sendMessage when it goes through RtMidi.
+    void send(RtMidiOut *midiOut, const unsigned char *bytes, size_t size, bool allowDirect = true);
+
+private:
+    KMI_TxBatch(const KMI_TxBatch &) = delete;
+    KMI_TxBatch &operator=(const KMI_TxBatch &) = delete;
+
+    bool sendDirect(const unsigned char *bytes, size_t size);
+
+#ifdef Q_OS_MAC
+    unsigned int macClient;         // MIDIClientRef, created on first use
+    unsigned int macPort;           // MIDIPortRef
+    unsigned int macDestination;    // MIDIEndpointRef, 0 = none
+    std::vector<unsigned char> packetListBuffer; // reused MIDIPacketList storage
+#endif
+};
+
+#endif // KMI_TXBATCH_H
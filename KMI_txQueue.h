@@ -0,0 +1,194 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMI_TXQUEUE_H
+#define KMI_TXQUEUE_H
+
+/* KMI Tx Queue
+
+  Segmented byte queue for outgoing MIDI. Replaces the std::vector that slotEmptyMIDIBuffer used to
+  erase from the front after every sysex chunk.
+
+  - bytes are appended to the tail segment, chunks are read from the head segment in place
+  - consuming a chunk only advances an offset, the remaining bytes are never moved
+  - a QByteArray can be queued as its own segment without copying (implicitly shared)
+  - so can any read-only buffer kept alive by a shared_ptr, ie a memory mapped KMI_FwImage
+  - emptied segments keep their capacity and are reused
+
+  Not thread safe, owned by a single MidiDeviceManager.
+
+*/
+
+#include <QByteArray>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cstring>
+
+class KMI_TxQueue
+{
+public:
+    KMI_TxQueue() : totalSize(0) {}
+
+    size_t size() const { return totalSize; }
+    bool empty() const { return totalSize == 0; }
+
+    void clear()
+    {
+        while (!segments.empty()) popFront();
+        totalSize = 0;
+    }
+
+    // copy bytes onto the end of the queue
+    void append(const unsigned char *data, size_t length)
+    {
+        if (length == 0) return;
+        ownedTail().insert(ownedTail().end(), data, data + length);
+        totalSize += length;
+    }
+
+    void push_back(unsigned char byte)
+    {
+        ownedTail().push_back(byte);
+        totalSize++;
+    }
+
+    // queue a QByteArray as its own segment, the data is shared with the caller rather than copied
+    void append(const QByteArray &data)
+    {
+        if (data.isEmpty()) return;
+
+        Segment segment;
+        segment.shared = data;
+        segment.ref = reinterpret_cast<const unsigned char*>(segment.shared.constData());
+        segment.refSize = data.size();
+        segment.offset = 0;
+        segment.isShared = true;
+        segments.push_back(segment);
+        totalSize += data.size();
+    }
+
+    // queue an external buffer as its own segment, owner keeps it alive until it has been sent
+    void append(const unsigned char *data, size_t length, std::shared_ptr<const void> owner)
+    {
+        if (length == 0) return;
+
+        Segment segment;
+        segment.ref = data;
+        segment.refSize = length;
+        segment.owner = owner;
+        segment.offset = 0;
+        segment.isShared = true;
+        segments.push_back(segment);
+        totalSize += length;
+    }
+
+    // contiguous view of up to maxLength bytes from the front of the queue, never crosses a
+    // segment boundary so it can return less than asked for. Valid until the queue is modified.
+    size_t peek(const unsigned char **data, size_t maxLength) const
+    {
+        if (segments.empty())
+        {
+            *data = nullptr;
+            return 0;
+        }
+
+        const Segment &front = segments.front();
+        size_t available = front.size() - front.offset;
+
+        *data = front.data() + front.offset;
+        return available < maxLength ? available : maxLength;
+    }
+
+    // drop bytes from the front of the queue
+    void consume(size_t length)
+    {
+        while (length > 0 && !segments.empty())
+        {
+            Segment &front = segments.front();
+            size_t available = front.size() - front.offset;
+
+            if (length < available)
+            {
+                front.offset += length;
+                totalSize -= length;
+                return;
+            }
+
+            length -= available;
+            totalSize -= available;
+            popFront();
+        }
+    }
+
+    // merge everything into a single segment and return it, only meant for small amounts of data
+    const unsigned char *linearize()
+    {
+        if (segments.empty()) return nullptr;
+
+        if (segments.size() > 1 || segments.front().isShared || segments.front().offset)
+        {
+            Segment merged;
+            merged.owned.swap(spare);
+            merged.owned.clear();
+            merged.owned.reserve(totalSize);
+            for (const Segment &segment : segments)
+            {
+                merged.owned.insert(merged.owned.end(), segment.data() + segment.offset, segment.data() + segment.size());
+            }
+            merged.offset = 0;
+            merged.isShared = false;
+
+            size_t mergedSize = totalSize;
+            clear();
+            segments.push_back(std::move(merged));
+            totalSize = mergedSize;
+        }
+        return segments.front().data();
+    }
+
+private:
+    struct Segment
+    {
+        std::vector<unsigned char> owned;
+        QByteArray shared;                  // holds a queued QByteArray
+        std::shared_ptr<const void> owner;  // or keeps an external buffer alive
+        const unsigned char *ref;           // shared/external data
+        size_t refSize;
+        size_t offset;
+        bool isShared;
+
+        const unsigned char *data() const { return isShared ? ref : owned.data(); }
+        size_t size() const { return isShared ? refSize : owned.size(); }
+    };
+
+    std::vector<unsigned char> &ownedTail()
+    {
+        if (segments.empty() || segments.back().isShared)
+        {
+            Segment segment;
+            segment.owned.swap(spare); // reuse a previous buffer's capacity
+            segment.owned.clear();
+            segment.offset = 0;
+            segment.isShared = false;
+            segments.push_back(std::move(segment));
+        }
+        return segments.back().owned;
+    }
+
+    void popFront()
+    {
+        Segment &front = segments.front();
+        if (!front.isShared && front.owned.capacity() > spare.capacity())
+        {
+            spare.swap(front.owned); // keep the larger buffer around for the next tail
+        }
+        segments.pop_front();
+    }
+
+    std::deque<Segment> segments;
+    std::vector<unsigned char> spare;
+    size_t totalSize;
+};
+
+#endif // KMI_TXQUEUE_H
@@ -16,20 +16,18 @@ KMI_Updates::KMI_Updates(QWidget *p, QString an, QSettings *_sessionSettings, QB
     applicationVersion[1] = uchar(av.at(1));
     applicationVersion[2] = uchar(av.at(2));
 
-    networkAccessManager = new(QNetworkAccessManager);
-    //networkAccessManager->set
-
+    // created on the first request, TLS isn't touched before that
+    networkAccessManager = nullptr;
 
     appName = an;
 
-    connect(networkAccessManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(slotUpdateCheckReply(QNetworkReply*)));
-
     manualUpdateCheck = false;
+    autoUpdateCheckDone = false;
 
     qDebug() << "KMI Updates Module initialized, application version: " << uchar(applicationVersion[0]) << "." << uchar(applicationVersion[1]) << "." << uchar(applicationVersion[2]);
 
-    slotCheckForUpdates();
-
+    // the automatic check waits for a device (slotDeviceConnected), this is the fallback
+    QTimer::singleShot(UPDATE_CHECK_FALLBACK_MS, this, SLOT(slotAutoCheckForUpdates()));
 }
 
 void KMI_Updates::slotManualCheckForUpdates()
@@ -40,133 +38,259 @@ void KMI_Updates::slotManualCheckForUpdates()
     slotCheckForUpdates();
 }
 
+void KMI_Updates::slotDeviceConnected(bool connected)
+{
+    if (!connected || autoUpdateCheckDone) return;
+
+    QTimer::singleShot(UPDATE_CHECK_DEFER_MS, this, SLOT(slotAutoCheckForUpdates()));
+}
+
+void KMI_Updates::slotAutoCheckForUpdates()
+{
+    if (autoUpdateCheckDone) return; // already ran, from the other trigger or a manual check
+    slotCheckForUpdates();
+}
+
 void KMI_Updates::slotCheckForUpdates()
 {
     //qDebug() << "slotCheckForUpdates called";
 
-    //QSslSocket::setProtocol()
-    qDebug() << "SSL Check: " << QSslSocket::supportsSsl() << QSslSocket::sslLibraryBuildVersionString() << QSslSocket::sslLibraryVersionString();
-    qDebug() << "checking for updates";
-    networkAccessManager->get(QNetworkRequest(QUrl(jsonVersionURL)));
+    autoUpdateCheckDone = true;
+
+    UPDATE_CACHE cache = loadCache();
+
+    // automatic checks reuse a recent manifest, this one or another editor's
+    if (!manualUpdateCheck && cache.checkedAt && !cache.manifest.isEmpty() &&
+        QDateTime::currentSecsSinceEpoch() - cache.checkedAt < UPDATE_CHECK_INTERVAL_S)
+    {
+        qDebug() << "checking for updates - using the cached manifest from" << QDateTime::fromSecsSinceEpoch(cache.checkedAt).toString(Qt::ISODate);
+        processManifest(cache.manifest);
+        return;
+    }
+
+    if (networkAccessManager == nullptr)
+    {
+        networkAccessManager = new QNetworkAccessManager(this);
+        connect(networkAccessManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(slotUpdateCheckReply(QNetworkReply*)));
+
+        qDebug() << "SSL Check: " << QSslSocket::supportsSsl() << QSslSocket::sslLibraryBuildVersionString() << QSslSocket::sslLibraryVersionString();
+    }
+
+    // conditional, the server answers 304 if the cached manifest is still current
+    QNetworkRequest request((QUrl(jsonVersionURL)));
+    if (!cache.manifest.isEmpty())
+    {
+        if (!cache.eTag.isEmpty()) request.setRawHeader("If-None-Match", cache.eTag);
+        if (!cache.lastModified.isEmpty()) request.setRawHeader("If-Modified-Since", cache.lastModified);
+    }
 
+    qDebug() << "checking for updates";
+    QNetworkReply *networkReply = networkAccessManager->get(request);
+    QTimer::singleShot(UPDATE_CHECK_TIMEOUT_MS, networkReply, &QNetworkReply::abort); // no-op once finished
 }
 
 void KMI_Updates::slotUpdateCheckReply(QNetworkReply *networkReply)
 {
     //qDebug() << "slotUpdateCheckReply called";
-    QMessageBox m(QMessageBox::NoIcon, "Software Update", "", QMessageBox::NoButton, 0, Qt::Dialog);
 
-    //m.setStyleSheet("QPushButton {font-family: \"Arial\";font-size: 10px;background-color: rgba(162, 0, 0, 255);border-style: outset;border-radius: 4.0;border-width: 1px;border-color: rgba(0, 51, 76, 255);color: white;} QPushButton:pressed {background-color: rgba(122, 0, 0, 255);} QPushButton:focus  outline: none;}");
+    networkReply->deleteLater();
 
-    QString messageBoxText;
+    int httpStatus = networkReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
     if(networkReply->isFinished() && networkReply->error() == QNetworkReply::NoError)
     {
-        QByteArray replyArray = networkReply->readAll();
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(replyArray);
-        QVariantMap versionMap = jsonDoc.toVariant().toMap();
+        UPDATE_CACHE cache = loadCache();
+
+        if (httpStatus == 304 && !cache.manifest.isEmpty())
+        {
+            qDebug() << "software update: manifest not modified";
+        }
+        else
+        {
+            cache.manifest = networkReply->readAll();
+            cache.eTag = networkReply->rawHeader("ETag");
+            cache.lastModified = networkReply->rawHeader("Last-Modified");
+        }
+
+        cache.checkedAt = QDateTime::currentSecsSinceEpoch();
+        storeCache(cache);
+
+        processManifest(cache.manifest);
+    }
+    else
+    {
+        qDebug() << "software update error:" << networkReply->error() << "http status:" << httpStatus;
+        if(manualUpdateCheck) //only show the error if update is happening manually
+        {
+            showMessageBox("An error occurred. Check your internet connection and try again.");
+        }
+    }
+
+    manualUpdateCheck = false;
+}
+
+void KMI_Updates::processManifest(const QByteArray &manifest)
+{
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(manifest);
+    QVariantMap versionMap = jsonDoc.toVariant().toMap();
 
-        QByteArray JSONVersion = versionMap.value("Editor").toByteArray();
-        int foundVersion[3];
+    QByteArray JSONVersion = versionMap.value("Editor").toByteArray();
+    int foundVersion[3];
 
 
-        int firstDecimal = JSONVersion.indexOf(".");
-        int secondDecimal = JSONVersion.indexOf(".", firstDecimal + 1);
+    int firstDecimal = JSONVersion.indexOf(".");
+    int secondDecimal = JSONVersion.indexOf(".", firstDecimal + 1);
 
-        foundVersion[0] = JSONVersion.left(firstDecimal).toInt();
-        foundVersion[1] = JSONVersion.mid(firstDecimal + 1, secondDecimal - firstDecimal - 1).toInt();
-        foundVersion[2] = JSONVersion.mid(secondDecimal + 1, 2).toInt();
+    foundVersion[0] = JSONVersion.left(firstDecimal).toInt();
+    foundVersion[1] = JSONVersion.mid(firstDecimal + 1, secondDecimal - firstDecimal - 1).toInt();
+    foundVersion[2] = JSONVersion.mid(secondDecimal + 1, 2).toInt();
 
-        qDebug() << "foundVersion: " << foundVersion[0] << "." << foundVersion[1] << "." << foundVersion[2] << " applicationVersion:" << uchar(applicationVersion[0]) << uchar(applicationVersion[1]) << uchar(applicationVersion[2]);;
+    qDebug() << "foundVersion: " << foundVersion[0] << "." << foundVersion[1] << "." << foundVersion[2] << " applicationVersion:" << uchar(applicationVersion[0]) << uchar(applicationVersion[1]) << uchar(applicationVersion[2]);;
 
-        bool appIsOutOfDate = false;
+    bool appIsOutOfDate = false;
 
-        if ((uchar(foundVersion[0])) > uchar(applicationVersion[0]) ) // major version is greater
+    if ((uchar(foundVersion[0])) > uchar(applicationVersion[0]) ) // major version is greater
+    {
+        appIsOutOfDate = true;
+    }
+    else if (uchar(foundVersion[0]) == uchar(applicationVersion[0])) // major version is the same
+    {
+        if (uchar(foundVersion[1]) > uchar(applicationVersion[1])) // middle version is greater
         {
             appIsOutOfDate = true;
         }
-        else if (uchar(foundVersion[0]) == uchar(applicationVersion[0])) // major version is the same
+        else if (uchar(foundVersion[1]) == uchar(applicationVersion[1])) // middle version is the same
         {
-            if (uchar(foundVersion[1]) > uchar(applicationVersion[1])) // middle version is greater
+            if (uchar(foundVersion[2]) > uchar(applicationVersion[2])) // minor version is greater
             {
                 appIsOutOfDate = true;
             }
-            else if (uchar(foundVersion[1]) == uchar(applicationVersion[1])) // middle version is the same
-            {
-                if (uchar(foundVersion[2]) > uchar(applicationVersion[2])) // minor version is greater
-                {
-                    appIsOutOfDate = true;
-                }
-            }
         }
+    }
 
-        if (appIsOutOfDate)
-        {
-            bool skipUpdate = slotReturnSkipUpdateBool(JSONVersion);
-            qDebug() << "manualUpdateCheck: " << manualUpdateCheck << "skipUpdate: " << skipUpdate;
-            if(manualUpdateCheck || !skipUpdate)
-            {
-                QString updateMsg = versionMap.value("message").toString();
-                messageBoxText = QString("%1 version %2.%3.%4 is available.").arg(appName).arg(foundVersion[0]).arg(foundVersion[1]).arg(foundVersion[2]);
-                m.setTextFormat(Qt::RichText);
-                m.setDetailedText(updateMsg);
-                m.setText(messageBoxText);
-                qDebug() << "update - updateMsg: " << updateMsg;
-                m.addButton("Download", QMessageBox::YesRole);
-                m.addButton("Skip This Version", QMessageBox::NoRole);
-                m.addButton("Remind Me Later", QMessageBox::RejectRole);
-
-                int exitCode = m.exec();
-
-                if(exitCode == 0)
-                {
-                    slotGoToDownloadsPage();
-                }
-                else if(exitCode == 1)
-                {
-                    slotSkipVersion(JSONVersion);
-                }
-                else //in order to get it to actually remind you later, I'm reverting the skip version to default
-                {
-                    slotSkipVersion("0");
-                }
-            }
-        }
-        else
+    if (appIsOutOfDate)
+    {
+        bool skipUpdate = slotReturnSkipUpdateBool(JSONVersion);
+        qDebug() << "manualUpdateCheck: " << manualUpdateCheck << "skipUpdate: " << skipUpdate;
+        if(manualUpdateCheck || !skipUpdate)
         {
-            qDebug() << "Editor version exceeds or matches kmi website";
-            if(manualUpdateCheck) //only display the dialog in this situation if we're checking manually
-            {
-                QString foundVersionString = versionMap.value("Editor").toString();
-                messageBoxText = QString("%1 is Up To Date.").arg(appName);
-                messageBoxText = QString("%1\n\nApplication Version: %2.%3.%4").arg(messageBoxText).arg(uchar(applicationVersion[0])).arg(uchar(applicationVersion[1])).arg(uchar(applicationVersion[2]));
-                messageBoxText = QString("%1\nKMI Website Version: %2").arg(messageBoxText).arg(foundVersionString);
-
-
-                m.setText(messageBoxText);
-                m.addButton("OK", QMessageBox::AcceptRole);
-                m.exec();
-                manualUpdateCheck = false;
-            }
+            QString updateMsg = versionMap.value("message").toString();
+            QString messageBoxText = QString("%1 version %2.%3.%4 is available.").arg(appName).arg(foundVersion[0]).arg(foundVersion[1]).arg(foundVersion[2]);
+            qDebug() << "update - updateMsg: " << updateMsg;
+            showUpdateBox(messageBoxText, updateMsg, JSONVersion);
         }
-
     }
     else
     {
-        qDebug() << "software update error:" << networkReply->error();
-        if(manualUpdateCheck) //only show the error if update is happening manually
+        qDebug() << "Editor version exceeds or matches kmi website";
+        if(manualUpdateCheck) //only display the dialog in this situation if we're checking manually
         {
-            messageBoxText = "An error occurred. Check your internet connection and try again.";
+            QString foundVersionString = versionMap.value("Editor").toString();
+            QString messageBoxText = QString("%1 is Up To Date.").arg(appName);
+            messageBoxText = QString("%1\n\nApplication Version: %2.%3.%4").arg(messageBoxText).arg(uchar(applicationVersion[0])).arg(uchar(applicationVersion[1])).arg(uchar(applicationVersion[2]));
+            messageBoxText = QString("%1\nKMI Website Version: %2").arg(messageBoxText).arg(foundVersionString);
 
-            m.setText(messageBoxText);
-            m.addButton("OK", QMessageBox::AcceptRole);
-            m.exec();
+            showMessageBox(messageBoxText);
         }
     }
 
     manualUpdateCheck = false;
 }
 
+// ****************************
+// Message boxes, non-modal
+// ****************************
+
+void KMI_Updates::showUpdateBox(QString text, QString detailedText, QString foundVersion)
+{
+    QMessageBox *m = new QMessageBox(QMessageBox::NoIcon, "Software Update", "", QMessageBox::NoButton, 0, Qt::Dialog);
+    m->setAttribute(Qt::WA_DeleteOnClose);
+
+    //m->setStyleSheet("QPushButton {font-family: \"Arial\";font-size: 10px;background-color: rgba(162, 0, 0, 255);border-style: outset;border-radius: 4.0;border-width: 1px;border-color: rgba(0, 51, 76, 255);color: white;} QPushButton:pressed {background-color: rgba(122, 0, 0, 255);} QPushButton:focus  outline: none;}");
+
+    m->setTextFormat(Qt::RichText);
+    m->setDetailedText(detailedText);
+    m->setText(text);
+    QPushButton *downloadButton = m->addButton("Download", QMessageBox::YesRole);
+    QPushButton *skipButton = m->addButton("Skip This Version", QMessageBox::NoRole);
+    m->addButton("Remind Me Later", QMessageBox::RejectRole);
+
+    connect(m, &QMessageBox::buttonClicked, this, [this, downloadButton, skipButton, foundVersion](QAbstractButton *button)
+    {
+        if (button == downloadButton)
+        {
+            slotGoToDownloadsPage();
+        }
+        else if (button == skipButton)
+        {
+            slotSkipVersion(foundVersion);
+        }
+        else //in order to get it to actually remind you later, I'm reverting the skip version to default
+        {
+            slotSkipVersion("0");
+        }
+    });
+
+    m->show();
+}
+
+void KMI_Updates::showMessageBox(QString text)
+{
+    QMessageBox *m = new QMessageBox(QMessageBox::NoIcon, "Software Update", text, QMessageBox::NoButton, 0, Qt::Dialog);
+    m->setAttribute(Qt::WA_DeleteOnClose);
+    m->addButton("OK", QMessageBox::AcceptRole);
+    m->show();
+}
+
+// ****************************
+// Manifest cache
+// ****************************
+
+// the newer of this editor's cache and the shared one
+KMI_Updates::UPDATE_CACHE KMI_Updates::loadCache()
+{
+    UPDATE_CACHE cache;
+    cache.manifest = sessionSettings->value("softwareUpdateManifest").toByteArray();
+    cache.eTag = sessionSettings->value("softwareUpdateETag").toByteArray();
+    cache.lastModified = sessionSettings->value("softwareUpdateLastModified").toByteArray();
+    cache.checkedAt = sessionSettings->value("softwareUpdateCheckedAt", 0).toLongLong();
+
+    QSettings shared(QSettings::IniFormat, QSettings::UserScope, UPDATE_CACHE_ORGANIZATION, UPDATE_CACHE_APPLICATION);
+    shared.beginGroup(sharedCacheGroup());
+    qint64 sharedCheckedAt = shared.value("checkedAt", 0).toLongLong();
+
+    if (sharedCheckedAt > cache.checkedAt && !shared.value("manifest").toByteArray().isEmpty())
+    {
+        cache.manifest = shared.value("manifest").toByteArray();
+        cache.eTag = shared.value("eTag").toByteArray();
+        cache.lastModified = shared.value("lastModified").toByteArray();
+        cache.checkedAt = sharedCheckedAt;
+    }
+
+    return cache;
+}
+
+void KMI_Updates::storeCache(const UPDATE_CACHE &cache)
+{
+    sessionSettings->setValue("softwareUpdateManifest", cache.manifest);
+    sessionSettings->setValue("softwareUpdateETag", cache.eTag);
+    sessionSettings->setValue("softwareUpdateLastModified", cache.lastModified);
+    sessionSettings->setValue("softwareUpdateCheckedAt", cache.checkedAt);
+
+    QSettings shared(QSettings::IniFormat, QSettings::UserScope, UPDATE_CACHE_ORGANIZATION, UPDATE_CACHE_APPLICATION);
+    shared.beginGroup(sharedCacheGroup());
+    shared.setValue("manifest", cache.manifest);
+    shared.setValue("eTag", cache.eTag);
+    shared.setValue("lastModified", cache.lastModified);
+    shared.setValue("checkedAt", cache.checkedAt);
+}
+
+// the url can't be a key, '/' nests groups
+QString KMI_Updates::sharedCacheGroup() const
+{
+    return QString::fromLatin1(QCryptographicHash::hash(jsonVersionURL.toUtf8(), QCryptographicHash::Md5).toHex());
+}
+
 bool KMI_Updates::slotReturnSkipUpdateBool(QString editorVersionFound)
 {
 
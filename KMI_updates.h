@@ -4,10 +4,34 @@
 #ifndef KMI_UPDATES_H
 #define KMI_UPDATES_H
 
+/* KMI Updates
+
+  Checks the version manifest (JSON, "Editor" and "message") at jsonVersionURL.
+
+  - the automatic check waits for the first device to connect (slotDeviceConnected, connect it
+    to MidiDeviceManager::signalConnected) or UPDATE_CHECK_FALLBACK_MS, so startup never waits
+    on TLS or the network
+  - the last manifest is cached with its ETag/Last-Modified in sessionSettings and in a cache
+    shared by every KMI editor on the machine, the newer one wins. Automatic checks younger
+    than UPDATE_CHECK_INTERVAL_S use it without a request, manual checks always ask the server
+    with If-None-Match/If-Modified-Since and a 304 reuses the cache
+  - requests are aborted after UPDATE_CHECK_TIMEOUT_MS
+  - the update box is non-modal, its buttons are handled when clicked
+
+*/
+
 #include <QtWidgets>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
+#define UPDATE_CHECK_INTERVAL_S     43200   // automatic checks reuse a manifest younger than this (12 h)
+#define UPDATE_CHECK_DEFER_MS       3000    // automatic check this long after the first device connects
+#define UPDATE_CHECK_FALLBACK_MS    60000   // ... or this long after startup if none does
+#define UPDATE_CHECK_TIMEOUT_MS     10000   // request aborted after this
+
+#define UPDATE_CACHE_ORGANIZATION   "KMI"
+#define UPDATE_CACHE_APPLICATION    "SoftwareUpdateCache" // shared by all editors, one group per manifest URL
+
 class KMI_Updates : public QWidget
 {
     Q_OBJECT
@@ -17,22 +41,44 @@ public:
 
     QWidget *parent;
     QSettings *sessionSettings;
-    QNetworkAccessManager *networkAccessManager;
+    QNetworkAccessManager *networkAccessManager; // created by the first request
     QByteArray applicationVersion;
     QString appName;
 
     QString jsonVersionURL;
 
     bool manualUpdateCheck;
+    bool autoUpdateCheckDone;     // the deferred automatic check ran, later ones are manual
 
 public slots:
 
     void slotManualCheckForUpdates();
     void slotCheckForUpdates();
+    void slotDeviceConnected(bool connected); // the first connect schedules the automatic check
     void slotUpdateCheckReply(QNetworkReply *networkReply);
     bool slotReturnSkipUpdateBool(QString editorVersionFound);
     void slotGoToDownloadsPage();
     void slotSkipVersion(QString versionToSkip);
+
+private slots:
+    void slotAutoCheckForUpdates();
+
+private:
+    typedef struct
+    {
+        QByteArray manifest;
+        QByteArray eTag;
+        QByteArray lastModified;
+        qint64 checkedAt;       // UTC seconds, 0 if nothing is cached
+    } UPDATE_CACHE;
+
+    UPDATE_CACHE loadCache();
+    void storeCache(const UPDATE_CACHE &cache);
+    QString sharedCacheGroup() const;
+
+    void processManifest(const QByteArray &manifest);
+    void showUpdateBox(QString text, QString detailedText, QString foundVersion);
+    void showMessageBox(QString text);
 };
 
 #endif // KMI_UPDATES_H
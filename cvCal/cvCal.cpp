@@ -20,6 +20,7 @@ cvCal::cvCal(QWidget *parent) :
     this->installEventFilter(this);
     ui->cv_cal_mode->installEventFilter(this);
 
+    resolveSpinBoxes();
     slotConnectElements();
     ui->no_focus->setFocus();
 
@@ -170,6 +171,27 @@ bool cvCal::eventFilter(QObject *obj, QEvent *event)
     return QObject::eventFilter(obj,event); // still process the eevent
 }
 
+void cvCal::resolveSpinBoxes()
+{
+    kmiSpinBoxUpDown *octaves[CVCalData::NumCVOuts][CVCalData::NumCVOctaves] =
+    {
+        { ui->cv1_008v, ui->cv1_1v, ui->cv1_2v, ui->cv1_3v, ui->cv1_4v, ui->cv1_5v },
+        { ui->cv2_008v, ui->cv2_1v, ui->cv2_2v, ui->cv2_3v, ui->cv2_4v, ui->cv2_5v }
+    };
+
+    for (int c = 0; c < cvCalData.NumCVOuts; c++)
+    {
+        for (int i = 0; i < cvCalData.NumCVOctaves; i++) octaveSpinBoxes[c][i] = octaves[c][i];
+
+        for (int i = 0; i < cvCalData.NumCVNotes; i++)
+        {
+            QString name = QString("cv%1_N_%2").arg(c+1).arg(i); // object name isn't 0 indexed
+            noteSpinBoxes[c][i] = this->findChild<kmiSpinBoxUpDown*>(name);
+            if (noteSpinBoxes[c][i] == nullptr) qDebug() << "ERROR: cvCal spinbox not found: " << name;
+        }
+    }
+}
+
 void cvCal::slotConnectElements()
 {
     // spinboxes
@@ -327,35 +349,28 @@ uint16_t cvCal::reverseBytes(uint16_t value) {
     return (value >> 8) | (value << 8);
 }
 
+// bulk update, signals blocked instead of disconnecting every spinbox and one repaint at the end
 void cvCal::slotUpdateUiVals()
 {
-    slotDisconnectElements();
-
-    ui->cv1_008v->setValue(cvCalData.data.octaves[CV_OUT1][0]);
-    ui->cv1_1v->setValue(cvCalData.data.octaves[CV_OUT1][1]);
-    ui->cv1_2v->setValue(cvCalData.data.octaves[CV_OUT1][2]);
-    ui->cv1_3v->setValue(cvCalData.data.octaves[CV_OUT1][3]);
-    ui->cv1_4v->setValue(cvCalData.data.octaves[CV_OUT1][4]);
-    ui->cv1_5v->setValue(cvCalData.data.octaves[CV_OUT1][5]);
-
-    ui->cv2_008v->setValue(cvCalData.data.octaves[CV_OUT2][0]);
-    ui->cv2_1v->setValue(cvCalData.data.octaves[CV_OUT2][1]);
-    ui->cv2_2v->setValue(cvCalData.data.octaves[CV_OUT2][2]);
-    ui->cv2_3v->setValue(cvCalData.data.octaves[CV_OUT2][3]);
-    ui->cv2_4v->setValue(cvCalData.data.octaves[CV_OUT2][4]);
-    ui->cv2_5v->setValue(cvCalData.data.octaves[CV_OUT2][5]);
+    setUpdatesEnabled(false);
 
     for (int c = 0; c < cvCalData.NumCVOuts; c++)
     {
+        for (int i = 0; i < cvCalData.NumCVOctaves; i++)
+        {
+            const QSignalBlocker blocker(octaveSpinBoxes[c][i]);
+            octaveSpinBoxes[c][i]->setValue(cvCalData.data.octaves[c][i]);
+        }
+
         for (int i = 0; i < cvCalData.NumCVNotes; i++)
         {
-            QString name = QString("cv%1_N_%2").arg(c+1).arg(i); // object name isn't 0 indexed
-            kmiSpinBoxUpDown* spinBox = this->findChild<kmiSpinBoxUpDown*>(name);
-            spinBox->setValue(cvCalData.data.notes[c][i]);
+            if (noteSpinBoxes[c][i] == nullptr) continue;
+            const QSignalBlocker blocker(noteSpinBoxes[c][i]);
+            noteSpinBoxes[c][i]->setValue(cvCalData.data.notes[c][i]);
         }
     }
 
-    slotConnectElements();
+    setUpdatesEnabled(true); // schedules a single repaint
 }
 
 void cvCal::slotParseDeviceCVCalibration(uint8_t *src, uint16_t length)
@@ -391,25 +406,11 @@ void cvCal::slotParseDeviceCVCalibration(uint8_t *src, uint16_t length)
     qDebug() << "cal_mode: " << calModeMap.key(cvCalData.data.cal_mode);
 
     /*
-     * Incoming 16bit data is ordered in the array MSB then LSB (0,60 = 60).
-     * First we test the endianness of our system for portability, then write
-     * to the correct pointer array that orders the incoming bytes correctly.
+     * Incoming 16bit data is ordered in the array MSB then LSB (0,60 = 60), octaves then notes,
+     * the same order as the words in cvCalData. One big endian copy covers both, qFromBigEndian
+     * only swaps on little endian hosts.
     */
-
-    if (cvCalData.systemIsLittleEndian())
-    {
-        for (int i = 0; i < length; i++)
-        {
-            *(cvCalData.data_bytestreamMSBthenLSB[i]) = *src++; // order the bytestream MSB first
-        }
-    }
-    else
-    {
-        for (int i = 0; i < length; i++)
-        {
-            *(cvCalData.data_bytestreamLSBthenMSB[i]) = *src++; // flip lsb/msb order for big endian systems
-        }
-    }
+    qFromBigEndian<uint16_t>(src, length / 2, &cvCalData.data.raw[CVCalData::NumHeaderBytes]);
 
     slotUpdateUiVals();
 }
@@ -446,27 +447,16 @@ void cvCal::slotUpdateCVcalData()
         cvCalData.data.cal_mode = CV_CAL_MODE_NOTES;
     }
 
-    cvCalData.data.octaves[CV_OUT1][0] = (ui->cv1_008v->value());
-    cvCalData.data.octaves[CV_OUT1][1] = (ui->cv1_1v->value());
-    cvCalData.data.octaves[CV_OUT1][2] = (ui->cv1_2v->value());
-    cvCalData.data.octaves[CV_OUT1][3] = (ui->cv1_3v->value());
-    cvCalData.data.octaves[CV_OUT1][4] = (ui->cv1_4v->value());
-    cvCalData.data.octaves[CV_OUT1][5] = (ui->cv1_5v->value());
-
-    cvCalData.data.octaves[CV_OUT2][0] = (ui->cv2_008v->value());
-    cvCalData.data.octaves[CV_OUT2][1] = (ui->cv2_1v->value());
-    cvCalData.data.octaves[CV_OUT2][2] = (ui->cv2_2v->value());
-    cvCalData.data.octaves[CV_OUT2][3] = (ui->cv2_3v->value());
-    cvCalData.data.octaves[CV_OUT2][4] = (ui->cv2_4v->value());
-    cvCalData.data.octaves[CV_OUT2][5] = (ui->cv2_5v->value());
-
     for (int c = 0; c < cvCalData.NumCVOuts; c++)
     {
+        for (int i = 0; i < cvCalData.NumCVOctaves; i++)
+        {
+            cvCalData.data.octaves[c][i] = octaveSpinBoxes[c][i]->value();
+        }
+
         for (int i = 0; i < cvCalData.NumCVNotes; i++)
         {
-            QString name = QString("cv%1_N_%2").arg(c+1).arg(i); // object name isn't 0 indexed
-            kmiSpinBoxUpDown* spinBox = this->findChild<kmiSpinBoxUpDown*>(name);
-            cvCalData.data.notes[c][i] = spinBox->value();
+            if (noteSpinBoxes[c][i] != nullptr) cvCalData.data.notes[c][i] = noteSpinBoxes[c][i]->value();
         }
     }
 }
@@ -483,20 +473,8 @@ void cvCal::slotSendCalibrationData()
     txPayload[payloadIndex++] = cvCalData.data.version;
     txPayload[payloadIndex++] = cvCalData.data.cal_mode;
 
-    if (cvCalData.systemIsLittleEndian())
-    {
-        for (int i = 0; i < cvCalData.arraySize - 2; i++)
-        {
-            txPayload[payloadIndex++] = *(cvCalData.data_bytestreamMSBthenLSB[i]); // prep the bytestream
-        }
-    }
-    else
-    {
-        for (int i = 0; i < cvCalData.arraySize - 2; i++)
-        {
-            txPayload[payloadIndex++] = *(cvCalData.data_bytestreamLSBthenMSB[i]); // reverse MSB/LSB order for big endian systems
-        }
-    }
+    // the words go out MSB then LSB, in cvCalData order
+    qToBigEndian<uint16_t>(&cvCalData.data.raw[payloadIndex], (cvCalData.arraySize - payloadIndex) / 2, &txPayload[payloadIndex]);
 
     emit signalSendStepSXPacket(MSG_CAT_CALIBRATION, CV_CAL_PAYLOAD, &txPayload[0], cvCalData.arraySize);
 
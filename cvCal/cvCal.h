@@ -37,6 +37,7 @@ enum
     CV_CAL_MODE_NOTES
 };
 
+#pragma pack(push, 1) // PACK_INLINE is empty on Windows, kmiSysEx.h no longer leaves pack(1) set
 typedef struct
 {
     int8_t version;
@@ -44,6 +45,7 @@ typedef struct
     uint16_t octaves[NUM_CV_OUTS][NUM_CV_OCTAVES];
     uint16_t notes[NUM_CV_OUTS][NUM_CV_NOTES];
 } PACK_INLINE CV_CALIBRATION;
+#pragma pack(pop)
 
 typedef struct {
     uint8_t data[278];
@@ -107,6 +109,12 @@ public slots:
 private:
     Ui::cvCal *ui;
 
+    // resolved once after setupUi, indexed like cvCalData.data.octaves/notes
+    kmiSpinBoxUpDown *octaveSpinBoxes[CVCalData::NumCVOuts][CVCalData::NumCVOctaves];
+    kmiSpinBoxUpDown *noteSpinBoxes[CVCalData::NumCVOuts][CVCalData::NumCVNotes];
+
+    void resolveSpinBoxes();
+
 protected:
     void closeEvent(QCloseEvent *event) override;
     bool eventFilter(QObject *obj, QEvent *event) override;
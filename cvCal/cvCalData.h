@@ -65,44 +65,12 @@ public:
     } data;
 
 
-    uint8_t *data_bytestreamMSBthenLSB[arraySize];
-    uint8_t *data_bytestreamLSBthenMSB[arraySize];
-
+    // the device sends and expects the words MSB first, see qFromBigEndian/qToBigEndian in cvCal
     explicit CVCalData()
     {
         // initialize header
         data.version = -1; // version not set
         data.cal_mode = 0; // 0 = CV_CAL_MODE_FACTORY
-
-        // setup pointers
-        int iMtL = 0;
-        int iLtM = 0;
-
-        // octaves
-        for (uint8_t cv = 0; cv < NumCVOuts; cv++)
-        {
-            for (uint8_t octave = 0; octave < NumCVOctaves; octave++)
-            {
-                data_bytestreamMSBthenLSB[iMtL++] = &data.LE.octaves[cv][octave].byte.msb; // the byte stream rx has the msb first
-                data_bytestreamMSBthenLSB[iMtL++] = &data.LE.octaves[cv][octave].byte.lsb;
-
-                data_bytestreamLSBthenMSB[iLtM++] = &data.BE.octaves[cv][octave].byte.lsb;
-                data_bytestreamLSBthenMSB[iLtM++] = &data.BE.octaves[cv][octave].byte.msb;
-            }
-        }
-
-        // notes
-        for (uint8_t cv = 0; cv < NumCVOuts; cv++)
-        {
-            for (uint8_t note = 0; note < NumCVNotes; note++)
-            {
-                data_bytestreamMSBthenLSB[iMtL++] = &data.LE.notes[cv][note].byte.msb;
-                data_bytestreamMSBthenLSB[iMtL++] = &data.LE.notes[cv][note].byte.lsb;
-
-                data_bytestreamLSBthenMSB[iLtM++] = &data.BE.notes[cv][note].byte.lsb;
-                data_bytestreamLSBthenMSB[iLtM++] = &data.BE.notes[cv][note].byte.msb;
-            }
-        }
     }
 
     bool systemIsLittleEndian() const {
@@ -20,159 +20,263 @@ KMI_Decode::KMI_Decode()
 
 void KMI_Decode::slotDecodePacket(QByteArray sysExBA)
 {
-    uint8_t msgPID;
+    slotDecodeBytes(reinterpret_cast<const unsigned char*>(sysExBA.constData()), sysExBA.length());
+}
 
-    uint16_t decodeIndex = 0; // index of the raw encoded data
-    uint16_t length = sysExBA.length();; // length of encoded data
+void KMI_Decode::setPayloadBuffer(uint8_t *buffer, uint32_t capacity)
+{
+    payloadExternal = buffer;
+    payloadCapacity = buffer ? capacity : 0;
+    decodeReset(); // a message in progress was in the old buffer
+}
 
-    PACKET_PREAMBLE preamble; // buffer for preamble
-    PACKET_PAYLOAD payload; // data goes here
+void KMI_Decode::decodeReset(void)
+{
+    decodeState = SX_DECODE_IDLE;
+    awaitingContinuation = false;
+    payloadLength = 0;
+    core_sx_packet_init();
+}
 
-    memset(&preamble, 0, sizeof(PACKET_PREAMBLE));
-    memset(&payload, 0, sizeof(PACKET_PAYLOAD));
+void KMI_Decode::decodeError(const char *error)
+{
+    qDebug() << "ERROR:" << error << " - category: " << preamble.packet.category << " type: " << preamble.packet.type << " payload: " << payloadLength;
+    decodeReset();
+    decodeState = SX_DECODE_IGNORE; // skip the rest of this frame
+}
 
-    // verify KMI sysex
-    char packetTypeHeader[] = {kmi_id_1, kmi_id_2, kmi_id_3};
-    //F0 00 01 5F 19 PID_MSB PID_LSB
+bool KMI_Decode::payloadAppend(uint8_t val)
+{
+    if (payloadExternal)
+    {
+        if (payloadLength >= payloadCapacity) return false;
+        payloadExternal[payloadLength++] = val;
+        return true;
+    }
 
-    //qDebug() << "sysex id1: " << (uchar)sysExBA[1] << "id2: " << (uchar)sysExBA[2] << "id3: " << (uchar)sysExBA[3];
-    if(sysExBA.indexOf(QByteArray(packetTypeHeader, 2)) != 1)
+    if (payloadLength >= payloadPool.size())
     {
-        return; // this is not a kmi packet
+        payloadPool.resize(payloadPool.size() ? payloadPool.size() * 2 : MAX_SX_BUFFER_SIZE);
     }
+    payloadPool[payloadLength++] = val;
+    return true;
+}
 
-    decodeIndex = 5;
-    // get PID
-    msgPID = sysExBA[decodeIndex++]; // search for decode start after PID
-    //qDebug() << "sysex PID: " << msgPID;
+// *************************************************
+// slotDecodeBytes - feed raw sysex bytes, F0 to F7 or any part of it
+// *************************************************
+void KMI_Decode::slotDecodeBytes(const unsigned char *bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        decodeFrameByte(bytes[i]);
+    }
+}
 
-    core_sx_packet_init(); // handles CRC and 8bit decode
+void KMI_Decode::decodeFrameByte(uint8_t raw)
+{
+    if (raw == MIDI_SX_START)
+    {
+        if (decodeState != SX_DECODE_IDLE && decodeState != SX_DECODE_DONE && !awaitingContinuation)
+        {
+            qDebug("ERROR: sysex start inside a kmi frame, dropping the partial message\n");
+            decodeReset();
+        }
+        decodeState = SX_DECODE_HEADER;
+        frameIndex = 1;
+        return;
+    }
 
-    while((uchar)sysExBA[decodeIndex++] != 1) // wait for decode start (1)
+    if (raw == MIDI_SX_STOP)
     {
-        if (decodeIndex >= length)
+        if (decodeState == SX_DECODE_DATA && awaitingContinuation && packetIndex < SX_ENCODE_LEN)
         {
-            qDebug("ERROR: decodeIndex > length while waiting for decode start, returning\n");
-            return; // error
+            // the frame ended between packets, whatever was decoded after the tail is flush padding
+            bool padding = true;
+            for (uint32_t i = payloadLength - packetIndex; i < payloadLength; i++)
+            {
+                if ((payloadExternal ? payloadExternal[i] : payloadPool[i]) != 0) padding = false;
+            }
+            if (padding)
+            {
+                payloadLength -= packetIndex;
+                packetIndex = 0;
+                crc_init();
+                decodeState = SX_DECODE_IDLE; // the next kmi frame continues the message
+                return;
+            }
         }
-        if ((uchar)sysExBA[decodeIndex] == MIDI_SX_STOP)
+        if (decodeState > SX_DECODE_WAIT_START && decodeState != SX_DECODE_DONE)
         {
             qDebug("ERROR: unexpected end of sysex, returning\n");
-            return; // error
+            decodeReset();
         }
+        decodeState = SX_DECODE_IDLE;
+        return;
     }
 
-    uint16_t core_sx_count = 0; // index of the decoded data, start at 0
-
-    while(decodeIndex < length)
+    if (raw >= MIDI_RT_CLOCK) return; // realtime can be interleaved with sysex
+    if (raw & 0x80)
     {
+        decodeError("status byte inside sysex");
+        decodeState = SX_DECODE_IDLE;
+        return;
+    }
 
-        val = sysExBA[decodeIndex++];
-        //qDebug() << "Input: " << val << " decodeIndex: " << decodeIndex << " length: " << length << "\n";
-
-        midi_sx_decode_put(val); // put 8 bytes into the buffer
-
-        while(midi_sx_decode_get(&val)) // on the 8th byte we decode the previous 7
+    switch (decodeState)
+    {
+    case SX_DECODE_HEADER:
+        //F0 00 01 5F 19 PID_MSB PID_LSB
+        if ((frameIndex == 1 && raw != kmi_id_1) || (frameIndex == 2 && raw != kmi_id_2))
         {
-            // check CRC
-            if ( core_sx_count < 4 || // the first 4 bytes are msgCategory, msgType, length msg, length lsb
-                ( core_sx_count >= SX_PREAMBLE_SIZE_CRC && // don't CRC bytes 4 and 5 (preamble crc)
-                  (payload.index < payload.length) ) )  // or the two bytes after the payload (data crc)
-            {
-                //int pre_crc = crc;
-                crc_byte(val);
-                //qDebug() << "crc pre: " << pre_crc <<" post: " << crc << " val: " << val;
-            }
-
-            if (core_sx_count < SX_PREAMBLE_SIZE_CRC)
-            {
-                preamble.raw[core_sx_count++] = val; // store preamble
-            }
-            else if (payload.index < payload.length)
+            decodeState = SX_DECODE_IGNORE; // this is not a kmi packet, a continuation can still follow
+            return;
+        }
+        if (frameIndex == SX_HEADER_PID_INDEX)
+        {
+            msgPID = raw;
+            decodeState = SX_DECODE_WAIT_START;
+        }
+        frameIndex++;
+        break;
+    case SX_DECODE_WAIT_START:
+        if (raw == 1) // decode start
+        {
+            sx_decode_init();
+            if (awaitingContinuation)
             {
-                //qDebug() << "payload[" << payload.index << "/" << payload.length << "]: " << val << " core_sx_count: " << core_sx_count << " crc: " << crc;
-                payload.data[payload.index++] = val; // store data
-                core_sx_count++; // keep incrementing this
+                decodeState = SX_DECODE_DATA; // next data packet of the same message
             }
-            else if (payload.crc.index == 0)
+            else
             {
-                payload.crc.MSB = val;
-                payload.crc.index++;
-                //qDebug() << "payload.crc.MSB: " << payload.crc.MSB << " crc: " << crc;
+                crc_init();
+                payloadLength = 0;
+                preambleIndex = 0;
+                decodeState = SX_DECODE_PREAMBLE;
             }
-            else if (payload.crc.index == 1)
+        }
+        break;
+    case SX_DECODE_PREAMBLE:
+    case SX_DECODE_DATA:
+    case SX_DECODE_TAIL:
+        val = raw;
+        midi_sx_decode_put(val); // put 8 bytes into the buffer
+        while (midi_sx_decode_get(&val)) // on the 8th byte we decode the previous 7
+        {
+            decodeByte(val);
+        }
+        break;
+    default: // idle, ignore, done
+        break;
+    }
+}
+
+// one decoded 8 bit byte
+void KMI_Decode::decodeByte(uint8_t val)
+{
+    switch (decodeState)
+    {
+    case SX_DECODE_PREAMBLE:
+        if (preambleIndex < 4) crc_byte(val); // msgCategory, msgType, length msb, length lsb
+        preamble.raw[preambleIndex++] = val;
+
+        if (preambleIndex == SX_PREAMBLE_SIZE_CRC) // 6 bytes, last two are CRC msb/lsb
+        {
+            uint16_t lengthWithTail = get16bit(preamble.raw[2], preamble.raw[3]);
+            uint16_t preambleCRC = get16bit(preamble.raw[4], preamble.raw[5]);
+
+            qDebug() <<	"msgCategory: " << preamble.packet.category <<
+                    " msgType: " << preamble.packet.type <<
+                    " length: " << lengthWithTail <<
+                    " preambleCRC: " << preambleCRC <<
+                    "\n";
+            if (crc != preambleCRC)
             {
-                payload.crc.LSB = val;
-                payload.crc.index++;
-                //qDebug() << "payload.crc.LSB: " << payload.crc.LSB << " crc: " << crc;
+                decodeError("preambleCRC fail!");
+                return;
             }
-            else
+            if (lengthWithTail < TAIL_LEN)
             {
-                qDebug() << "ERROR: payload overrun!";
-
+                decodeError("preamble length is shorter than the packet tail");
                 return;
             }
+            crc_init();
+
+            awaitingContinuation = false;
+            packetLength = lengthWithTail - TAIL_LEN;
+            packetIndex = 0;
+            tailIndex = 0;
 
-            if (core_sx_count == 4) // just received length
+            if (packetLength == 0) // no data packets follow
             {
-                preamble.packet.dataLength_with_preamble = reverseBytes(preamble.packet.dataLength_with_preamble); // fix endienness
-                payload.length = preamble.packet.dataLength_with_preamble;
-                preamble.packet.dataLength_with_preamble += SX_PREAMBLE_SIZE_CRC;
+                decodeState = SX_DECODE_DONE;
+                emit signalRxKMIPacketData(msgPID, preamble.packet.category, preamble.packet.type, nullptr, 0);
+                emit signalRxKMIPacket(msgPID, preamble.packet.category, preamble.packet.type, nullptr, 0);
+                return;
             }
+            decodeState = SX_DECODE_DATA;
+        }
+        break;
+    case SX_DECODE_DATA:
+        if (!payloadAppend(val))
+        {
+            decodeError("payload buffer overrun!");
+            return;
+        }
+        if (++packetIndex == packetLength)
+        {
+            // crc the packet in one pass now that it is complete
+            const uint8_t *payload = payloadExternal ? payloadExternal : payloadPool.data();
+            crc = kmi_crc16(crc, payload + payloadLength - packetLength, packetLength);
+
+            tailIndex = 0;
+            decodeState = SX_DECODE_TAIL;
+        }
+        break;
+    case SX_DECODE_TAIL:
+        if (tailIndex < 2) crc_byte(val); // next length is covered by the data crc, the crc itself isn't
+        tail[tailIndex++] = val;
 
-            //qDebug() << "decode - val: " << val << " crc: " << crc << " core_sx_count: " << core_sx_count << " decodeIndex: " << decodeIndex;
+        if (tailIndex == TAIL_LEN)
+        {
+            uint16_t nextLength = get16bit(tail[0], tail[1]);
+            uint16_t dataCRC = get16bit(tail[2], tail[3]);
 
-            if (core_sx_count == SX_PREAMBLE_SIZE_CRC) // 6 bytes, last two are CRC msb/lsb
+            if (dataCRC != crc)
             {
-                preamble.packet.crc = reverseBytes(preamble.packet.crc); // fix endienness
-
-                qDebug() <<	"msgCategory: " << preamble.packet.category <<
-                        " msgType: " << preamble.packet.type <<
-                        " payload.lngth: " << payload.length <<
-                        " dataLength_with_preamble: " << preamble.packet.dataLength_with_preamble <<
-                        " preambleCRC: " << preamble.packet.crc <<
-                        "\n";
-                if (crc != preamble.packet.crc)
-                {
-                    qDebug("ERROR: preambleCRC fail!\n");
-                    return;
-                }
-                //qDebug("preambleCRC pass!\n");
-                crc_init();
-
+                decodeError("Payload CRC Fail!");
+                return;
             }
-            else if (payload.crc.index) // look for end of payload
+
+            if (nextLength == 0) // last packet, message complete
             {
-                // payload finished
+                sx_decode_init(); // stop decoding
+                decodeState = SX_DECODE_DONE;
+                awaitingContinuation = false;
 
-                if (payload.crc.index == 2) // last message
-                {
-                    payload.crc.index++;
-                    //payload.crc.LSB = val;
-                    payload.crc.whole = get16bit(payload.crc.MSB, payload.crc.LSB);
-                    //qDebug() << "crc.index: " << payload.crc.index << " payload.CRC: " << payload.crc.whole << " payload.crc.MSB: " << payload.crc.MSB << " payload.crc.LSB: " << payload.crc.LSB << " crc: " << crc << "\n";
-                    if (payload.crc.whole == crc)
-                    {
-                        //qDebug("Payload CRC pass, emitting message signal!\n");
-                        sx_decode_init(); // stop decoding
-                        emit signalRxKMIPacket(msgPID, preamble.packet.category, preamble.packet.type, &payload.data[0], payload.length);
-                        return;
-                    }
-                    else
-                    {
-                        qDebug("ERROR: Payload CRC Fail!\n");
-                        sx_decode_init(); // stop decoding
-                        return;
-                    }
-                }
-                else if (payload.crc.index > 2)
+                uint8_t *payload = payloadExternal ? payloadExternal : payloadPool.data();
+                emit signalRxKMIPacketData(msgPID, preamble.packet.category, preamble.packet.type, payload, payloadLength);
+                if (payloadLength <= 0xFFFF)
                 {
-                    payload.crc.index++;
-                    qDebug() << "ERROR: byte rx after payload - crc.Index: " << payload.crc.index << " val: " << val << " core_sx_count: " << core_sx_count << " decodeIndex: " << decodeIndex << "\n";;
+                    emit signalRxKMIPacket(msgPID, preamble.packet.category, preamble.packet.type, payload, payloadLength);
                 }
+                payloadLength = 0;
+                return;
+            }
+            if (nextLength <= TAIL_LEN)
+            {
+                decodeError("next packet length is shorter than the packet tail");
+                return;
             }
+
+            // another data packet follows, here or in the next frame
+            crc_init();
+            packetLength = nextLength - TAIL_LEN;
+            packetIndex = 0;
+            awaitingContinuation = true;
+            decodeState = SX_DECODE_DATA;
         }
-        //qDebug() << "finished midi_sx_decode_get, decodeIndex: " << decodeIndex << " length: " << length;
+        break;
     }
 }
 
@@ -198,16 +302,18 @@ void KMI_Decode::sx_decode_init(void) {
 void KMI_Decode::midi_sx_decode_put(unsigned char val)
 {
     core_sx_decode.buf[core_sx_decode.index_in++] = val;
+
+    if (core_sx_decode.index_in==SX_ENCODE_LEN+1)
+    {
+        kmi_sx_decode_group(core_sx_decode.buf, core_sx_decode.decoded); // whole group at once
+    }
 }
 
 uint8_t KMI_Decode::midi_sx_decode_get(unsigned char *val)
 {
     if (core_sx_decode.index_in==SX_ENCODE_LEN+1)
     {
-        *val = core_sx_decode.buf[core_sx_decode.index_out++];
-        if (core_sx_decode.buf[SX_ENCODE_LEN] & 1)
-            *val |= 0x80;
-        core_sx_decode.buf[SX_ENCODE_LEN] >>=1;
+        *val = core_sx_decode.decoded[core_sx_decode.index_out++];
         if (core_sx_decode.index_out==SX_ENCODE_LEN)
         {
             sx_decode_init();
@@ -218,37 +324,13 @@ uint8_t KMI_Decode::midi_sx_decode_get(unsigned char *val)
 }
 
 void KMI_Decode::crc_init(void) {
-    crc = 0xffff;
+    crc = KMI_CRC16_INIT;
 }
 
-void KMI_Decode::crc_byte(char val)
+void KMI_Decode::crc_byte(uint8_t val)
 {
-    uint16_t temp;
-    uint16_t quick;
-
-    temp = (crc >> 8) ^ val;
-    crc <<= 8;
-    quick = temp ^ (temp >> 4);
-    crc ^= quick;
-    quick <<= 5;
-    crc ^= quick;
-    quick <<= 7;
-    crc ^= quick;
-}
-
-//void SysexData::crc_byte(char val)   {
-//        unsigned short temp;
-//        unsigned short quick;
-
-//        temp = (crc >> 8) ^ val;
-//        crc <<= 8;
-//        quick = temp ^ (temp >> 4);
-//        crc ^= quick;
-//        quick <<= 5;
-//        crc ^= quick;
-//        quick <<= 7;
-//        crc ^= quick;
-//}
+    crc = kmi_crc16_byte(crc, val);
+}
 
 // **************************************
 // functions below encode 8bits to 7 bits
@@ -280,17 +362,34 @@ void KMI_Encode::midi_sx_header()
 
 void KMI_Encode::midi_sx_data_crc(void *data,unsigned short length)
 {
+    unsigned char *bytes = (unsigned char *) data;
     int i;
 
-    for(i=0;i<length;i++)
+    crc = kmi_crc16(crc, bytes, length); // whole payload at once
+
+    // finish the group the preamble started one byte at a time, then whole groups at once
+    i = 0;
+    while (i < length && midi_hi_count)
+    {
+        midi_sx_encode_char(bytes[i++]);
+    }
+
+    int groups = (length - i) / SX_ENCODE_LEN;
+    if (groups)
     {
-        midi_sx_encode_crc_char( ((unsigned char *) data)[i]);
+        msgIndex += kmi_sx_encode(&bytes[i], groups * SX_ENCODE_LEN, &msg[msgIndex]);
+        i += groups * SX_ENCODE_LEN;
+    }
+
+    while (i < length)
+    {
+        midi_sx_encode_char(bytes[i++]);
     }
 }
 
 void KMI_Encode::midi_sx_packet_data(void *source,unsigned short length)
 {
-    crc = 0xffff; // init crc
+    crc_init();
     midi_sx_data_crc(source,length);
 }
 
@@ -303,7 +402,7 @@ void KMI_Encode::midi_sx_packet_data_close(unsigned short length)
 
 void KMI_Encode::midi_sx_packet_preamble(unsigned short packet_type,unsigned short length)
 {
-    crc = 0xffff; // init crc
+    crc_init();
 
     msg[msgIndex++] = (0x01); // indicate we are about to begin encoding
     midi_chunk_init(); // being 8bit->7bit encoding
@@ -378,20 +477,10 @@ void KMI_Encode::midi_sx_flush(void)
 }
 
 void KMI_Encode::crc_init(void) {
-    crc = 0xffff;
+    crc = KMI_CRC16_INIT;
 }
 
-void KMI_Encode::crc_byte(char val)
+void KMI_Encode::crc_byte(uint8_t val)
 {
-    uint16_t temp;
-    uint16_t quick;
-
-    temp = (crc >> 8) ^ val;
-    crc <<= 8;
-    quick = temp ^ (temp >> 4);
-    crc ^= quick;
-    quick <<= 5;
-    crc ^= quick;
-    quick <<= 7;
-    crc ^= quick;
+    crc = kmi_crc16_byte(crc, val);
 }
@@ -5,21 +5,27 @@
 #define KMISYSEX_H
 
 #include <QByteArray>
+#include <vector>
 #include <KMI_mdm.h>
 #include <midi.h>
+#include "kmiSysExCodec.h"
+#include "kmiSysExCrc.h"
 
 // constants
 
 //---- OS DEFINES
-#ifndef Q_OS_MAC
+#if defined(Q_OS_WIN)
 #include <windows.h>
 #define	PACK_INLINE
 #define	stricmp	_stricmp
 #define CASE_CMP(v1,v2) stricmp(v1,v2)
 #define	snprintf	sprintf_s
 //#define vsnprintf	vsprintf_s
-#pragma pack(1)
-#else
+#elif defined(Q_OS_MAC)
+#define	PACK_INLINE __attribute__ ((packed))
+#define CASE_CMP(v1,v2) strcasecmp(v1,v2)
+#else // Linux
+#include <strings.h>
 #define	PACK_INLINE __attribute__ ((packed))
 #define CASE_CMP(v1,v2) strcasecmp(v1,v2)
 #endif
@@ -31,6 +37,8 @@
 #define MAX_SX_BUFFER_SIZE 1024
 #define	TAIL_LEN	4 // length[msb/lsb], crc[msb/lsb]
 
+// wire structs only, the pack must not leak into the headers included after this one
+#pragma pack(push, 1)
 
 typedef union {
     unsigned char raw[6];
@@ -58,14 +66,48 @@ typedef struct
     uint8_t data[MAX_SX_BUFFER_SIZE];
 } PACK_INLINE PACKET_PAYLOAD;
 
+#pragma pack(pop)
 
 
-class KMI_Decode : public QWidget
+
+// streaming decoder states, see KMI_Decode::slotDecodeBytes
+enum
+{
+    SX_DECODE_IDLE,         // waiting for F0
+    SX_DECODE_IGNORE,       // not a kmi frame, skip to F7
+    SX_DECODE_HEADER,       // manufacturer id and PID
+    SX_DECODE_WAIT_START,   // waiting for the 0x01 encode start marker
+    SX_DECODE_PREAMBLE,     // category, type, length, preamble crc
+    SX_DECODE_DATA,         // payload bytes of the current data packet
+    SX_DECODE_TAIL,         // next packet length and data crc
+    SX_DECODE_DONE          // message emitted, skip the flush padding to F7
+};
+
+#define SX_HEADER_PID_INDEX 5 // F0 id1 id2 id3 PID_MSB PID_LSB
+
+/* KMI Decode
+
+  Incremental decoder for KMI sysex packets. Bytes can be fed in any split, across as many
+  RtMidi callbacks as needed, the state is kept between calls.
+
+  - chained data packets are decoded, each packet tail carries the length of the next one
+    (see KMI_Encode::midi_sx_packet_data_close) and the payloads are joined into one message
+  - if a frame ends (F7) right after a tail that announced another packet, the next kmi frame
+    continues the same message, the flush padding before that F7 is dropped
+  - the payload goes into a reused internal buffer unless the caller supplies one with
+    setPayloadBuffer, there is no size cap on the internal buffer
+
+*/
+class KMI_Decode : public QObject
 {
     Q_OBJECT
 public:
     KMI_Decode();
 
+    // decode into the caller's buffer instead of the internal one, nullptr to go back
+    void setPayloadBuffer(uint8_t *buffer, uint32_t capacity);
+    void decodeReset(void);
+
     // decode 7bit->8bit
     uint16_t get16bit(uint8_t msb, uint8_t lsb);
     void core_sx_packet_init(void);
@@ -75,26 +117,49 @@ public:
     uint8_t midi_sx_decode_get(unsigned char *val);
 
     void crc_init(void);
-    void crc_byte(char val);
+    void crc_byte(uint8_t val);
 
 signals:
-    void signalRxKMIPacket(uint8_t PID, uint8_t category, uint8_t type, uint8_t *ptr, uint16_t length);
+    void signalRxKMIPacket(uint8_t PID, uint8_t category, uint8_t type, uint8_t *ptr, uint16_t length); // only for payloads up to 64k
+    void signalRxKMIPacketData(uint8_t PID, uint8_t category, uint8_t type, uint8_t *ptr, uint32_t length); // every payload
 
 
 public slots:
-    void slotDecodePacket(QByteArray sysExBA);
+    void slotDecodePacket(QByteArray sysExBA); // one complete frame
+    void slotDecodeBytes(const unsigned char *bytes, size_t length); // any part of a frame
 
 
 private:
-
+    void decodeFrameByte(uint8_t raw);
+    void decodeByte(uint8_t val);
+    void decodeError(const char *error);
+    bool payloadAppend(uint8_t val);
 
     uint16_t crc = 0;
 
+    int decodeState = SX_DECODE_IDLE;
+    uint32_t frameIndex = 0;            // raw bytes since F0
+    bool awaitingContinuation = false;  // a tail announced another packet, it may be in the next frame
+
+    uint8_t msgPID = 0;
+    PACKET_PREAMBLE preamble;
+    uint8_t preambleIndex = 0;
+    uint32_t packetLength = 0;          // data bytes in the current packet
+    uint32_t packetIndex = 0;
+    uint8_t tail[TAIL_LEN];
+    uint8_t tailIndex = 0;
+
+    std::vector<uint8_t> payloadPool;   // reused between messages, keeps its capacity
+    uint8_t *payloadExternal = nullptr;
+    uint32_t payloadCapacity = 0;
+    uint32_t payloadLength = 0;
+
     struct
     {
         unsigned char 	index_in,
                         index_out,
-                        buf[SX_ENCODE_LEN+1];
+                        buf[SX_ENCODE_LEN+1],
+                        decoded[SX_ENCODE_LEN]; // buf converted in one go once all 8 bytes are in
     } core_sx_decode;
 
     uint8_t val = 0; // need to rename this
@@ -106,7 +171,7 @@ private:
 };
 
 
-class KMI_Encode : public QWidget
+class KMI_Encode : public QObject
 {
     Q_OBJECT
 public:
@@ -134,7 +199,7 @@ public:
 
     // crc
     void crc_init(void);
-    void crc_byte(char val);
+    void crc_byte(uint8_t val);
 
 signals:
     void signalSendSysExBA(QByteArray);
@@ -156,7 +221,7 @@ private:
 
 };
 
-class kmiSysEx : public QWidget
+class kmiSysEx : public QObject
 {
     Q_OBJECT
 public:
@@ -0,0 +1,291 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMISYSEXCODEC_H
+#define KMISYSEXCODEC_H
+
+/* KMI SysEx Codec
+
+  Shared 8bit <-> 7bit packing used by KMI_Encode, KMI_Decode and MidiDeviceManager::decode8BitArray.
+
+  Layout of one group, 7 data bytes followed by one byte holding their high bits:
+
+    d0&0x7F d1&0x7F d2&0x7F d3&0x7F d4&0x7F d5&0x7F d6&0x7F [bit0 = d0 bit7 ... bit6 = d6 bit7]
+
+  - whole groups are converted as 64 bit words, the high bits are spread/gathered with a
+    multiply instead of a loop (none of the partial products overlap so there are no carries)
+  - SSE2 and NEON paths are used for large buffers, the scalar word path is the fallback
+  - kmi_sx_codec_selftest checks every path against the byte at a time reference and fixed vectors
+
+  Header only, no Qt dependency.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KMI_SX_CODEC_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define KMI_SX_CODEC_NEON
+#endif
+
+#define KMI_SX_GROUP_IN     7   // 8 bit bytes per group
+#define KMI_SX_GROUP_OUT    8   // 7 bit bytes per group
+#define KMI_SX_SIMD_MIN     64  // buffers shorter than this stay on the scalar path
+
+#define KMI_SX_SPREAD_MUL   (0x0002040810204081ULL << 7) // hi bit i -> bit 7 of byte i
+#define KMI_SX_GATHER_MUL   0x0002040810204080ULL        // bit 7 of byte i -> bit 56 + i
+#define KMI_SX_HI_MASK      0x0080808080808080ULL        // bit 7 of data bytes 0-6
+#define KMI_SX_LO_MASK      0x007F7F7F7F7F7F7FULL        // low 7 bits of data bytes 0-6
+
+// little endian word access regardless of host order
+static inline uint64_t kmi_sx_load64(const uint8_t *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+#else
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+#endif
+}
+
+static inline void kmi_sx_store64(uint8_t *p, uint64_t v, size_t count)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; i++) p[i] = (uint8_t)(v >> (8 * i));
+#else
+    memcpy(p, &v, count);
+#endif
+}
+
+// number of 7 bit bytes needed for length 8 bit bytes, the last group is zero padded
+static inline size_t kmi_sx_encoded_size(size_t length)
+{
+    return (length + KMI_SX_GROUP_IN - 1) / KMI_SX_GROUP_IN * KMI_SX_GROUP_OUT;
+}
+
+// number of 8 bit bytes decoded from length 7 bit bytes, see kmi_sx_decode for a partial group
+static inline size_t kmi_sx_decoded_size(size_t length)
+{
+    return length / KMI_SX_GROUP_OUT * KMI_SX_GROUP_IN + length % KMI_SX_GROUP_OUT;
+}
+
+// ----------------------------------------------------------
+// one group
+// ----------------------------------------------------------
+
+static inline void kmi_sx_encode_group(const uint8_t *in, uint8_t *out)
+{
+    uint8_t tmp[8];
+    memcpy(tmp, in, KMI_SX_GROUP_IN);
+    tmp[7] = 0;
+
+    uint64_t v = kmi_sx_load64(tmp);
+    uint64_t hi = ((v & KMI_SX_HI_MASK) * KMI_SX_GATHER_MUL) >> 56;
+    kmi_sx_store64(out, (v & KMI_SX_LO_MASK) | ((hi & 0x7F) << 56), KMI_SX_GROUP_OUT);
+}
+
+static inline void kmi_sx_decode_group(const uint8_t *in, uint8_t *out)
+{
+    uint64_t v = kmi_sx_load64(in);
+    uint64_t hi = (v >> 56) & 0x7F;
+    kmi_sx_store64(out, v | ((hi * KMI_SX_SPREAD_MUL) & KMI_SX_HI_MASK), KMI_SX_GROUP_IN);
+}
+
+// ----------------------------------------------------------
+// simd, two groups per register. Stores are 8 bytes wide, so each call leaves one junk byte
+// after its output that the next group overwrites, callers keep one group in reserve.
+// ----------------------------------------------------------
+
+#if defined(KMI_SX_CODEC_SSE2)
+static inline void kmi_sx_decode_2groups(const uint8_t *in, uint8_t *out)
+{
+    const __m128i bits = _mm_set1_epi64x(0x0040201008040201LL);
+    __m128i v = _mm_loadu_si128((const __m128i *)in);
+
+    // replicate each group's high bit byte across its 8 lanes
+    __m128i hi = _mm_srli_epi64(v, 56);
+    hi = _mm_or_si128(hi, _mm_slli_epi64(hi, 8));
+    hi = _mm_or_si128(hi, _mm_slli_epi64(hi, 16));
+    hi = _mm_or_si128(hi, _mm_slli_epi64(hi, 32));
+
+    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(hi, bits), bits);
+    __m128i r = _mm_or_si128(v, _mm_and_si128(set, _mm_set1_epi8((char)0x80)));
+
+    _mm_storel_epi64((__m128i *)out, r);
+    _mm_storel_epi64((__m128i *)(out + KMI_SX_GROUP_IN), _mm_unpackhi_epi64(r, r));
+}
+
+static inline void kmi_sx_encode_2groups(const uint8_t *in, uint8_t *out)
+{
+    __m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)in),
+                                   _mm_loadl_epi64((const __m128i *)(in + KMI_SX_GROUP_IN)));
+    int mask = _mm_movemask_epi8(v);
+    __m128i hi = _mm_set_epi64x((long long)((uint64_t)((mask >> 8) & 0x7F) << 56),
+                                (long long)((uint64_t)(mask & 0x7F) << 56));
+    __m128i lo = _mm_and_si128(v, _mm_set1_epi64x((long long)KMI_SX_LO_MASK));
+    _mm_storeu_si128((__m128i *)out, _mm_or_si128(lo, hi));
+}
+#elif defined(KMI_SX_CODEC_NEON)
+static inline void kmi_sx_decode_2groups(const uint8_t *in, uint8_t *out)
+{
+    static const uint8_t bitTable[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00};
+    const uint8x8_t bits = vld1_u8(bitTable);
+    const uint8x8_t top = vdup_n_u8(0x80);
+
+    for (int g = 0; g < 2; g++)
+    {
+        uint8x8_t v = vld1_u8(in + g * KMI_SX_GROUP_OUT);
+        uint8x8_t set = vtst_u8(vdup_lane_u8(v, 7), bits);
+        vst1_u8(out + g * KMI_SX_GROUP_IN, vorr_u8(v, vand_u8(set, top)));
+    }
+}
+
+static inline void kmi_sx_encode_2groups(const uint8_t *in, uint8_t *out)
+{
+    static const uint8_t laneTable[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00};
+    const uint8x8_t lanes = vld1_u8(laneTable);
+    const uint8x8_t low = vdup_n_u8(0x7F);
+
+    for (int g = 0; g < 2; g++)
+    {
+        uint8x8_t v = vld1_u8(in + g * KMI_SX_GROUP_IN);
+        uint8x8_t hiBits = vand_u8(vcltz_s8(vreinterpret_s8_u8(v)), lanes); // lane i -> bit i if bit 7 set
+        uint8_t hi = vaddv_u8(hiBits); // distinct bits, the sum is an or
+        uint8x8_t r = vset_lane_u8(hi, vand_u8(v, low), 7);
+        vst1_u8(out + g * KMI_SX_GROUP_OUT, r);
+    }
+}
+#endif
+
+// ----------------------------------------------------------
+// buffers
+// ----------------------------------------------------------
+
+// encode length bytes, the last group is zero padded. out needs kmi_sx_encoded_size(length) bytes,
+// returns the number of bytes written
+static inline size_t kmi_sx_encode(const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t groups = length / KMI_SX_GROUP_IN;
+    size_t g = 0;
+
+#if defined(KMI_SX_CODEC_SSE2) || defined(KMI_SX_CODEC_NEON)
+    // the 8 byte loads read one byte past each pair, keep a group in reserve
+    if (length >= KMI_SX_SIMD_MIN)
+    {
+        for (; g + 3 <= groups; g += 2)
+        {
+            kmi_sx_encode_2groups(in + g * KMI_SX_GROUP_IN, out + g * KMI_SX_GROUP_OUT);
+        }
+    }
+#endif
+
+    for (; g < groups; g++)
+    {
+        kmi_sx_encode_group(in + g * KMI_SX_GROUP_IN, out + g * KMI_SX_GROUP_OUT);
+    }
+
+    size_t remain = length - groups * KMI_SX_GROUP_IN;
+    if (remain)
+    {
+        uint8_t last[KMI_SX_GROUP_IN] = {0};
+        memcpy(last, in + groups * KMI_SX_GROUP_IN, remain);
+        kmi_sx_encode_group(last, out + groups * KMI_SX_GROUP_OUT);
+        groups++;
+    }
+
+    return groups * KMI_SX_GROUP_OUT;
+}
+
+// decode length bytes. A trailing partial group has lost its high bit byte, its bytes are copied
+// as they are. out needs kmi_sx_decoded_size(length) bytes, returns the number of bytes written
+static inline size_t kmi_sx_decode(const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t groups = length / KMI_SX_GROUP_OUT;
+    size_t g = 0;
+
+#if defined(KMI_SX_CODEC_SSE2) || defined(KMI_SX_CODEC_NEON)
+    // the 8 byte stores write one junk byte past each pair, keep a group in reserve
+    if (length >= KMI_SX_SIMD_MIN)
+    {
+        for (; g + 3 <= groups; g += 2)
+        {
+            kmi_sx_decode_2groups(in + g * KMI_SX_GROUP_OUT, out + g * KMI_SX_GROUP_IN);
+        }
+    }
+#endif
+
+    for (; g < groups; g++)
+    {
+        kmi_sx_decode_group(in + g * KMI_SX_GROUP_OUT, out + g * KMI_SX_GROUP_IN);
+    }
+
+    size_t remain = length - groups * KMI_SX_GROUP_OUT;
+    memcpy(out + groups * KMI_SX_GROUP_IN, in + groups * KMI_SX_GROUP_OUT, remain);
+
+    return groups * KMI_SX_GROUP_IN + remain;
+}
+
+// ----------------------------------------------------------
+// self test, returns 0 if every path matches the byte at a time reference
+// ----------------------------------------------------------
+
+// the original KMI_Encode::midi_sx_encode_char loop
+static inline void kmi_sx_encode_reference(const uint8_t *in, size_t length, uint8_t *out)
+{
+    unsigned char hiBits = 0, hiCount = 0;
+    size_t o = 0;
+    for (size_t i = 0; i < kmi_sx_encoded_size(length) / KMI_SX_GROUP_OUT * KMI_SX_GROUP_IN; i++)
+    {
+        unsigned char val = i < length ? in[i] : 0; // midi_sx_flush pads with zeros
+        hiBits |= (val & 0x80);
+        hiBits >>= 1;
+        out[o++] = (val & 0x7f);
+        if (++hiCount == KMI_SX_GROUP_IN)
+        {
+            hiCount = 0;
+            out[o++] = hiBits;
+            hiBits = 0;
+        }
+    }
+}
+
+static inline int kmi_sx_codec_selftest(void)
+{
+    // fixed vectors, the layout the firmware expects
+    static const uint8_t plain[14] = {0x80, 0x01, 0xFF, 0x7F, 0x00, 0xC3, 0x81,  0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE};
+    static const uint8_t coded[16] = {0x00, 0x01, 0x7F, 0x7F, 0x00, 0x43, 0x01, 0x65, 0x12, 0x34, 0x56, 0x78, 0x1A, 0x3C, 0x5E, 0x70};
+    uint8_t buf[16];
+
+    if (kmi_sx_encode(plain, sizeof(plain), buf) != sizeof(coded) || memcmp(buf, coded, sizeof(coded))) return 1;
+    if (kmi_sx_decode(coded, sizeof(coded), buf) != sizeof(plain) || memcmp(buf, plain, sizeof(plain))) return 2;
+
+    // every length through the scalar and simd paths against the reference
+    uint8_t in[300], ref[344], enc[344], dec[301]; // the last group decodes its padding too
+    uint32_t seed = 0x4B4D49; // KMI
+    for (size_t i = 0; i < sizeof(in); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (uint8_t)(seed >> 16);
+    }
+
+    for (size_t length = 0; length <= sizeof(in); length++)
+    {
+        size_t encLength = kmi_sx_encoded_size(length);
+        kmi_sx_encode_reference(in, length, ref);
+
+        if (kmi_sx_encode(in, length, enc) != encLength || memcmp(enc, ref, encLength)) return 3;
+        if (kmi_sx_decode(enc, encLength, dec) != encLength / KMI_SX_GROUP_OUT * KMI_SX_GROUP_IN) return 4;
+        if (memcmp(dec, in, length)) return 5;
+    }
+    return 0;
+}
+
+#endif // KMISYSEXCODEC_H
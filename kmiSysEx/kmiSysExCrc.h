@@ -0,0 +1,97 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef KMISYSEXCRC_H
+#define KMISYSEXCRC_H
+
+/* KMI SysEx CRC
+
+  CRC-CCITT (poly 0x1021, init 0xFFFF, msb first, no final xor) shared by KMI_Encode and KMI_Decode.
+
+  - the lookup tables are generated at compile time
+  - kmi_crc16 runs slice-by-8 over a buffer, then slice-by-4, then one byte at a time
+  - bytes are always unsigned. The old crc_byte(char) sign extended bytes >= 0x80 on platforms
+    where char is signed, which xors the result with 0xEEF0 for each such byte. Define
+    KMI_SX_CRC_SIGNED_CHAR to get that behaviour back when talking to a peer that relies on it.
+
+  Header only, C++14, no Qt dependency.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define KMI_CRC16_INIT      0xFFFF
+#define KMI_CRC16_POLY      0x1021
+#define KMI_CRC16_SLICES    8
+
+struct KMI_CRC16_TABLES
+{
+    uint16_t t[KMI_CRC16_SLICES][256]; // t[k][b] = crc contribution of b followed by k zero bytes
+};
+
+constexpr KMI_CRC16_TABLES kmi_crc16_make_tables()
+{
+    KMI_CRC16_TABLES tables = {};
+
+    for (int b = 0; b < 256; b++)
+    {
+        uint16_t crc = (uint16_t)(b << 8);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ KMI_CRC16_POLY) : (uint16_t)(crc << 1);
+        }
+        tables.t[0][b] = crc;
+    }
+
+    for (int k = 1; k < KMI_CRC16_SLICES; k++)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            uint16_t prev = tables.t[k - 1][b];
+            tables.t[k][b] = (uint16_t)((prev << 8) ^ tables.t[0][prev >> 8]);
+        }
+    }
+    return tables;
+}
+
+static constexpr KMI_CRC16_TABLES kmiCrc16Tables = kmi_crc16_make_tables();
+
+static inline uint16_t kmi_crc16_byte(uint16_t crc, uint8_t val)
+{
+    crc = (uint16_t)((crc << 8) ^ kmiCrc16Tables.t[0][(crc >> 8) ^ val]);
+#ifdef KMI_SX_CRC_SIGNED_CHAR
+    if (val & 0x80) crc ^= 0xEEF0;
+#endif
+    return crc;
+}
+
+static inline uint16_t kmi_crc16(uint16_t crc, const uint8_t *data, size_t length)
+{
+    const uint16_t (*t)[256] = kmiCrc16Tables.t;
+    size_t i = 0;
+
+#ifndef KMI_SX_CRC_SIGNED_CHAR // the sign fix up is per byte, so the legacy mode can't slice
+    for (; i + 8 <= length; i += 8)
+    {
+        const uint8_t *p = data + i;
+        crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xFF)] ^
+              t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+
+    if (i + 4 <= length)
+    {
+        const uint8_t *p = data + i;
+        crc = t[3][p[0] ^ (crc >> 8)] ^ t[2][p[1] ^ (crc & 0xFF)] ^ t[1][p[2]] ^ t[0][p[3]];
+        i += 4;
+    }
+#endif
+
+    for (; i < length; i++)
+    {
+        crc = kmi_crc16_byte(crc, data[i]);
+    }
+    return crc;
+}
+
+#endif // KMISYSEXCRC_H
@@ -76,6 +76,7 @@ enum MIDI_CHANNELS
 #define SX_ADD_IGNORE			0x7F
 #define SX_ADD_ZERO             0x00
 #define SX_UNIV_ACK             0x7F
+#define SX_UNIV_NAK             0x7E
 
 // info request (device id)
 #define SX_UNV_INFO				0x06
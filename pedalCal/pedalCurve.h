@@ -0,0 +1,68 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef PEDALCURVE_H
+#define PEDALCURVE_H
+
+/* Pedal Curve
+
+  Calibrated pedal response as one lookup table: input -> min/max remap to 0-127 -> curve.
+
+  - build() computes every input value once, map() is a clamp and a table read
+  - the input domain is 1 to PEDAL_CURVE_MAX_BITS bits wide, min/max are given in it. The
+    remap is the same integer math as the firmware's remap, so an 8 bit table matches what the
+    device outputs, wider domains keep the extra resolution of 14 bit pedals
+  - curve is a 128 entry table (0-127 in, 0-127 out) applied after the remap, nullptr = linear
+
+  Header only, no Qt dependency.
+
+*/
+
+#include <cstdint>
+
+#define PEDAL_CURVE_MAX_BITS    14      // largest input domain, 14 bit CC pairs
+#define PEDAL_CURVE_OUT_MAX     127
+#define PEDAL_CURVE_TABLE_SIZE  128     // entries in a curve table
+
+class PedalCurve
+{
+public:
+    PedalCurve() { build(0, 255, nullptr, 8); }
+
+    void build(int inMin, int inMax, const unsigned char *curve, int inputBits)
+    {
+        if (inputBits < 1) inputBits = 1;
+        if (inputBits > PEDAL_CURVE_MAX_BITS) inputBits = PEDAL_CURVE_MAX_BITS;
+
+        bits = inputBits;
+        size = 1 << bits;
+
+        for (int i = 0; i < size; i++)
+        {
+            int out;
+
+            if (i <= inMin) out = 0;
+            else if (i >= inMax) out = PEDAL_CURVE_OUT_MAX;
+            else out = (unsigned int)(i - inMin) * PEDAL_CURVE_OUT_MAX / (unsigned int)(inMax - inMin);
+
+            lut[i] = curve ? curve[out] : (unsigned char)out;
+        }
+    }
+
+    unsigned char map(int input) const
+    {
+        if (input < 0) input = 0;
+        else if (input >= size) input = size - 1;
+        return lut[input];
+    }
+
+    int inputBits() const { return bits; }
+    int inputSize() const { return size; }
+
+private:
+    unsigned char lut[1 << PEDAL_CURVE_MAX_BITS];
+    int bits;
+    int size;
+};
+
+#endif // PEDALCURVE_H
@@ -14,7 +14,7 @@ const unsigned char table_deadzone[] = {0,1,2,3,4,5,7,8,9,10,11,13,14,15,16,17,1
 
 const unsigned char *tablePtr[] =
 {
-    table_Logarithmic, // dummy placeholder for linear
+    nullptr, // linear
     table_Sin,
     table_Cos,
     table_Exponential,
@@ -32,6 +32,18 @@ pedalCal::pedalCal(QWidget *parent) :
     this->setFixedSize(640,369);
 
     this->setWindowTitle("Expression Pedal Calibration");
+
+    inputVal = outputVal = 0;
+
+    // live input is stored as it arrives and shown by the timer
+    previewInput = -1;
+    previewController = -1;
+    previewHighResolution = false;
+    previewMSB = 0;
+    previewTimer = new QTimer(this);
+    previewTimer->setInterval(PEDAL_CAL_PREVIEW_MS);
+    connect(previewTimer, SIGNAL(timeout()), this, SLOT(slotUpdatePreview()));
+
     slotConnectElements();
     slotSetDefaultValues();
 
@@ -110,6 +122,8 @@ pedalCal::~pedalCal()
 void pedalCal::closeEvent(QCloseEvent *event)
 {
     qDebug() << "pedalCal closeEvent";
+    previewTimer->stop();
+    previewInput = -1; // so the next value restarts the timer
     emit signalWindowClosed();
     QWidget::closeEvent(event);
 }
@@ -158,6 +172,7 @@ void pedalCal::slotConnectElements()
     connect(ui->slider_in, SIGNAL(valueChanged(int)), this, SLOT(slotSetInput(int)));
     connect(ui->slider_min, SIGNAL(valueChanged(int)), this, SLOT(slotSetMin(int)));
     connect(ui->slider_max, SIGNAL(valueChanged(int)), this, SLOT(slotSetMax(int)));
+    connect(ui->dropdown_table, SIGNAL(currentIndexChanged(int)), this, SLOT(slotRebuildCurve()));
 
     // butons
     connect(ui->button_restore, SIGNAL(clicked()), this, SLOT(slotSetDefaultValues()));
@@ -171,6 +186,7 @@ void pedalCal::slotDisconnectElements()
     disconnect(ui->slider_in, SIGNAL(valueChanged(int)), this, SLOT(slotSetInput(int)));
     disconnect(ui->slider_min, SIGNAL(valueChanged(int)), this, SLOT(slotSetMin(int)));
     disconnect(ui->slider_max, SIGNAL(valueChanged(int)), this, SLOT(slotSetMax(int)));
+    disconnect(ui->dropdown_table, SIGNAL(currentIndexChanged(int)), this, SLOT(slotRebuildCurve()));
 }
 
 // *****************************************************
@@ -185,18 +201,15 @@ void pedalCal::slotSetDefaultValues()
     ui->slider_max->setValue(calMax);
 }
 
-// this functinon handles incomming tether data
+// this functinon handles incomming tether data, shown with the next preview update
 void pedalCal::slotProcessInput(int val)
 {
-    qDebug() << "slotProcessInput called - val: " << val;
-    ui->slider_in->setValue(val);
-    slotSetInput(val);
+    if (previewInput.exchange(val << PEDAL_CAL_INPUT_SHIFT, std::memory_order_relaxed) < 0) previewTimer->start();
 }
 
 // this function also handles changes from the ui slider during debugging
 void pedalCal::slotSetInput(int val)
 {
-    qDebug() << "slotSetInput called - val: " << val;
     inputVal = val;
     ui->label_in_val->setText(QString::number(val));
     slotCalculateOutput();
@@ -204,56 +217,110 @@ void pedalCal::slotSetInput(int val)
 
 void pedalCal::slotSetMin(int val)
 {
-    qDebug() << "slotSetMin called - val: " << val;
     calMin = val;
     ui->label_min_val->setText(QString::number(val));
-    slotCalculateOutput();
+    slotRebuildCurve();
 }
 
 void pedalCal::slotSetMax(int val)
 {
-    qDebug() << "slotSetMax called - val: " << val;
     calMax = val;
     ui->label_max_val->setText(QString::number(val));
+    slotRebuildCurve();
+}
+
+// calibration changed, min/max are scaled up to the curve domain so 8 bit inputs map exactly as before
+void pedalCal::slotRebuildCurve()
+{
+    int tableIndex = ui->dropdown_table->currentIndex();
+    const unsigned char *table = (tableIndex > 0 && tableIndex < int(sizeof(tablePtr) / sizeof(tablePtr[0]))) ? tablePtr[tableIndex] : nullptr;
+
+    curve.build(calMin << PEDAL_CAL_INPUT_SHIFT, calMax << PEDAL_CAL_INPUT_SHIFT, table, PEDAL_CAL_CURVE_BITS);
     slotCalculateOutput();
 }
 
-//*************************************************
-//*** remap_charToChar(val, in_min, in_max, out_min, out_max)
-//*************************************************
-unsigned char remap_charToChar(unsigned char val, unsigned char in_min, unsigned char in_max, unsigned char out_min, unsigned char out_max)
+void pedalCal::slotCalculateOutput()
 {
-    unsigned char temp = 0;
+    showOutput(curve.map(inputVal << PEDAL_CAL_INPUT_SHIFT));
+}
 
-    if(val <= in_min)
-    {
-        return out_min;
-    }
-    else if(val >= in_max)
+void pedalCal::showOutput(int val)
+{
+    outputVal = val;
+    ui->slider_out->setValue(outputVal);
+    ui->label_out_val->setText(QString::number(outputVal));
+}
+
+// *****************************************************
+// Live preview
+// *****************************************************
+
+void pedalCal::slotSetPreviewController(int controller, bool highResolution)
+{
+    qDebug() << "pedalCal slotSetPreviewController called - controller: " << controller << " highResolution: " << highResolution;
+
+    previewHighResolution = highResolution;
+    previewController = controller;
+
+    if (controller < 0)
     {
-        return out_max;
+        previewTimer->stop();
+        previewInput = -1;
     }
+    // otherwise started by the first value
+}
+
+// any thread, no widgets here
+void pedalCal::slotRxControlChange(uchar chan, uchar cc, uchar val)
+{
+    Q_UNUSED(chan);
 
-    temp = ((unsigned int)(val - in_min) * (out_max - out_min) / (in_max - in_min)) + out_min;
+    int controller = previewController.load(std::memory_order_relaxed);
+    if (controller < 0) return;
 
-    return temp;
+    if (cc == controller)
+    {
+        if (previewHighResolution.load(std::memory_order_relaxed))
+        {
+            previewMSB.store(val, std::memory_order_relaxed);
+            storePreview(val << 7); // shown as is if no LSB follows
+        }
+        else
+        {
+            storePreview(val << (PEDAL_CAL_CURVE_BITS - 7));
+        }
+    }
+    else if (cc == controller + 32 && previewHighResolution.load(std::memory_order_relaxed))
+    {
+        storePreview((previewMSB.load(std::memory_order_relaxed) << 7) | val);
+    }
 }
 
-void pedalCal::slotCalculateOutput()
+// any thread, the timer stops once everything is shown so only the first value after a pause restarts it
+void pedalCal::storePreview(int value)
 {
-    unsigned char tableIndex = ui->dropdown_table->currentIndex();
+    if (previewInput.exchange(value, std::memory_order_relaxed) < 0)
+        QMetaObject::invokeMethod(previewTimer, "start", Qt::QueuedConnection);
+}
 
-    outputVal = remap_charToChar(inputVal, calMin, calMax, 0, 127);
+// latest live value only, whatever arrived in between is skipped
+void pedalCal::slotUpdatePreview()
+{
+    int value = previewInput.exchange(-1, std::memory_order_relaxed);
+    if (value < 0)
+    {
+        previewTimer->stop(); // nothing new since the last repaint
+        return;
+    }
 
-    if (tableIndex) // ignores index 0, linear
+    inputVal = value >> PEDAL_CAL_INPUT_SHIFT;
     {
-        qDebug() << "table index: " << tableIndex;
-        outputVal = tablePtr[tableIndex][outputVal];
+        const QSignalBlocker blocker(ui->slider_in);
+        ui->slider_in->setValue(inputVal);
     }
+    ui->label_in_val->setText(QString::number(inputVal));
 
-    ui->slider_out->setValue(outputVal);
-    ui->label_out_val->setText(QString::number(outputVal));
-    qDebug() << "slotCalculateOutput called - outputVal: " << outputVal;
+    showOutput(curve.map(value)); // full input resolution
 }
 
 /*
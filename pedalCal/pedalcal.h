@@ -7,6 +7,15 @@
 #include <QDialog>
 #include <QVariant>
 #include <QSettings>
+#include <QTimer>
+#include <atomic>
+
+#include "pedalCurve.h"
+
+#define PEDAL_CAL_INPUT_BITS        8   // tether input, the sliders and the stored min/max
+#define PEDAL_CAL_CURVE_BITS        14  // curve domain, 14 bit controllers keep their resolution
+#define PEDAL_CAL_INPUT_SHIFT       (PEDAL_CAL_CURVE_BITS - PEDAL_CAL_INPUT_BITS)
+#define PEDAL_CAL_PREVIEW_MS        16  // live input reaches the widgets at most this often
 
 
 namespace Ui {
@@ -27,6 +36,9 @@ public:
 
     QSettings *sessionSettings;
 
+    // min/max and the selected table in one lookup, rebuilt by slotRebuildCurve
+    PedalCurve curve;
+
 signals:
     void signalWindowClosed();
     void signalStoreValue(QString, QVariant);
@@ -43,6 +55,12 @@ public slots:
     void slotSetMin(int val);
     void slotSetMax(int val);
     void slotCalculateOutput();
+    void slotRebuildCurve();
+
+    // live preview from MidiDeviceManager::signalRxMidi_controlChange, any channel. The slot only
+    // stores the value, so it can be connected directly from the rx thread and run at full rate
+    void slotSetPreviewController(int controller, bool highResolution = false); // -1 = off, 14 bit: LSB on controller + 32
+    void slotRxControlChange(uchar chan, uchar cc, uchar val);
     void slotLoadJSONCalibrationValues(QVariantMap preset);
     void slotSaveAndSendCalibrationValues();
 
@@ -51,8 +69,20 @@ protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
 
 
+private slots:
+    void slotUpdatePreview();
+
 private:
     Ui::pedalCal *ui;
+
+    void showOutput(int val);
+    void storePreview(int value);
+
+    QTimer *previewTimer;
+    std::atomic<int> previewInput;          // latest live value in the curve domain, -1 = shown
+    std::atomic<int> previewController;     // -1 = off
+    std::atomic<bool> previewHighResolution;
+    std::atomic<int> previewMSB;            // rx thread, MSB of the 14 bit pair
 };
 
 #endif // PEDALCAL_H
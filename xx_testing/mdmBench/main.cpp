@@ -0,0 +1,643 @@
+// Copyright (c) 2025 KMI Music, Inc.
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file, You can obtain one at https://mozilla.org/MPL/2.0/.
+/* mdmBench
+
+  Headless MIDI I/O benchmark for MidiDeviceManager, results are written as JSON.
+
+  - codec: kmi_sx_codec_selftest on the build's SSE2/NEON/scalar path (check), then
+    kmi_sx_encode/kmi_sx_decode and KMI_Encode/KMI_Decode throughput with round trips (check),
+    always runs
+  - capture: logs of 256, 512 and 300 records are written and read back, seeking to the end,
+    to the last record and past the end (check), always runs
+  - loopback: two managers joined through an RtMidi virtual port (tx opens the virtual input
+    created by rx), runs with the callback parser, the rx ring and the rx ring + tx thread
+      - nrpn: a single NRPN with no other traffic has to reach rx on its own (check)
+      - channel: rx/tx rate for a burst of short messages
+      - roundTrip: send one CC, wait for it, percentiles to the rx signal and to the rx timestamp
+      - sysex: chunked transfer throughput for several sysExTxChunkSize/sysExTxChunkDelay pairs
+  - virtual ports don't exist on Windows, the loopback section is skipped there
+  - replay (--replay log): parse a capture log (see slotStartCapture) at full speed, real traffic
+
+  Checks (codec selftest and verified, nrpn, capture) are reported with "pass" and make the exit code 2 when one fails.
+
+  The payloads come from a fixed seed so runs compare. qDebug/DM_OUT output is dropped unless
+  --verbose is given, it would dominate the timings.
+
+  mdmBench [--out results.json] [--messages n] [--roundtrips n] [--codec-mb n] [--no-loopback] [--replay log] [--verbose]
+
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QThread>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "KMI_mdm.h"
+#include "KMI_ports.h"
+#include "KMI_metrics.h"
+#include "KMI_rxClock.h"
+#include "kmiSysEx.h"
+#include "KMI_captureReplay.h"
+
+#define BENCH_VERSION           1
+#define BENCH_LOOP_PORT         "KMI Bench Loop"
+#define BENCH_TIMEOUT_MS        10000   // per wait, a lost message fails the wait instead of hanging
+#define BENCH_SYSEX_LENGTH      4096    // a full preset dump, kept whole or joined by KMI_rxSysEx
+#define BENCH_SYSEX_MESSAGES    32
+#define BENCH_PACKET_LENGTH     512     // KMI_Encode frames are built in a 1024 byte buffer
+#define BENCH_SEED              0x4B4D4931u
+#define BENCH_NRPN_PARAMETER    0x1234
+#define BENCH_NRPN_VALUE        0x0567
+
+static bool benchVerbose = false;
+static int benchFailedChecks = 0;
+
+static void benchMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type == QtDebugMsg && !benchVerbose) return;
+    fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+// ****************************
+// Helpers
+// ****************************
+
+// repeatable payload bytes, 7 bit if requested
+static void benchFill(uint8_t *buffer, size_t length, bool sevenBit)
+{
+    uint32_t state = BENCH_SEED;
+    for (size_t i = 0; i < length; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        buffer[i] = uint8_t(state >> 24) & (sevenBit ? 0x7F : 0xFF);
+    }
+}
+
+// run the event loop until done() or the timeout, the managers only send from their timers
+static bool benchWaitFor(std::function<bool()> done, int timeoutMs = BENCH_TIMEOUT_MS)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done())
+    {
+        if (timer.elapsed() > timeoutMs) return false;
+        QCoreApplication::processEvents(QEventLoop::AllEvents);
+        QThread::yieldCurrentThread();
+    }
+    return true;
+}
+
+static QJsonObject benchHistogram(const KMI_Histogram &histogram)
+{
+    QJsonObject result;
+    result["count"] = double(histogram.count());
+    result["p50Ns"] = double(histogram.percentile(50));
+    result["p90Ns"] = double(histogram.percentile(90));
+    result["p99Ns"] = double(histogram.percentile(99));
+    result["p999Ns"] = double(histogram.percentile(99.9));
+    result["maxNs"] = double(histogram.max());
+    return result;
+}
+
+static QJsonObject benchMetrics(const KMI_MetricsSnapshot &s)
+{
+    QJsonObject result;
+    result["rxMessages"] = double(s.rxMessages);
+    result["rxBytes"] = double(s.rxBytes);
+    result["rxDropped"] = double(s.rxDropped);
+    result["txMessages"] = double(s.txMessages);
+    result["txBytes"] = double(s.txBytes);
+    result["sendErrors"] = double(s.sendErrors);
+    result["rxLatencyP50Ns"] = double(s.rxLatencyP50);
+    result["rxLatencyP99Ns"] = double(s.rxLatencyP99);
+    result["txLatencyP50Ns"] = double(s.txLatencyP50);
+    result["txLatencyP99Ns"] = double(s.txLatencyP99);
+    return result;
+}
+
+static double benchRate(double count, qint64 ns)
+{
+    return ns > 0 ? count * 1e9 / double(ns) : 0;
+}
+
+// ****************************
+// Codec
+// ****************************
+
+static QJsonObject benchCodec(size_t totalBytes)
+{
+    QJsonObject result;
+
+    // fixed vectors and every length against the byte at a time reference, on the path this build uses
+    int selftestError = kmi_sx_codec_selftest();
+    QJsonObject selftest;
+#if defined(KMI_SX_CODEC_SSE2)
+    selftest["path"] = "sse2";
+#elif defined(KMI_SX_CODEC_NEON)
+    selftest["path"] = "neon";
+#else
+    selftest["path"] = "scalar";
+#endif
+    selftest["error"] = selftestError; // 0 = pass, see kmi_sx_codec_selftest
+    selftest["pass"] = (selftestError == 0);
+    result["selftest"] = selftest;
+    if (selftestError) benchFailedChecks++;
+
+    // raw 8bit <-> 7bit groups
+    std::vector<uint8_t> plain(65536), encoded(kmi_sx_encoded_size(65536)), decoded(65536);
+    benchFill(plain.data(), plain.size(), false);
+
+    size_t rounds = qMax<size_t>(1, totalBytes / plain.size());
+    qint64 start = kmiHostTimeNs();
+    for (size_t i = 0; i < rounds; i++) kmi_sx_encode(plain.data(), plain.size(), encoded.data());
+    qint64 encodeNs = kmiHostTimeNs() - start;
+
+    start = kmiHostTimeNs();
+    for (size_t i = 0; i < rounds; i++) kmi_sx_decode(encoded.data(), encoded.size(), decoded.data());
+    qint64 decodeNs = kmiHostTimeNs() - start;
+
+    QJsonObject raw;
+    raw["bytes"] = double(rounds * plain.size());
+    raw["encodeMBps"] = benchRate(rounds * plain.size(), encodeNs) / 1e6;
+    raw["decodeMBps"] = benchRate(rounds * plain.size(), decodeNs) / 1e6;
+    raw["verified"] = (decoded == plain);
+    if (decoded != plain) benchFailedChecks++;
+    result["raw"] = raw;
+
+    // framed packets, KMI_Encode -> bytes -> KMI_Decode
+    KMI_Encode encoder(PID_QUNEO);
+    KMI_Decode decoder;
+    std::vector<uint8_t> payload(BENCH_PACKET_LENGTH);
+    benchFill(payload.data(), payload.size(), false);
+
+    std::vector<uint8_t> stream;
+    QObject::connect(&encoder, &KMI_Encode::signalSendSysEx, [&stream](unsigned char *sysEx, int len)
+    {
+        stream.insert(stream.end(), sysEx, sysEx + len);
+        stream.push_back(MIDI_SX_STOP); // signalSendSysEx leaves the F7 off, like slotSendSysEx expects
+    });
+
+    size_t packets = qMax<size_t>(1, totalBytes / payload.size() / 8);
+    stream.reserve(packets * (kmi_sx_encoded_size(payload.size()) + 32));
+
+    start = kmiHostTimeNs();
+    for (size_t i = 0; i < packets; i++) encoder.slotEncodePacket(1, 2, payload.data(), uint16_t(payload.size()));
+    qint64 packetEncodeNs = kmiHostTimeNs() - start;
+
+    size_t decodedPackets = 0;
+    bool packetsMatch = true;
+    QObject::connect(&decoder, &KMI_Decode::signalRxKMIPacketData,
+                     [&](uint8_t, uint8_t, uint8_t, uint8_t *ptr, uint32_t length)
+    {
+        decodedPackets++;
+        if (length != payload.size() || memcmp(ptr, payload.data(), length)) packetsMatch = false;
+    });
+
+    start = kmiHostTimeNs();
+    decoder.slotDecodeBytes(stream.data(), stream.size());
+    qint64 packetDecodeNs = kmiHostTimeNs() - start;
+
+    QJsonObject framed;
+    framed["packets"] = double(packets);
+    framed["payloadBytes"] = double(payload.size());
+    framed["streamBytes"] = double(stream.size());
+    framed["encodePacketsPerSec"] = benchRate(packets, packetEncodeNs);
+    framed["decodePacketsPerSec"] = benchRate(packets, packetDecodeNs);
+    framed["encodeMBps"] = benchRate(packets * payload.size(), packetEncodeNs) / 1e6;
+    framed["decodeMBps"] = benchRate(packets * payload.size(), packetDecodeNs) / 1e6;
+    framed["verified"] = (decodedPackets == packets && packetsMatch);
+    if (decodedPackets != packets || !packetsMatch) benchFailedChecks++;
+    result["framed"] = framed;
+
+    return result;
+}
+
+// ****************************
+// Replay
+// ****************************
+
+static QJsonObject benchReplay(QString filePath)
+{
+    QJsonObject result;
+    result["file"] = filePath;
+
+    KMI_Ports ports;
+    MidiDeviceManager mdm(nullptr, -1, "mdmBench replay", &ports); // no ports, only the parser runs
+    KMI_CaptureReplay replay(&mdm);
+
+    if (!replay.open(filePath))
+    {
+        result["error"] = "not a capture log";
+        return result;
+    }
+    replay.setSpeed(0);
+
+    qint64 start = kmiHostTimeNs();
+    quint64 fed = replay.replayAll();
+    qint64 elapsedNs = kmiHostTimeNs() - start;
+
+    result["records"] = double(replay.log().count());
+    result["rxRecords"] = double(fed);
+    result["truncated"] = replay.log().truncated();
+    result["captureSeconds"] = double(replay.log().lastNs() - replay.log().firstNs()) / 1e9;
+    result["rxRecordsPerSec"] = benchRate(fed, elapsedNs);
+    result["rxMetrics"] = benchMetrics(mdm.getMetrics());
+    return result;
+}
+
+// ****************************
+// Capture
+// ****************************
+
+// a log of exactly k * CAPTURE_INDEX_STRIDE records has no seek point for record k * stride
+static QJsonObject benchCaptureSeek(int records)
+{
+    QString filePath = QDir::temp().filePath("mdmBench_capture.kmicap");
+    bool pass = false;
+
+    KMI_CaptureWriter writer;
+    if (writer.start(filePath))
+    {
+        for (int i = 0; i < records; i++)
+        {
+            const uchar message[3] = { MIDI_NOTE_ON, uchar(i & 0x7F), 1 };
+            writer.append(CAPTURE_RX, 1000 + i, message, 3);
+        }
+        writer.stop();
+
+        KMI_CaptureReader reader;
+        KMI_CaptureEvent event;
+        pass = reader.open(filePath) && reader.count() == quint64(records) &&
+               reader.seekRecord(records) && !reader.next(event) && reader.position() == quint64(records) &&
+               reader.seekRecord(records - 1) && reader.next(event) && event.record == quint64(records - 1) &&
+               !reader.seekRecord(records + 1);
+    }
+    QFile::remove(filePath);
+
+    if (!pass) benchFailedChecks++;
+
+    QJsonObject result;
+    result["records"] = records;
+    result["pass"] = pass;
+    return result;
+}
+
+static QJsonArray benchCapture()
+{
+    QJsonArray result;
+    for (int records : { CAPTURE_INDEX_STRIDE, 2 * CAPTURE_INDEX_STRIDE, 300 }) result.append(benchCaptureSeek(records));
+    return result;
+}
+
+// ****************************
+// Loopback
+// ****************************
+
+#ifndef Q_OS_WIN
+
+// tx opens the virtual input rx created, same path a hardware port takes
+static int benchFindLoopPort()
+{
+    try
+    {
+        RtMidiOut probe;
+        for (unsigned int i = 0; i < probe.getPortCount(); i++)
+        {
+            if (QString::fromStdString(probe.getPortName(i)).contains(BENCH_LOOP_PORT)) return int(i);
+        }
+    }
+    catch (RtMidiError &error)
+    {
+        qWarning() << "mdmBench: port scan failed:" << QString::fromStdString(error.getMessage());
+    }
+    return -1;
+}
+
+class BenchLoopback
+{
+public:
+    std::atomic<quint64> rxShort;
+    std::atomic<quint64> rxSysEx;
+    std::atomic<quint64> rxSysExBytes;
+    std::atomic<qint64> lastArrivalNs;
+    std::atomic<qint64> lastStampNs;
+
+    BenchLoopback(KMI_Ports *ports) :
+        tx(nullptr, -1, "mdmBench tx", ports),
+        rx(nullptr, -1, "mdmBench rx", ports)
+    {
+        rxShort = rxSysEx = rxSysExBytes = 0;
+        lastArrivalNs = lastStampNs = 0;
+
+        // direct, in the callback parser these fire on the RtMidi thread
+        QObject::connect(&rx, &MidiDeviceManager::signalRxMidi_rawTimed,
+                         [this](uchar, uchar, uchar, uchar, qint64 timestampNs)
+        {
+            lastStampNs.store(timestampNs, std::memory_order_relaxed);
+            lastArrivalNs.store(kmiHostTimeNs(), std::memory_order_relaxed);
+            rxShort.fetch_add(1, std::memory_order_release);
+        }, Qt::DirectConnection);
+
+        QObject::connect(&rx, &MidiDeviceManager::signalRxSysExBA, [this](QByteArray sysEx)
+        {
+            rxSysExBytes.fetch_add(quint64(sysEx.size()), std::memory_order_relaxed);
+            rxSysEx.fetch_add(1, std::memory_order_release);
+        }, Qt::DirectConnection);
+    }
+
+    bool open(bool rxRing, bool txThread)
+    {
+        rx.slotSetRxRingMode(rxRing);
+        if (!rx.slotCreateVirtualIn(BENCH_LOOP_PORT)) return false;
+
+        int port = -1;
+        benchWaitFor([&port]() { return (port = benchFindLoopPort()) >= 0; }, 2000); // ALSA announces it async
+        if (port < 0 || !tx.slotUpdatePortOut(port)) return false;
+
+        tx.slotSetTxThread(txThread);
+        tx.slotResetMetrics();
+        rx.slotResetMetrics();
+        return true;
+    }
+
+    void close()
+    {
+        tx.slotSetTxThread(false);
+        tx.slotCloseMidiOut(SIGNAL_NONE);
+        rx.slotCloseMidiIn(SIGNAL_NONE);
+        benchWaitFor([]() { return benchFindLoopPort() < 0; }, 2000); // don't open a stale index next run
+    }
+
+    // nothing else is sent, so the NRPN can only arrive if its own send path flushes the lane
+    QJsonObject singleNRPN()
+    {
+        quint64 rxStart = rxShort.load();
+        tx.slotSendMIDI_NRPN(BENCH_NRPN_PARAMETER, BENCH_NRPN_VALUE, 0);
+
+        // the address CCs may be skipped if it was the last one sent, data MSB/LSB always go out
+        bool delivered = benchWaitFor([&]() { return rxShort.load(std::memory_order_acquire) - rxStart >= 2; }, 1000);
+        if (!delivered) benchFailedChecks++;
+
+        QJsonObject result;
+        result["received"] = double(rxShort.load() - rxStart);
+        result["pass"] = delivered;
+        return result;
+    }
+
+    QJsonObject channelRate(int messages)
+    {
+        quint64 rxStart = rxShort.load();
+        quint64 txStart = tx.getMetrics().txMessages;
+        bool txDone = false;
+        qint64 txNs = 0;
+
+        qint64 start = kmiHostTimeNs();
+        for (int i = 0; i < messages; i++)
+        {
+            tx.slotSendMIDI(MIDI_NOTE_ON, uchar(i & 0x7F), uchar(1 + (i % 127)));
+        }
+        qint64 queuedNs = kmiHostTimeNs() - start;
+
+        bool complete = benchWaitFor([&]()
+        {
+            if (!txDone && tx.getMetrics().txMessages - txStart >= quint64(messages))
+            {
+                txDone = true;
+                txNs = kmiHostTimeNs() - start;
+            }
+            return rxShort.load(std::memory_order_acquire) - rxStart >= quint64(messages);
+        });
+        qint64 rxNs = lastArrivalNs.load() - start;
+
+        QJsonObject result;
+        result["messages"] = messages;
+        result["received"] = double(rxShort.load() - rxStart);
+        result["complete"] = complete;
+        result["queueMsgPerSec"] = benchRate(messages, queuedNs);
+        result["txMsgPerSec"] = txDone ? benchRate(messages, txNs) : 0;
+        result["rxMsgPerSec"] = benchRate(double(rxShort.load() - rxStart), rxNs);
+        return result;
+    }
+
+    QJsonObject roundTrip(int count)
+    {
+        KMI_Histogram toSignal, toStamp;
+        int lost = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            quint64 expected = rxShort.load() + 1;
+            qint64 sendNs = kmiHostTimeNs();
+            tx.slotSendMIDI(MIDI_CONTROL_CHANGE, 1, uchar(i & 0x7F));
+
+            if (!benchWaitFor([&]() { return rxShort.load(std::memory_order_acquire) >= expected; }, 1000))
+            {
+                lost++;
+                continue;
+            }
+            toSignal.record(lastArrivalNs.load() - sendNs);
+            toStamp.record(lastStampNs.load() - sendNs);
+        }
+
+        QJsonObject result;
+        result["count"] = count;
+        result["lost"] = lost;
+        result["toSignal"] = benchHistogram(toSignal);     // send call -> rx signal
+        result["toTimestamp"] = benchHistogram(toStamp);   // send call -> timestamp taken in the callback
+        return result;
+    }
+
+    QJsonObject sysExThroughput(unsigned int chunkSize, unsigned int chunkDelay)
+    {
+        tx.sysExTxChunkSize = chunkSize;
+        tx.sysExTxChunkDelay = chunkDelay;
+        tx.slotSetTxByteRate(0);
+
+        std::vector<uint8_t> sysEx(BENCH_SYSEX_LENGTH);
+        benchFill(sysEx.data(), sysEx.size(), true);
+        sysEx[0] = MIDI_SX_START;
+        sysEx[1] = 0x7D; // non-commercial id, never matched by slotProcessSysEx
+        sysEx[sysEx.size() - 1] = MIDI_SX_STOP;
+
+        quint64 rxStart = rxSysEx.load();
+        quint64 bytesStart = rxSysExBytes.load();
+
+        qint64 start = kmiHostTimeNs();
+        for (int i = 0; i < BENCH_SYSEX_MESSAGES; i++) tx.slotSendSysEx(sysEx.data(), int(sysEx.size()));
+
+        bool complete = benchWaitFor([&]()
+        {
+            return rxSysEx.load(std::memory_order_acquire) - rxStart >= BENCH_SYSEX_MESSAGES;
+        }, BENCH_TIMEOUT_MS * 3);
+        qint64 elapsedNs = kmiHostTimeNs() - start;
+
+        quint64 bytes = rxSysExBytes.load() - bytesStart;
+
+        QJsonObject result;
+        result["chunkSize"] = int(chunkSize);
+        result["chunkDelayMs"] = int(chunkDelay);
+        result["messages"] = BENCH_SYSEX_MESSAGES;
+        result["received"] = double(rxSysEx.load() - rxStart);
+        result["complete"] = complete;
+        result["bytes"] = double(bytes);
+        result["seconds"] = double(elapsedNs) / 1e9;
+        result["bytesPerSec"] = benchRate(bytes, elapsedNs);
+        return result;
+    }
+
+    MidiDeviceManager tx;
+    MidiDeviceManager rx;
+};
+
+static QJsonObject benchLoopback(int messages, int roundTrips)
+{
+    static const struct { const char *name; bool rxRing; bool txThread; } modes[] =
+    {
+        { "callback", false, false },
+        { "rxRing", true, false },
+        { "rxRingTxThread", true, true },
+    };
+    static const unsigned int sysExSettings[][2] = // chunk size, delay ms
+    {
+        { 0, 0 }, { 256, 1 }, { 128, 1 }, { 64, 1 }, { 32, 2 },
+    };
+
+    QJsonObject result;
+    QJsonArray runs;
+    KMI_Ports ports;
+    BenchLoopback loop(&ports);
+
+    for (const auto &mode : modes)
+    {
+        QJsonObject run;
+        run["mode"] = mode.name;
+
+        if (!loop.open(mode.rxRing, mode.txThread))
+        {
+            run["error"] = "couldn't open the virtual loopback port";
+            runs.append(run);
+            loop.close();
+            continue;
+        }
+
+        run["nrpn"] = loop.singleNRPN(); // first, before anything else could flush it
+        run["channel"] = loop.channelRate(messages);
+        run["roundTrip"] = loop.roundTrip(roundTrips);
+
+        QJsonArray sysEx;
+        for (const auto &setting : sysExSettings) sysEx.append(loop.sysExThroughput(setting[0], setting[1]));
+        run["sysex"] = sysEx;
+
+        run["txMetrics"] = benchMetrics(loop.tx.getMetrics());
+        run["rxMetrics"] = benchMetrics(loop.rx.getMetrics());
+        runs.append(run);
+
+        loop.close();
+    }
+
+    result["available"] = true;
+    result["runs"] = runs;
+    return result;
+}
+
+#endif // Q_OS_WIN
+
+// ****************************
+// Main
+// ****************************
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mdmBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless MIDI I/O benchmark for MidiDeviceManager");
+    parser.addHelpOption();
+    QCommandLineOption outOption("out", "Write the JSON results to <file> instead of stdout.", "file");
+    QCommandLineOption messagesOption("messages", "Short messages per channel rate run.", "n", "20000");
+    QCommandLineOption roundTripOption("roundtrips", "Round trips per run.", "n", "2000");
+    QCommandLineOption codecOption("codec-mb", "Megabytes pushed through each codec test.", "n", "64");
+    QCommandLineOption noLoopOption("no-loopback", "Skip the virtual port loopback tests.");
+    QCommandLineOption replayOption("replay", "Time parsing a capture log at full speed.", "log");
+    QCommandLineOption verboseOption("verbose", "Keep qDebug/DM_OUT output.");
+    parser.addOptions({ outOption, messagesOption, roundTripOption, codecOption, noLoopOption, replayOption, verboseOption });
+    parser.process(app);
+
+    benchVerbose = parser.isSet(verboseOption);
+    qInstallMessageHandler(benchMessageHandler);
+
+    int messages = qMax(1, parser.value(messagesOption).toInt());
+    int roundTrips = qMax(1, parser.value(roundTripOption).toInt());
+    size_t codecBytes = size_t(qMax(1, parser.value(codecOption).toInt())) << 20;
+
+    QJsonObject results;
+    results["benchmark"] = "mdmBench";
+    results["version"] = BENCH_VERSION;
+    results["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    results["os"] = QSysInfo::prettyProductName();
+    results["cpu"] = QSysInfo::currentCpuArchitecture();
+    results["qt"] = qVersion();
+
+    QJsonObject config;
+    config["messages"] = messages;
+    config["roundTrips"] = roundTrips;
+    config["codecBytes"] = double(codecBytes);
+    config["sysExLength"] = BENCH_SYSEX_LENGTH;
+    config["sysExMessages"] = BENCH_SYSEX_MESSAGES;
+    results["config"] = config;
+
+    results["codec"] = benchCodec(codecBytes);
+    results["capture"] = benchCapture();
+
+    QJsonObject loopback;
+#ifndef Q_OS_WIN
+    if (parser.isSet(noLoopOption))
+    {
+        loopback["available"] = false;
+        loopback["note"] = "skipped, --no-loopback";
+    }
+    else
+    {
+        loopback = benchLoopback(messages, roundTrips);
+    }
+#else
+    loopback["available"] = false;
+    loopback["note"] = "RtMidi has no virtual ports on Windows";
+#endif
+    results["loopback"] = loopback;
+
+    if (parser.isSet(replayOption)) results["replay"] = benchReplay(parser.value(replayOption));
+
+    QByteArray json = QJsonDocument(results).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outOption))
+    {
+        QFile file(parser.value(outOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qWarning() << "mdmBench: couldn't write" << file.fileName();
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return benchFailedChecks ? 2 : 0;
+}
@@ -0,0 +1,65 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# the core builds without Widgets, errors only go to signalErrorMessage
+DEFINES += KMI_MDM_HEADLESS
+
+SOURCES += \
+    ../../KMI_mdm.cpp \
+    ../../KMI_ports.cpp \
+    ../../KMI_portNotifier.cpp \
+    ../../KMI_fwImage.cpp \
+    ../../KMI_midiOutThread.cpp \
+    ../../KMI_txBatch.cpp \
+    ../../KMI_capture.cpp \
+    ../../KMI_captureReplay.cpp \
+    ../../KMI_SysexMessages.c \
+    ../../kmiSysEx/kmiSysEx.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../KMI_mdm.h \
+    ../../KMI_ports.h \
+    ../../KMI_portNotifier.h \
+    ../../KMI_fwImage.h \
+    ../../KMI_midiOutThread.h \
+    ../../KMI_txBatch.h \
+    ../../KMI_capture.h \
+    ../../KMI_captureReplay.h \
+    ../../KMI_DevData.h \
+    ../../KMI_FwVersions.h \
+    ../../KMI_SysexMessages.h \
+    ../../KMI_rxRing.h \
+    ../../KMI_rxClock.h \
+    ../../KMI_rxRealtime.h \
+    ../../KMI_rxSysEx.h \
+    ../../KMI_metrics.h \
+    ../../KMI_txQueue.h \
+    ../../KMI_mpscQueue.h \
+    ../../kmiSysEx/kmiSysEx.h \
+    ../../midi.h
+
+INCLUDEPATH += \
+    ../../ \
+    ../../kmiSysEx/ \
+
+# Include RtMidi
+INCLUDEPATH += path/to/rtmidi
+SOURCES += path/to/rtmidi/RtMidi.cpp
+
+# RtMidi backend and its system libraries, one per platform
+mac {
+    DEFINES += __MACOSX_CORE__
+    LIBS += -framework CoreMIDI -framework CoreFoundation -framework CoreAudio
+}
+win32 {
+    DEFINES += __WINDOWS_MM__
+    LIBS += -lwinmm
+}
+unix:!mac {
+    DEFINES += __LINUX_ALSA__
+    LIBS += -lasound -lpthread
+}